@@ -0,0 +1,227 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "os_functions.h"
+#include <coreinit/core.h>
+#include <coreinit/filesystem.h>
+#include <coreinit/messagequeue.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//! Host implementation of the Cafe OS functions libiosuhax calls.
+
+#define HOST_CORE_COUNT 3
+
+//! seconds from the unix epoch to 2000-01-01, where console time starts
+#define HOST_EPOCH_2000 946684800ll
+
+//! The library reserves OS_MUTEX_SIZE/OS_COND_SIZE bytes, the pthread objects don't fit on every host.
+//! They are allocated on init and the pointer is kept at the start of the console object.
+//! Console mutexes and conditions are never destroyed, so neither are these.
+static void *host_object(void *object) {
+    void *host;
+    memcpy(&host, object, sizeof(host));
+    return host;
+}
+
+void OSInitMutex(void *mutex) {
+    pthread_mutex_t *host = (pthread_mutex_t *) malloc(sizeof(pthread_mutex_t));
+    if (!host)
+        abort();
+
+    // console mutexes are recursive
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(host, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    memcpy(mutex, &host, sizeof(host));
+}
+
+void OSLockMutex(void *mutex) {
+    pthread_mutex_lock((pthread_mutex_t *) host_object(mutex));
+}
+
+void OSUnlockMutex(void *mutex) {
+    pthread_mutex_unlock((pthread_mutex_t *) host_object(mutex));
+}
+
+int OSTryLockMutex(void *mutex) {
+    return pthread_mutex_trylock((pthread_mutex_t *) host_object(mutex)) == 0;
+}
+
+void OSInitCond(void *cond) {
+    pthread_cond_t *host = (pthread_cond_t *) malloc(sizeof(pthread_cond_t));
+    if (!host)
+        abort();
+
+    pthread_cond_init(host, NULL);
+    memcpy(cond, &host, sizeof(host));
+}
+
+void OSWaitCond(void *cond, void *mutex) {
+    pthread_cond_wait((pthread_cond_t *) host_object(cond), (pthread_mutex_t *) host_object(mutex));
+}
+
+void OSSignalCond(void *cond) {
+    // OSSignalCond wakes every waiter
+    pthread_cond_broadcast((pthread_cond_t *) host_object(cond));
+}
+
+typedef struct _host_message_queue_t {
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} host_message_queue_t;
+
+void OSInitMessageQueue(OSMessageQueue *queue, OSMessage *messages, int32_t size) {
+    host_message_queue_t *host = (host_message_queue_t *) malloc(sizeof(host_message_queue_t));
+    if (!host)
+        abort();
+
+    pthread_mutex_init(&host->lock, NULL);
+    pthread_cond_init(&host->notEmpty, NULL);
+    pthread_cond_init(&host->notFull, NULL);
+
+    queue->messages = messages;
+    queue->size     = size;
+    queue->first    = 0;
+    queue->used     = 0;
+    queue->host     = host;
+}
+
+bool OSSendMessage(OSMessageQueue *queue, OSMessage *message, OSMessageFlags flags) {
+    host_message_queue_t *host = (host_message_queue_t *) queue->host;
+
+    pthread_mutex_lock(&host->lock);
+    while (queue->used == queue->size) {
+        if (!(flags & OS_MESSAGE_FLAGS_BLOCKING)) {
+            pthread_mutex_unlock(&host->lock);
+            return false;
+        }
+        pthread_cond_wait(&host->notFull, &host->lock);
+    }
+
+    if (flags & OS_MESSAGE_FLAGS_HIGH_PRIORITY) {
+        queue->first                  = (queue->first + queue->size - 1) % queue->size;
+        queue->messages[queue->first] = *message;
+    } else {
+        queue->messages[(queue->first + queue->used) % queue->size] = *message;
+    }
+    queue->used++;
+
+    pthread_cond_signal(&host->notEmpty);
+    pthread_mutex_unlock(&host->lock);
+    return true;
+}
+
+bool OSReceiveMessage(OSMessageQueue *queue, OSMessage *message, OSMessageFlags flags) {
+    host_message_queue_t *host = (host_message_queue_t *) queue->host;
+
+    pthread_mutex_lock(&host->lock);
+    while (queue->used == 0) {
+        if (!(flags & OS_MESSAGE_FLAGS_BLOCKING)) {
+            pthread_mutex_unlock(&host->lock);
+            return false;
+        }
+        pthread_cond_wait(&host->notEmpty, &host->lock);
+    }
+
+    *message     = queue->messages[queue->first];
+    queue->first = (queue->first + 1) % queue->size;
+    queue->used--;
+
+    pthread_cond_signal(&host->notFull);
+    pthread_mutex_unlock(&host->lock);
+    return true;
+}
+
+static volatile uint32_t hostNextCore = 0;
+static __thread int hostCoreId        = -1;
+
+uint32_t OSGetCoreId(void) {
+    // threads are spread over the cores in the order they first ask
+    if (hostCoreId < 0)
+        hostCoreId = __atomic_fetch_add(&hostNextCore, 1, __ATOMIC_RELAXED) % HOST_CORE_COUNT;
+    return hostCoreId;
+}
+
+uint32_t OSGetCoreCount(void) {
+    return HOST_CORE_COUNT;
+}
+
+void OSYieldThread(void) {
+    sched_yield();
+}
+
+void OSSleepTicks(OSTime ticks) {
+    struct timespec ts;
+    ts.tv_sec  = ticks / OSTimerClockSpeed;
+    ts.tv_nsec = (ticks % OSTimerClockSpeed) * 1000000000ll / OSTimerClockSpeed;
+    nanosleep(&ts, NULL);
+}
+
+static OSTime host_clock_ticks(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (OSTime) ts.tv_sec * OSTimerClockSpeed + (OSTime) ts.tv_nsec * OSTimerClockSpeed / 1000000000ll;
+}
+
+OSTime OSGetTime(void) {
+    return host_clock_ticks(CLOCK_REALTIME) - HOST_EPOCH_2000 * OSTimerClockSpeed;
+}
+
+OSTime OSGetSystemTime(void) {
+    return host_clock_ticks(CLOCK_MONOTONIC);
+}
+
+OSTick OSGetTick(void) {
+    return (OSTick) OSGetTime();
+}
+
+OSTick OSGetSystemTick(void) {
+    return (OSTick) OSGetSystemTime();
+}
+
+void FSTimeToCalendarTime(FSTime time, OSCalendarTime *calendarTime) {
+    time_t seconds = (time_t) (time / 1000000) + HOST_EPOCH_2000;
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+
+    calendarTime->tm_sec  = tm.tm_sec;
+    calendarTime->tm_min  = tm.tm_min;
+    calendarTime->tm_hour = tm.tm_hour;
+    calendarTime->tm_mday = tm.tm_mday;
+    calendarTime->tm_mon  = tm.tm_mon;
+    calendarTime->tm_year = tm.tm_year + 1900;
+    calendarTime->tm_wday = tm.tm_wday;
+    calendarTime->tm_yday = tm.tm_yday;
+    calendarTime->tm_msec = (time / 1000) % 1000;
+    calendarTime->tm_usec = time % 1000;
+}
@@ -0,0 +1,17 @@
+//! Host stand-in for the wut header, only what libiosuhax uses.
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! every host thread is pinned to one of the three emulated cores when it first asks
+uint32_t OSGetCoreId(void);
+
+uint32_t OSGetCoreCount(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,38 @@
+//! Host stand-in for the wut header, only what libiosuhax uses.
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct OSMessage {
+    void *message;
+    uint32_t args[3];
+} OSMessage;
+
+typedef struct OSMessageQueue {
+    OSMessage *messages;
+    uint32_t size;
+    uint32_t first;
+    uint32_t used;
+    void *host; // lock and conditions of the host implementation
+} OSMessageQueue;
+
+typedef enum OSMessageFlags {
+    OS_MESSAGE_FLAGS_NONE          = 0,
+    OS_MESSAGE_FLAGS_BLOCKING      = 1 << 0,
+    OS_MESSAGE_FLAGS_HIGH_PRIORITY = 1 << 1,
+} OSMessageFlags;
+
+void OSInitMessageQueue(OSMessageQueue *queue, OSMessage *messages, int32_t size);
+
+bool OSSendMessage(OSMessageQueue *queue, OSMessage *message, OSMessageFlags flags);
+
+bool OSReceiveMessage(OSMessageQueue *queue, OSMessage *message, OSMessageFlags flags);
+
+#ifdef __cplusplus
+}
+#endif
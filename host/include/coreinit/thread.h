@@ -0,0 +1,16 @@
+//! Host stand-in for the wut header, only what libiosuhax uses.
+#pragma once
+
+#include <coreinit/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void OSYieldThread(void);
+
+void OSSleepTicks(OSTime ticks);
+
+#ifdef __cplusplus
+}
+#endif
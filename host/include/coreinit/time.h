@@ -0,0 +1,47 @@
+//! Host stand-in for the wut header, only what libiosuhax uses.
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int64_t OSTime;
+typedef int32_t OSTick;
+
+//! the console timer runs at a quarter of the 248.625 MHz bus clock, the host clock is scaled to match
+#define OSTimerClockSpeed 62156250ll
+
+#define OSTicksToSeconds(val)      ((val) / OSTimerClockSpeed)
+#define OSTicksToMilliseconds(val) (((val) * 1000ll) / OSTimerClockSpeed)
+#define OSTicksToMicroseconds(val) (((val) * 1000000ll) / OSTimerClockSpeed)
+#define OSSecondsToTicks(val)      ((val) * OSTimerClockSpeed)
+#define OSMillisecondsToTicks(val) (((val) * OSTimerClockSpeed) / 1000ll)
+#define OSMicrosecondsToTicks(val) (((val) * OSTimerClockSpeed) / 1000000ll)
+
+typedef struct OSCalendarTime {
+    int32_t tm_sec;
+    int32_t tm_min;
+    int32_t tm_hour;
+    int32_t tm_mday;
+    int32_t tm_mon;
+    int32_t tm_year;
+    int32_t tm_wday;
+    int32_t tm_yday;
+    int32_t tm_msec;
+    int32_t tm_usec;
+} OSCalendarTime;
+
+OSTime OSGetTime(void);
+
+OSTime OSGetSystemTime(void);
+
+OSTick OSGetTick(void);
+
+OSTick OSGetSystemTick(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+//! Host stand-in for the newlib header, only what libiosuhax uses.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct _reent {
+    int _errno;
+};
+
+//! one per host thread
+struct _reent *__getreent(void);
+
+#define _REENT (__getreent())
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+//! Host stand-in for the newlib header, the devoptab only needs DIR_ITER from sys/iosupport.h.
+#pragma once
+
+#include <dirent.h>
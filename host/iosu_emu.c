@@ -0,0 +1,1414 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax.h"
+#include "iosuhax_host.h"
+#include "iosuhax_ipc.h"
+#include "os_functions.h"
+#include <coreinit/filesystem.h>
+#include <dirent.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <time.h>
+#include <unistd.h>
+
+//! IOSU side of /dev/iosuhax for host builds.
+//!
+//! Request and reply words are read and written in host order: on the console the PPC and IOSU
+//! are both big endian, here the library and this file share the host's order, so neither side
+//! swaps anything. Memory served by the MEM and KERN requests keeps the console's big endian
+//! byte image, KERN_READ32/KERN_WRITE32 convert like a big endian CPU would.
+
+#define IOS_ERROR_ACCESS   -1
+#define IOS_ERROR_INVALID  -4
+#define IOS_ERROR_MAX      -5
+#define IOS_ERROR_NOEXISTS -6
+
+#define EMU_IOS_HANDLE_BASE 0x100
+#define EMU_IOS_HANDLES     16
+#define EMU_CLIENTS         32
+#define EMU_FILES           256
+#define EMU_DIRS            64
+#define EMU_RAWS            8
+#define EMU_MOUNTS          8
+
+//! FSA handles of the different kinds use distinct ranges so a mixed up handle is rejected
+#define EMU_CLIENT_BASE 0x10000
+#define EMU_FILE_BASE   0x20000
+#define EMU_DIR_BASE    0x30000
+#define EMU_RAW_BASE    0x40000
+
+#define EMU_FSA_PATH_MAX 0x280
+
+//! seconds from the unix epoch to 2000-01-01, where FSTime starts
+#define EMU_EPOCH_2000 946684800ll
+
+typedef struct _emu_client_t {
+    int used;
+    char cwd[EMU_FSA_PATH_MAX];
+} emu_client_t;
+
+typedef struct _emu_file_t {
+    int used;
+    int fd;
+    int append;
+    uint64_t pos;
+} emu_file_t;
+
+typedef struct _emu_dir_t {
+    int used;
+    DIR *dir;
+    char path[PATH_MAX];
+} emu_dir_t;
+
+typedef struct _emu_raw_t {
+    int used;
+    int fd;
+} emu_raw_t;
+
+typedef struct _emu_mount_t {
+    int used;
+    char volume[EMU_FSA_PATH_MAX];
+    uint32_t volumeLen;
+    const char *directory;
+} emu_mount_t;
+
+//! one queued async request
+typedef struct _emu_job_t {
+    int handle;
+    uint32_t request;
+    ios_vec_t vecs[4];
+    uint32_t vec_in;
+    uint32_t vec_out;
+    int vectored;
+    ios_async_callback_t callback;
+    void *context;
+    int result;
+    struct _emu_job_t *next;
+} emu_job_t;
+
+static struct {
+    int initialized;
+    iosuhax_host_config_t config;
+    uint8_t *ram;
+    uint8_t otp[0x400];
+    uint8_t seeprom[0x200];
+
+    pthread_mutex_t lock; // the tables below and the file system state
+    emu_client_t clients[EMU_CLIENTS];
+    emu_file_t files[EMU_FILES];
+    emu_dir_t dirs[EMU_DIRS];
+    emu_raw_t raws[EMU_RAWS];
+    emu_mount_t mounts[EMU_MOUNTS];
+
+    //! an IOS handle serves one request at a time, requests on different handles run in parallel
+    int handleUsed[EMU_IOS_HANDLES];
+    pthread_mutex_t handleLocks[EMU_IOS_HANDLES];
+
+    //! FSA works through the requests of one client in order, whichever IOS handle they arrive on
+    pthread_mutex_t clientLocks[EMU_CLIENTS];
+
+    pthread_t worker;
+    pthread_mutex_t jobLock;
+    pthread_cond_t jobCond;
+    emu_job_t *jobHead;
+    emu_job_t *jobTail;
+    int stop;
+
+    volatile uint32_t features;
+    volatile uint32_t latency;
+    volatile uint64_t requests;
+} emu;
+
+void iosuhax_host_default_config(iosuhax_host_config_t *config) {
+    memset(config, 0, sizeof(iosuhax_host_config_t));
+    config->root        = ".";
+    config->ram_address = 0x10000000;
+    config->ram_size    = 0x100000;
+    config->features    = IOSUHAX_HOST_FEATURE_ALL;
+}
+
+void iosuhax_host_set_features(uint32_t features) {
+    __atomic_store_n(&emu.features, features, __ATOMIC_RELAXED);
+}
+
+void iosuhax_host_set_latency(uint32_t latency_us) {
+    __atomic_store_n(&emu.latency, latency_us, __ATOMIC_RELAXED);
+}
+
+uint64_t iosuhax_host_request_count(void) {
+    return __atomic_load_n(&emu.requests, __ATOMIC_RELAXED);
+}
+
+static int emu_feature(uint32_t feature) {
+    return (__atomic_load_n(&emu.features, __ATOMIC_RELAXED) & feature) != 0;
+}
+
+static void emu_latency(void) {
+    uint32_t latency = __atomic_load_n(&emu.latency, __ATOMIC_RELAXED);
+    if (latency == 0)
+        return;
+
+    struct timespec ts = {latency / 1000000, (latency % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+static void emu_load_image(const char *path, uint8_t *out, size_t size) {
+    memset(out, 0, size);
+    if (!path)
+        return;
+
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return;
+    if (fread(out, 1, size, f) != size)
+        fprintf(stderr, "iosuhax host: %s is shorter than 0x%zx bytes\n", path, size);
+    fclose(f);
+}
+
+static int emu_fs_error(int error) {
+    switch (error) {
+        case ENOENT:
+            return FS_ERROR_NOT_FOUND;
+        case EEXIST:
+            return FS_ERROR_ALREADY_EXISTS;
+        case ENOTDIR:
+            return FS_ERROR_NOT_DIR;
+        case EISDIR:
+            return FS_ERROR_NOT_FILE;
+        case ENOTEMPTY:
+            return FS_ERROR_NOT_EMPTY;
+        case EACCES:
+        case EPERM:
+            return FS_ERROR_PERMISSION_ERROR;
+        case ENOSPC:
+            return FS_ERROR_STORAGE_FULL;
+        case EFBIG:
+            return FS_ERROR_FILE_TOO_BIG;
+        case EMFILE:
+        case ENFILE:
+            return FS_ERROR_MAX_FILES;
+        case EROFS:
+            return FS_ERROR_WRITE_PROTECTED;
+        case ENAMETOOLONG:
+        case EINVAL:
+            return FS_ERROR_INVALID_PATH;
+    }
+    return FS_ERROR_MEDIA_ERROR;
+}
+
+static FSTime emu_fs_time(const struct timespec *ts) {
+    return ((FSTime) ts->tv_sec - EMU_EPOCH_2000) * 1000000 + ts->tv_nsec / 1000;
+}
+
+static void emu_fs_stat(const struct stat *st, FSStat *out) {
+    memset(out, 0, sizeof(FSStat));
+    out->flags     = S_ISDIR(st->st_mode) ? FS_STAT_DIRECTORY : FS_STAT_FILE;
+    out->mode      = ((st->st_mode & S_IRWXU) << 2) | ((st->st_mode & S_IRWXG) << 1) | (st->st_mode & S_IRWXO);
+    out->owner     = st->st_uid;
+    out->group     = st->st_gid;
+    out->size      = S_ISDIR(st->st_mode) ? 0 : (uint32_t) st->st_size;
+    out->allocSize = (uint32_t) (st->st_blocks * 512);
+    out->entryId   = (uint32_t) st->st_ino ? (uint32_t) st->st_ino : 1;
+    out->created   = emu_fs_time(&st->st_ctim);
+    out->modified  = emu_fs_time(&st->st_mtim);
+}
+
+static mode_t emu_unix_mode(uint32_t mode) {
+    return ((mode >> 2) & S_IRWXU) | ((mode >> 1) & S_IRWXG) | (mode & S_IRWXO);
+}
+
+//! Returns the string at 'offset' of the input buffer, NULL if it is not terminated inside of it.
+static const char *emu_string(const uint8_t *in, uint32_t in_len, uint32_t offset) {
+    if (offset >= in_len || !memchr(in + offset, 0, in_len - offset))
+        return NULL;
+    return (const char *) in + offset;
+}
+
+static emu_client_t *emu_client(uint32_t fsaFd) {
+    uint32_t index = fsaFd - EMU_CLIENT_BASE;
+    if (index >= EMU_CLIENTS || !emu.clients[index].used)
+        return NULL;
+    return &emu.clients[index];
+}
+
+static emu_file_t *emu_file(uint32_t handle) {
+    uint32_t index = handle - EMU_FILE_BASE;
+    if (index >= EMU_FILES || !emu.files[index].used)
+        return NULL;
+    return &emu.files[index];
+}
+
+static emu_dir_t *emu_dir(uint32_t handle) {
+    uint32_t index = handle - EMU_DIR_BASE;
+    if (index >= EMU_DIRS || !emu.dirs[index].used)
+        return NULL;
+    return &emu.dirs[index];
+}
+
+static emu_raw_t *emu_raw(uint32_t handle) {
+    uint32_t index = handle - EMU_RAW_BASE;
+    if (index >= EMU_RAWS || !emu.raws[index].used)
+        return NULL;
+    return &emu.raws[index];
+}
+
+static const iosuhax_host_device_t *emu_device(const char *device_path) {
+    for (int i = 0; i < IOSUHAX_HOST_DEVICES_MAX; i++) {
+        const iosuhax_host_device_t *device = &emu.config.devices[i];
+        if (device->device_path && strcmp(device->device_path, device_path) == 0)
+            return device;
+    }
+    return NULL;
+}
+
+//! Maps an FSA path to the host path below a mounted volume or the root directory.
+//! Relative paths start at the client's current directory. Returns an FSA error.
+static int emu_host_path(emu_client_t *client, const char *path, char *out, size_t out_size) {
+    char full[EMU_FSA_PATH_MAX * 2];
+    if (path[0] == '/')
+        snprintf(full, sizeof(full), "%s", path);
+    else
+        snprintf(full, sizeof(full), "%s/%s", client->cwd, path);
+
+    // nothing may leave the served tree
+    for (const char *p = full; (p = strstr(p, "..")) != NULL; p += 2) {
+        if ((p == full || p[-1] == '/') && (p[2] == 0 || p[2] == '/'))
+            return FS_ERROR_INVALID_PATH;
+    }
+
+    const emu_mount_t *best = NULL;
+    for (int i = 0; i < EMU_MOUNTS; i++) {
+        const emu_mount_t *mount = &emu.mounts[i];
+        if (!mount->used || strncmp(full, mount->volume, mount->volumeLen) != 0)
+            continue;
+        if (full[mount->volumeLen] != 0 && full[mount->volumeLen] != '/')
+            continue;
+        if (!best || mount->volumeLen > best->volumeLen)
+            best = mount;
+    }
+
+    int len;
+    if (best)
+        len = snprintf(out, out_size, "%s%s", best->directory, full + best->volumeLen);
+    else
+        len = snprintf(out, out_size, "%s%s", emu.config.root, full);
+
+    return (len < 0 || (size_t) len >= out_size) ? FS_ERROR_INVALID_PATH : 0;
+}
+
+//! Resolves the path string at 'offset' for the client 'fsaFd'.
+static int emu_request_path(uint32_t fsaFd, const uint8_t *in, uint32_t in_len, uint32_t offset, char *out) {
+    emu_client_t *client = emu_client(fsaFd);
+    if (!client)
+        return FS_ERROR_INVALID_CLIENTHANDLE;
+
+    const char *path = emu_string(in, in_len, offset);
+    if (!path)
+        return FS_ERROR_INVALID_PATH;
+
+    return emu_host_path(client, path, out, PATH_MAX);
+}
+
+static int emu_getstat(const char *host_path, FSStat *out) {
+    struct stat st;
+    if (stat(host_path, &st) != 0)
+        return emu_fs_error(errno);
+
+    emu_fs_stat(&st, out);
+    return 0;
+}
+
+static int emu_openfile(const char *host_path, const char *mode, int *outHandle) {
+    int flags  = 0;
+    int append = 0;
+    switch (mode[0]) {
+        case 'r':
+            flags = O_RDONLY;
+            break;
+        case 'w':
+            flags = O_WRONLY | O_CREAT | O_TRUNC;
+            break;
+        case 'a':
+            flags  = O_WRONLY | O_CREAT;
+            append = 1;
+            break;
+        default:
+            return FS_ERROR_INVALID_PARAM;
+    }
+    if (strchr(mode, '+'))
+        flags = (flags & ~(O_RDONLY | O_WRONLY)) | O_RDWR;
+
+    struct stat st;
+    if (stat(host_path, &st) == 0 && S_ISDIR(st.st_mode))
+        return FS_ERROR_NOT_FILE;
+
+    int index = 0;
+    while (index < EMU_FILES && emu.files[index].used)
+        index++;
+    if (index == EMU_FILES)
+        return FS_ERROR_MAX_FILES;
+
+    int fd = open(host_path, flags, 0666);
+    if (fd < 0)
+        return emu_fs_error(errno);
+
+    emu.files[index].used   = 1;
+    emu.files[index].fd     = fd;
+    emu.files[index].append = append;
+    emu.files[index].pos    = 0;
+
+    *outHandle = EMU_FILE_BASE + index;
+    return 0;
+}
+
+static int emu_closefile(uint32_t handle) {
+    emu_file_t *file = emu_file(handle);
+    if (!file)
+        return FS_ERROR_INVALID_FILEHANDLE;
+
+    close(file->fd);
+    file->used = 0;
+    return 0;
+}
+
+static int emu_statfile(uint32_t handle, FSStat *out) {
+    emu_file_t *file = emu_file(handle);
+    if (!file)
+        return FS_ERROR_INVALID_FILEHANDLE;
+
+    struct stat st;
+    if (fstat(file->fd, &st) != 0)
+        return emu_fs_error(errno);
+
+    emu_fs_stat(&st, out);
+    return 0;
+}
+
+//! FSA reads and writes return the number of complete elements transferred
+static int emu_readfile(uint32_t handle, uint32_t size, uint32_t cnt, uint8_t *data) {
+    emu_file_t *file = emu_file(handle);
+    if (!file)
+        return FS_ERROR_INVALID_FILEHANDLE;
+    if (size == 0 || cnt == 0)
+        return 0;
+
+    size_t total = (size_t) size * cnt;
+    size_t done  = 0;
+    while (done < total) {
+        ssize_t res = pread(file->fd, data + done, total - done, file->pos + done);
+        if (res < 0)
+            return emu_fs_error(errno);
+        if (res == 0)
+            break;
+        done += res;
+    }
+
+    file->pos += done;
+    return done / size;
+}
+
+static int emu_writefile(uint32_t handle, uint32_t size, uint32_t cnt, const uint8_t *data) {
+    emu_file_t *file = emu_file(handle);
+    if (!file)
+        return FS_ERROR_INVALID_FILEHANDLE;
+    if (size == 0 || cnt == 0)
+        return 0;
+
+    if (file->append) {
+        struct stat st;
+        if (fstat(file->fd, &st) == 0)
+            file->pos = st.st_size;
+    }
+
+    size_t total = (size_t) size * cnt;
+    size_t done  = 0;
+    while (done < total) {
+        ssize_t res = pwrite(file->fd, data + done, total - done, file->pos + done);
+        if (res < 0)
+            return done ? (int) (done / size) : emu_fs_error(errno);
+        done += res;
+    }
+
+    file->pos += done;
+    return done / size;
+}
+
+//! raw transfers return 0 once every block was transferred
+static int emu_raw_transfer(uint32_t handle, uint32_t block_size, uint32_t block_cnt, uint64_t sector, uint8_t *data, int isWrite) {
+    emu_raw_t *raw = emu_raw(handle);
+    if (!raw)
+        return FS_ERROR_INVALID_FILEHANDLE;
+
+    size_t total  = (size_t) block_size * block_cnt;
+    off_t offset  = (off_t) (sector * block_size);
+    size_t done   = 0;
+    while (done < total) {
+        ssize_t res = isWrite ? pwrite(raw->fd, data + done, total - done, offset + done)
+                              : pread(raw->fd, data + done, total - done, offset + done);
+        if (res < 0)
+            return emu_fs_error(errno);
+        if (res == 0)
+            return FS_ERROR_OUT_OF_RANGE;
+        done += res;
+    }
+    return 0;
+}
+
+static int emu_readdir(uint32_t handle, FSDirectoryEntry *out) {
+    emu_dir_t *dir = emu_dir(handle);
+    if (!dir)
+        return FS_ERROR_INVALID_DIRHANDLE;
+
+    while (1) {
+        errno                = 0;
+        struct dirent *entry = readdir(dir->dir);
+        if (!entry)
+            return errno ? emu_fs_error(errno) : FS_ERROR_END_OF_DIR;
+
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        char path[PATH_MAX + 256];
+        snprintf(path, sizeof(path), "%s/%s", dir->path, entry->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0)
+            continue;
+
+        memset(out, 0, sizeof(FSDirectoryEntry));
+        emu_fs_stat(&st, &out->info);
+        snprintf(out->name, sizeof(out->name), "%s", entry->d_name);
+        return 0;
+    }
+}
+
+static int emu_makedir(const char *host_path, uint32_t mode) {
+    if (mkdir(host_path, mode ? emu_unix_mode(mode) : 0777) != 0)
+        return emu_fs_error(errno);
+    return 0;
+}
+
+static int emu_remove(const char *host_path) {
+    struct stat st;
+    if (stat(host_path, &st) != 0)
+        return emu_fs_error(errno);
+
+    if ((S_ISDIR(st.st_mode) ? rmdir(host_path) : unlink(host_path)) != 0)
+        return emu_fs_error(errno);
+    return 0;
+}
+
+//! translates a RAM region address, NULL if [address, address + size) is not inside of it
+static uint8_t *emu_ram(uint32_t address, uint32_t size) {
+    uint64_t offset = (uint64_t) address - emu.config.ram_address;
+    if (address < emu.config.ram_address || offset + size > emu.config.ram_size)
+        return NULL;
+    return emu.ram + offset;
+}
+
+//! Reads input word 'index', 0 if the input is too short.
+static uint32_t emu_word(const uint8_t *in, uint32_t in_len, uint32_t index) {
+    uint32_t word = 0;
+    if ((index + 1) * 4 <= in_len)
+        memcpy(&word, in + index * 4, 4);
+    return word;
+}
+
+static void emu_put_word(uint8_t *out, uint32_t out_len, uint32_t index, uint32_t word) {
+    if ((index + 1) * 4 <= out_len)
+        memcpy(out + index * 4, &word, 4);
+}
+
+//! IOCTL_FSA_BATCH, see the layout in source/iosuhax_batch.c
+static int emu_batch(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_len) {
+    uint32_t fsaFd    = emu_word(in, in_len, 0);
+    uint32_t op_count = emu_word(in, in_len, 1);
+
+    if (!emu_client(fsaFd) || out_len < 0x40)
+        return IOS_ERROR_INVALID;
+
+    int *opened = (int *) calloc(op_count ? op_count : 1, sizeof(int));
+    if (!opened)
+        return IOS_ERROR_MAX;
+
+    uint32_t in_offset  = 0x10;
+    uint32_t out_offset = 0x40;
+    uint32_t done       = 0;
+
+    for (; done < op_count; done++) {
+        if (in_offset + 8 > in_len)
+            break;
+
+        const uint8_t *entry = in + in_offset;
+        uint32_t entry_len   = in_len - in_offset;
+        uint32_t code        = emu_word(entry, entry_len, 0);
+        uint32_t entry_size  = emu_word(entry, entry_len, 1);
+        if (entry_size < 8 || entry_size > entry_len)
+            break;
+
+        // the reply slot sizes have to match the ones the library reserved
+        uint32_t slot_size;
+        if (code == IOCTL_FSA_READFILE) {
+            out_offset = ROUNDUP(out_offset, 0x40);
+            slot_size  = 0x40 + ROUNDUP(emu_word(entry, entry_size, 2) * emu_word(entry, entry_size, 3), 0x40);
+        } else if (code == IOCTL_FSA_GETSTAT) {
+            slot_size = ROUNDUP(4 + sizeof(FSStat), 4);
+        } else if (code == IOCTL_FSA_OPENFILE) {
+            slot_size = 8;
+        } else {
+            slot_size = 4;
+        }
+        if (out_offset + slot_size > out_len)
+            break;
+
+        uint8_t *slot = out + out_offset;
+        char host_path[PATH_MAX];
+        int result;
+
+        // handles refer to an earlier entry with IOSUHAX_BATCH_OP_HANDLE(n)
+        uint32_t handle = 0;
+        if (code == IOCTL_FSA_READFILE || code == IOCTL_FSA_CLOSEFILE) {
+            int ref = (int) emu_word(entry, entry_size, code == IOCTL_FSA_READFILE ? 4 : 2);
+            handle  = ref;
+            if (ref <= IOSUHAX_BATCH_OP_HANDLE(0)) {
+                uint32_t index = IOSUHAX_BATCH_OP_HANDLE(0) - ref;
+                handle         = index < done ? (uint32_t) opened[index] : 0;
+            }
+        }
+
+        switch (code) {
+            case IOCTL_FSA_GETSTAT:
+                result = emu_request_path(fsaFd, entry, entry_size, emu_word(entry, entry_size, 2), host_path);
+                if (result == 0)
+                    result = emu_getstat(host_path, (FSStat *) (slot + 4));
+                break;
+            case IOCTL_FSA_OPENFILE: {
+                const char *mode = emu_string(entry, entry_size, emu_word(entry, entry_size, 3));
+                result           = emu_request_path(fsaFd, entry, entry_size, emu_word(entry, entry_size, 2), host_path);
+                if (result == 0)
+                    result = mode ? emu_openfile(host_path, mode, &opened[done]) : FS_ERROR_INVALID_PARAM;
+                emu_put_word(slot, slot_size, 1, opened[done]);
+                break;
+            }
+            case IOCTL_FSA_READFILE:
+                result = emu_readfile(handle, emu_word(entry, entry_size, 2), emu_word(entry, entry_size, 3), slot + 0x40);
+                break;
+            case IOCTL_FSA_CLOSEFILE:
+                result = emu_closefile(handle);
+                break;
+            case IOCTL_FSA_REMOVE:
+                result = emu_request_path(fsaFd, entry, entry_size, emu_word(entry, entry_size, 2), host_path);
+                if (result == 0)
+                    result = emu_remove(host_path);
+                break;
+            case IOCTL_FSA_MAKEDIR:
+                result = emu_request_path(fsaFd, entry, entry_size, emu_word(entry, entry_size, 2), host_path);
+                if (result == 0)
+                    result = emu_makedir(host_path, emu_word(entry, entry_size, 3));
+                break;
+            default:
+                result = FS_ERROR_UNSUPPORTED_COMMAND;
+                break;
+        }
+
+        emu_put_word(slot, slot_size, 0, result);
+        in_offset += entry_size;
+        out_offset += slot_size;
+    }
+
+    free(opened);
+    emu_put_word(out, out_len, 0, done);
+    return 0;
+}
+
+//! Executes one request. 'vectored' requests carry the header, data and result in vecs as
+//! documented in source/iosuhax_ipc.h, all others an input and an output buffer in vecs[0] and vecs[1].
+static int emu_execute(uint32_t request, ios_vec_t *vecs, uint32_t vec_in, uint32_t vec_out, int vectored) {
+    __atomic_fetch_add(&emu.requests, 1, __ATOMIC_RELAXED);
+
+    if (vectored) {
+        if (!emu_feature(IOSUHAX_HOST_FEATURE_IOCTLV) || vec_in + vec_out != 3)
+            return IOS_ERROR_INVALID;
+        if (emu_feature(IOSUHAX_HOST_QUIRK_IOCTLV_NO_RESULT))
+            return 0;
+
+        const uint8_t *header = (const uint8_t *) vecs[0].vaddr;
+        uint32_t header_len   = vecs[0].len;
+        int isWrite           = (vec_in == 2);
+        ios_vec_t *data       = isWrite ? &vecs[1] : &vecs[2];
+        ios_vec_t *result     = isWrite ? &vecs[2] : &vecs[1];
+        if (result->len < 4)
+            return IOS_ERROR_INVALID;
+
+        int res;
+        pthread_mutex_lock(&emu.lock);
+        switch (request) {
+            case IOCTL_FSA_READFILE:
+            case IOCTL_FSA_WRITEFILE: {
+                uint32_t size = emu_word(header, header_len, 1);
+                uint32_t cnt  = emu_word(header, header_len, 2);
+                if ((uint64_t) size * cnt > data->len) {
+                    res = FS_ERROR_INVALID_BUFFER;
+                    break;
+                }
+                if (request == IOCTL_FSA_READFILE && !isWrite)
+                    res = emu_readfile(emu_word(header, header_len, 3), size, cnt, (uint8_t *) data->vaddr);
+                else if (request == IOCTL_FSA_WRITEFILE && isWrite)
+                    res = emu_writefile(emu_word(header, header_len, 3), size, cnt, (const uint8_t *) data->vaddr);
+                else
+                    res = FS_ERROR_INVALID_PARAM;
+                break;
+            }
+            case IOCTL_FSA_RAW_READ:
+            case IOCTL_FSA_RAW_WRITE: {
+                uint32_t block_size = emu_word(header, header_len, 1);
+                uint32_t block_cnt  = emu_word(header, header_len, 2);
+                uint64_t sector     = ((uint64_t) emu_word(header, header_len, 3) << 32) | emu_word(header, header_len, 4);
+                if ((uint64_t) block_size * block_cnt > data->len || isWrite != (request == IOCTL_FSA_RAW_WRITE))
+                    res = FS_ERROR_INVALID_BUFFER;
+                else
+                    res = emu_raw_transfer(emu_word(header, header_len, 5), block_size, block_cnt, sector, (uint8_t *) data->vaddr, isWrite);
+                break;
+            }
+            default:
+                pthread_mutex_unlock(&emu.lock);
+                return IOS_ERROR_INVALID;
+        }
+        pthread_mutex_unlock(&emu.lock);
+
+        memcpy(result->vaddr, &res, 4);
+        return 0;
+    }
+
+    const uint8_t *in = (const uint8_t *) vecs[0].vaddr;
+    uint32_t in_len   = in ? vecs[0].len : 0;
+    uint8_t *out      = (uint8_t *) vecs[1].vaddr;
+    uint32_t out_len  = out ? vecs[1].len : 0;
+
+    // RAW_READ passes the same buffer for input and output, take the words before replying
+    uint32_t w[6];
+    for (int i = 0; i < 6; i++)
+        w[i] = emu_word(in, in_len, i);
+
+    char host_path[PATH_MAX];
+    int result = 0;
+    int res    = 0;
+
+    pthread_mutex_lock(&emu.lock);
+
+    switch (request) {
+        case IOCTL_CHECK_IF_IOSUHAX:
+            emu_put_word(out, out_len, 0, IOSUHAX_MAGIC_WORD);
+            goto done;
+
+        case IOCTL_MEM_WRITE: {
+            uint8_t *ram = in_len >= 4 ? emu_ram(w[0], in_len - 4) : NULL;
+            if (!ram)
+                res = IOS_ERROR_ACCESS;
+            else
+                memcpy(ram, in + 4, in_len - 4);
+            goto done;
+        }
+        case IOCTL_MEM_READ: {
+            uint8_t *ram = emu_ram(w[0], out_len);
+            if (!ram)
+                res = IOS_ERROR_ACCESS;
+            else
+                memcpy(out, ram, out_len);
+            goto done;
+        }
+        case IOCTL_MEMCPY: {
+            uint8_t *dst = emu_ram(w[0], w[2]);
+            uint8_t *src = emu_ram(w[1], w[2]);
+            if (!dst || !src)
+                res = IOS_ERROR_ACCESS;
+            else
+                memmove(dst, src, w[2]);
+            goto done;
+        }
+        case IOCTL_KERN_READ32: {
+            uint8_t *ram = emu_ram(w[0], out_len & ~3);
+            if (!ram) {
+                res = IOS_ERROR_ACCESS;
+                goto done;
+            }
+            for (uint32_t i = 0; i < out_len / 4; i++) {
+                uint32_t word;
+                memcpy(&word, ram + i * 4, 4);
+                emu_put_word(out, out_len, i, be32toh(word));
+            }
+            goto done;
+        }
+        case IOCTL_KERN_WRITE32: {
+            uint8_t *ram = emu_ram(w[0], 4);
+            if (!ram) {
+                res = IOS_ERROR_ACCESS;
+                goto done;
+            }
+            uint32_t word = htobe32(w[1]);
+            memcpy(ram, &word, 4);
+            goto done;
+        }
+        case IOCTL_SVC:
+            // there is no IOSU kernel to call, every svc succeeds without doing anything
+            emu_put_word(out, out_len, 0, 0);
+            goto done;
+
+        case IOCTL_READ_OTP:
+            memcpy(out, emu.otp, out_len < sizeof(emu.otp) ? out_len : sizeof(emu.otp));
+            goto done;
+
+        case IOCTL_FSA_OPEN: {
+            int index = 0;
+            while (index < EMU_CLIENTS && emu.clients[index].used)
+                index++;
+            if (index == EMU_CLIENTS) {
+                emu_put_word(out, out_len, 0, FS_ERROR_MAX_CLIENTS);
+                goto done;
+            }
+            emu.clients[index].used = 1;
+            strcpy(emu.clients[index].cwd, "/");
+            emu_put_word(out, out_len, 0, EMU_CLIENT_BASE + index);
+            goto done;
+        }
+        case IOCTL_FSA_CLOSE: {
+            emu_client_t *client = emu_client(w[0]);
+            if (client)
+                client->used = 0;
+            result = client ? 0 : FS_ERROR_INVALID_CLIENTHANDLE;
+            break;
+        }
+        case IOCTL_FSA_MOUNT: {
+            const char *device_path = emu_string(in, in_len, w[1]);
+            const char *volume_path = emu_string(in, in_len, w[2]);
+            if (!emu_client(w[0])) {
+                result = FS_ERROR_INVALID_CLIENTHANDLE;
+                break;
+            }
+            if (!device_path || !volume_path || strlen(volume_path) >= EMU_FSA_PATH_MAX) {
+                result = FS_ERROR_INVALID_PATH;
+                break;
+            }
+
+            const iosuhax_host_device_t *device = emu_device(device_path);
+            if (!device || !device->directory) {
+                result = FS_ERROR_NOT_FOUND;
+                break;
+            }
+
+            int free_slot = -1;
+            result        = 0;
+            for (int i = 0; i < EMU_MOUNTS; i++) {
+                if (!emu.mounts[i].used) {
+                    if (free_slot < 0)
+                        free_slot = i;
+                } else if (strcmp(emu.mounts[i].volume, volume_path) == 0) {
+                    result = FS_ERROR_ALREADY_EXISTS;
+                }
+            }
+            if (result == 0 && free_slot < 0)
+                result = FS_ERROR_MAX_MOUNT_POINTS;
+            if (result == 0) {
+                emu_mount_t *mount = &emu.mounts[free_slot];
+                mount->used        = 1;
+                mount->volumeLen   = strlen(volume_path);
+                mount->directory   = device->directory;
+                memcpy(mount->volume, volume_path, mount->volumeLen + 1);
+            }
+            break;
+        }
+        case IOCTL_FSA_UNMOUNT: {
+            const char *volume_path = emu_string(in, in_len, w[1]);
+            result                  = volume_path ? FS_ERROR_NOT_FOUND : FS_ERROR_INVALID_PATH;
+            for (int i = 0; volume_path && i < EMU_MOUNTS; i++) {
+                if (emu.mounts[i].used && strcmp(emu.mounts[i].volume, volume_path) == 0) {
+                    emu.mounts[i].used = 0;
+                    result             = 0;
+                }
+            }
+            break;
+        }
+        case IOCTL_FSA_FLUSHVOLUME:
+            result = emu_request_path(w[0], in, in_len, w[1], host_path);
+            if (result == 0)
+                sync();
+            break;
+
+        case IOCTL_FSA_GETDEVICEINFO: {
+            // 0x08: size in sectors (64 bit), 0x10: sector size, the rest stays zero
+            uint8_t info[0x64];
+            memset(info, 0, sizeof(info));
+
+            const char *device_path             = emu_string(in, in_len, w[1]);
+            const iosuhax_host_device_t *device = device_path ? emu_device(device_path) : NULL;
+            uint64_t sectors                    = 0;
+            uint32_t sector_size                = 512;
+            struct stat st;
+            struct statvfs vfs;
+
+            if (device && device->image && stat(device->image, &st) == 0) {
+                sectors = st.st_size / sector_size;
+            } else if (device && device->directory && statvfs(device->directory, &vfs) == 0) {
+                sectors = (uint64_t) vfs.f_blocks * vfs.f_frsize / sector_size;
+            } else {
+                result = emu_client(w[0]) ? FS_ERROR_NOT_FOUND : FS_ERROR_INVALID_CLIENTHANDLE;
+                break;
+            }
+
+            result = 0;
+            memcpy(info + 0x08, &sectors, 8);
+            memcpy(info + 0x10, &sector_size, 4);
+            if (out_len >= 4 + sizeof(info))
+                memcpy(out + 4, info, sizeof(info));
+            break;
+        }
+        case IOCTL_FSA_MAKEDIR:
+            result = emu_request_path(w[0], in, in_len, w[1], host_path);
+            if (result == 0)
+                result = emu_makedir(host_path, w[2]);
+            break;
+
+        case IOCTL_FSA_OPENDIR: {
+            result = emu_request_path(w[0], in, in_len, w[1], host_path);
+            if (result != 0)
+                break;
+
+            int index = 0;
+            while (index < EMU_DIRS && emu.dirs[index].used)
+                index++;
+            if (index == EMU_DIRS) {
+                result = FS_ERROR_MAX_DIRS;
+                break;
+            }
+
+            DIR *dir = opendir(host_path);
+            if (!dir) {
+                result = emu_fs_error(errno);
+                break;
+            }
+            emu.dirs[index].used = 1;
+            emu.dirs[index].dir  = dir;
+            snprintf(emu.dirs[index].path, sizeof(emu.dirs[index].path), "%s", host_path);
+            emu_put_word(out, out_len, 1, EMU_DIR_BASE + index);
+            break;
+        }
+        case IOCTL_FSA_READDIR:
+            if (out_len < 4 + sizeof(FSDirectoryEntry)) {
+                result = FS_ERROR_INVALID_BUFFER;
+                break;
+            }
+            result = emu_readdir(w[1], (FSDirectoryEntry *) (out + 4));
+            break;
+
+        case IOCTL_FSA_READDIR_MULTI: {
+            if (!emu_feature(IOSUHAX_HOST_FEATURE_READDIR_MULTI)) {
+                res = IOS_ERROR_INVALID;
+                goto done;
+            }
+
+            uint32_t max_cnt = w[2];
+            if (out_len < 4 || max_cnt > (out_len - 4) / sizeof(FSDirectoryEntry)) {
+                result = FS_ERROR_INVALID_BUFFER;
+                break;
+            }
+
+            // an error after the first entry is left for the next request
+            uint32_t cnt = 0;
+            while (cnt < max_cnt) {
+                int res_entry = emu_readdir(w[1], (FSDirectoryEntry *) (out + 4 + sizeof(FSDirectoryEntry) * cnt));
+                if (res_entry < 0) {
+                    if (cnt == 0)
+                        result = res_entry;
+                    break;
+                }
+                cnt++;
+            }
+            if (cnt)
+                result = cnt;
+            break;
+        }
+        case IOCTL_FSA_REWINDDIR: {
+            emu_dir_t *dir = emu_dir(w[1]);
+            if (dir)
+                rewinddir(dir->dir);
+            result = dir ? 0 : FS_ERROR_INVALID_DIRHANDLE;
+            break;
+        }
+        case IOCTL_FSA_CLOSEDIR: {
+            emu_dir_t *dir = emu_dir(w[1]);
+            if (dir) {
+                closedir(dir->dir);
+                dir->used = 0;
+            }
+            result = dir ? 0 : FS_ERROR_INVALID_DIRHANDLE;
+            break;
+        }
+        case IOCTL_FSA_CHDIR: {
+            emu_client_t *client = emu_client(w[0]);
+            const char *path     = emu_string(in, in_len, w[1]);
+            result               = emu_request_path(w[0], in, in_len, w[1], host_path);
+            if (result != 0)
+                break;
+
+            struct stat st;
+            if (stat(host_path, &st) != 0) {
+                result = emu_fs_error(errno);
+            } else if (!S_ISDIR(st.st_mode)) {
+                result = FS_ERROR_NOT_DIR;
+            } else {
+                char cwd[EMU_FSA_PATH_MAX * 2];
+                int len = (path[0] == '/') ? snprintf(cwd, sizeof(cwd), "%s", path) : snprintf(cwd, sizeof(cwd), "%s/%s", client->cwd, path);
+                if (len < 0 || len >= (int) sizeof(client->cwd))
+                    result = FS_ERROR_INVALID_PATH;
+                else
+                    memcpy(client->cwd, cwd, len + 1);
+            }
+            break;
+        }
+        case IOCTL_FSA_OPENFILE:
+        case IOCTL_FSA_OPENFILE_STAT: {
+            if (request == IOCTL_FSA_OPENFILE_STAT && !emu_feature(IOSUHAX_HOST_FEATURE_OPENFILE_STAT)) {
+                res = IOS_ERROR_INVALID;
+                goto done;
+            }
+
+            const char *mode = emu_string(in, in_len, w[2]);
+            result           = emu_request_path(w[0], in, in_len, w[1], host_path);
+            if (result != 0)
+                break;
+            if (!mode) {
+                result = FS_ERROR_INVALID_PARAM;
+                break;
+            }
+
+            int handle = 0;
+            result     = emu_openfile(host_path, mode, &handle);
+            if (result != 0 || request == IOCTL_FSA_OPENFILE) {
+                emu_put_word(out, out_len, 1, handle);
+                break;
+            }
+
+            // result, handle, FSStat, size_hi, size_lo
+            struct stat st;
+            if (out_len < 8 + sizeof(FSStat) + 8 || fstat(emu_file(handle)->fd, &st) != 0) {
+                result = (out_len < 8 + sizeof(FSStat) + 8) ? FS_ERROR_INVALID_BUFFER : emu_fs_error(errno);
+                emu_closefile(handle);
+                break;
+            }
+
+            emu_fs_stat(&st, (FSStat *) (out + 8));
+            emu_put_word(out, out_len, 1, handle);
+            emu_put_word(out + 8 + sizeof(FSStat), 8, 0, (uint32_t) ((uint64_t) st.st_size >> 32));
+            emu_put_word(out + 8 + sizeof(FSStat), 8, 1, (uint32_t) st.st_size);
+            break;
+        }
+        case IOCTL_FSA_READFILE:
+            // result word, data at offset 0x40
+            if ((uint64_t) w[1] * w[2] + 0x40 > out_len) {
+                result = FS_ERROR_INVALID_BUFFER;
+                break;
+            }
+            result = emu_readfile(w[3], w[1], w[2], out + 0x40);
+            break;
+
+        case IOCTL_FSA_WRITEFILE:
+            // data at offset 0x40 of the input
+            if ((uint64_t) w[1] * w[2] + 0x40 > in_len) {
+                result = FS_ERROR_INVALID_BUFFER;
+                break;
+            }
+            result = emu_writefile(w[3], w[1], w[2], in + 0x40);
+            break;
+
+        case IOCTL_FSA_STATFILE:
+            if (out_len < 4 + sizeof(FSStat)) {
+                result = FS_ERROR_INVALID_BUFFER;
+                break;
+            }
+            result = emu_statfile(w[1], (FSStat *) (out + 4));
+            break;
+
+        case IOCTL_FSA_CLOSEFILE:
+            result = emu_closefile(w[1]);
+            break;
+
+        case IOCTL_FSA_SETFILEPOS:
+        case IOCTL_FSA_SETFILEPOS64: {
+            if (request == IOCTL_FSA_SETFILEPOS64 && !emu_feature(IOSUHAX_HOST_FEATURE_FILEPOS64)) {
+                res = IOS_ERROR_INVALID;
+                goto done;
+            }
+
+            emu_file_t *file = emu_file(w[1]);
+            if (file)
+                file->pos = (request == IOCTL_FSA_SETFILEPOS) ? w[2] : (((uint64_t) w[2] << 32) | w[3]);
+            result = file ? 0 : FS_ERROR_INVALID_FILEHANDLE;
+            break;
+        }
+        case IOCTL_FSA_GETFILEPOS64: {
+            if (!emu_feature(IOSUHAX_HOST_FEATURE_FILEPOS64)) {
+                res = IOS_ERROR_INVALID;
+                goto done;
+            }
+
+            emu_file_t *file = emu_file(w[1]);
+            if (file) {
+                emu_put_word(out, out_len, 1, (uint32_t) (file->pos >> 32));
+                emu_put_word(out, out_len, 2, (uint32_t) file->pos);
+            }
+            result = file ? 0 : FS_ERROR_INVALID_FILEHANDLE;
+            break;
+        }
+        case IOCTL_FSA_GETSTAT:
+            if (out_len < 4 + sizeof(FSStat)) {
+                result = FS_ERROR_INVALID_BUFFER;
+                break;
+            }
+            result = emu_request_path(w[0], in, in_len, w[1], host_path);
+            if (result == 0)
+                result = emu_getstat(host_path, (FSStat *) (out + 4));
+            break;
+
+        case IOCTL_FSA_REMOVE:
+            result = emu_request_path(w[0], in, in_len, w[1], host_path);
+            if (result == 0)
+                result = emu_remove(host_path);
+            break;
+
+        case IOCTL_FSA_CHANGEMODE:
+            result = emu_request_path(w[0], in, in_len, w[1], host_path);
+            if (result == 0 && chmod(host_path, emu_unix_mode(w[2])) != 0)
+                result = emu_fs_error(errno);
+            break;
+
+        case IOCTL_FSA_RAW_OPEN: {
+            const char *device_path             = emu_string(in, in_len, w[1]);
+            const iosuhax_host_device_t *device = device_path ? emu_device(device_path) : NULL;
+            if (!emu_client(w[0])) {
+                result = FS_ERROR_INVALID_CLIENTHANDLE;
+                break;
+            }
+            if (!device || !device->image) {
+                result = FS_ERROR_NOT_FOUND;
+                break;
+            }
+
+            int index = 0;
+            while (index < EMU_RAWS && emu.raws[index].used)
+                index++;
+            if (index == EMU_RAWS) {
+                result = FS_ERROR_MAX_FILES;
+                break;
+            }
+
+            int fd = open(device->image, O_RDWR);
+            if (fd < 0) {
+                result = emu_fs_error(errno);
+                break;
+            }
+            emu.raws[index].used = 1;
+            emu.raws[index].fd   = fd;
+            emu_put_word(out, out_len, 1, EMU_RAW_BASE + index);
+            break;
+        }
+        case IOCTL_FSA_RAW_READ:
+        case IOCTL_FSA_RAW_WRITE: {
+            // RAW_READ: result word, data at offset 0x40. RAW_WRITE: data at offset 0x40 of the input
+            uint64_t size   = (uint64_t) w[1] * w[2];
+            uint64_t sector = ((uint64_t) w[3] << 32) | w[4];
+            if (request == IOCTL_FSA_RAW_READ) {
+                result = (size + 0x40 > out_len) ? FS_ERROR_INVALID_BUFFER : emu_raw_transfer(w[5], w[1], w[2], sector, out + 0x40, 0);
+            } else {
+                result = (size + 0x40 > in_len) ? FS_ERROR_INVALID_BUFFER : emu_raw_transfer(w[5], w[1], w[2], sector, (uint8_t *) in + 0x40, 1);
+            }
+            break;
+        }
+        case IOCTL_FSA_RAW_CLOSE: {
+            emu_raw_t *raw = emu_raw(w[1]);
+            if (raw) {
+                close(raw->fd);
+                raw->used = 0;
+            }
+            result = raw ? 0 : FS_ERROR_INVALID_FILEHANDLE;
+            break;
+        }
+        case IOCTL_FSA_BATCH:
+            if (!emu_feature(IOSUHAX_HOST_FEATURE_BATCH)) {
+                res = IOS_ERROR_INVALID;
+                goto done;
+            }
+            res = emu_batch(in, in_len, out, out_len);
+            goto done;
+
+        default:
+            // the request is not handled, the reply is left alone like IOSU does
+            res = IOS_ERROR_INVALID;
+            goto done;
+    }
+
+    // every FSA reply starts with the FSA result
+    emu_put_word(out, out_len, 0, result);
+
+done:
+    pthread_mutex_unlock(&emu.lock);
+    return res;
+}
+
+static int emu_handle_slot(int handle) {
+    int slot = handle - EMU_IOS_HANDLE_BASE;
+    if (slot < 0 || slot >= EMU_IOS_HANDLES || !__atomic_load_n(&emu.handleUsed[slot], __ATOMIC_ACQUIRE))
+        return -1;
+    return slot;
+}
+
+//! the client a FSA request works on, NULL for requests that are not tied to one
+static pthread_mutex_t *emu_client_lock(uint32_t request, ios_vec_t *vecs) {
+    if (request <= IOCTL_FSA_OPEN || request == IOCTL_CHECK_IF_IOSUHAX || !vecs[0].vaddr)
+        return NULL;
+
+    uint32_t index = emu_word((const uint8_t *) vecs[0].vaddr, vecs[0].len, 0) - EMU_CLIENT_BASE;
+    return index < EMU_CLIENTS ? &emu.clientLocks[index] : NULL;
+}
+
+static int emu_dispatch(int handle, uint32_t request, ios_vec_t *vecs, uint32_t vec_in, uint32_t vec_out, int vectored) {
+    int slot = emu_handle_slot(handle);
+    if (slot < 0)
+        return IOS_ERROR_INVALID;
+
+    pthread_mutex_t *clientLock = emu_client_lock(request, vecs);
+
+    pthread_mutex_lock(&emu.handleLocks[slot]);
+    if (clientLock)
+        pthread_mutex_lock(clientLock);
+    emu_latency();
+    int res = emu_execute(request, vecs, vec_in, vec_out, vectored);
+    if (clientLock)
+        pthread_mutex_unlock(clientLock);
+    pthread_mutex_unlock(&emu.handleLocks[slot]);
+    return res;
+}
+
+//! Runs the async requests in submission order. All requests queued at the time the worker wakes
+//! up are executed before any of them completes, with 'reorder' set they complete in reverse order.
+static void *emu_worker(void *arg) {
+    (void) arg;
+
+    pthread_mutex_lock(&emu.jobLock);
+    while (1) {
+        while (!emu.jobHead && !emu.stop)
+            pthread_cond_wait(&emu.jobCond, &emu.jobLock);
+        if (!emu.jobHead)
+            break;
+
+        emu_job_t *jobs = emu.jobHead;
+        emu.jobHead     = NULL;
+        emu.jobTail     = NULL;
+        pthread_mutex_unlock(&emu.jobLock);
+
+        emu_job_t *completed = NULL;
+        while (jobs) {
+            emu_job_t *job = jobs;
+            jobs           = job->next;
+            job->result    = emu_dispatch(job->handle, job->request, job->vecs, job->vec_in, job->vec_out, job->vectored);
+
+            // prepending reverses the order
+            job->next = completed;
+            completed = job;
+        }
+
+        if (!emu.config.reorder) {
+            emu_job_t *ordered = NULL;
+            while (completed) {
+                emu_job_t *job = completed;
+                completed      = job->next;
+                job->next      = ordered;
+                ordered        = job;
+            }
+            completed = ordered;
+        }
+
+        while (completed) {
+            emu_job_t *job = completed;
+            completed      = job->next;
+            job->callback(job->result, job->context);
+            free(job);
+        }
+
+        pthread_mutex_lock(&emu.jobLock);
+    }
+    pthread_mutex_unlock(&emu.jobLock);
+    return NULL;
+}
+
+static int emu_queue(int handle, uint32_t request, const ios_vec_t *vecs, uint32_t vec_in, uint32_t vec_out, int vectored, ios_async_callback_t callback, void *context) {
+    if (emu_handle_slot(handle) < 0)
+        return IOS_ERROR_INVALID;
+    if (vec_in + vec_out > 4)
+        return IOS_ERROR_INVALID;
+
+    emu_job_t *job = (emu_job_t *) calloc(1, sizeof(emu_job_t));
+    if (!job)
+        return IOS_ERROR_MAX;
+
+    job->handle   = handle;
+    job->request  = request;
+    job->vec_in   = vec_in;
+    job->vec_out  = vec_out;
+    job->vectored = vectored;
+    job->callback = callback;
+    job->context  = context;
+    memcpy(job->vecs, vecs, sizeof(ios_vec_t) * (vec_in + vec_out));
+
+    pthread_mutex_lock(&emu.jobLock);
+    if (emu.jobTail)
+        emu.jobTail->next = job;
+    else
+        emu.jobHead = job;
+    emu.jobTail = job;
+    pthread_cond_signal(&emu.jobCond);
+    pthread_mutex_unlock(&emu.jobLock);
+    return 0;
+}
+
+int IOS_Open(char *path, unsigned int mode) {
+    (void) mode;
+
+    if (!emu.initialized || strcmp(path, "/dev/iosuhax") != 0)
+        return IOS_ERROR_NOEXISTS;
+
+    for (int slot = 0; slot < EMU_IOS_HANDLES; slot++) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&emu.handleUsed[slot], &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            return EMU_IOS_HANDLE_BASE + slot;
+    }
+    return IOS_ERROR_MAX;
+}
+
+int IOS_Close(int fd) {
+    int slot = emu_handle_slot(fd);
+    if (slot < 0)
+        return IOS_ERROR_INVALID;
+
+    __atomic_store_n(&emu.handleUsed[slot], 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int IOS_Ioctl(int fd, unsigned int request, void *input_buffer, unsigned int input_buffer_len, void *output_buffer, unsigned int output_buffer_len) {
+    ios_vec_t vecs[2] = {{0, input_buffer_len, input_buffer}, {0, output_buffer_len, output_buffer}};
+    return emu_dispatch(fd, request, vecs, 1, 1, 0);
+}
+
+int IOS_IoctlAsync(int fd, unsigned int request, void *input_buffer, unsigned int input_buffer_len, void *output_buffer, unsigned int output_buffer_len, ios_async_callback_t callback, void *context) {
+    ios_vec_t vecs[2] = {{0, input_buffer_len, input_buffer}, {0, output_buffer_len, output_buffer}};
+    return emu_queue(fd, request, vecs, 1, 1, 0, callback, context);
+}
+
+int IOS_Ioctlv(int fd, unsigned int request, unsigned int vector_count_in, unsigned int vector_count_out, ios_vec_t *vector) {
+    return emu_dispatch(fd, request, vector, vector_count_in, vector_count_out, 1);
+}
+
+int IOS_IoctlvAsync(int fd, unsigned int request, unsigned int vector_count_in, unsigned int vector_count_out, ios_vec_t *vector, ios_async_callback_t callback, void *context) {
+    return emu_queue(fd, request, vector, vector_count_in, vector_count_out, 1, callback, context);
+}
+
+//! SEEPROM words for IOSUHAX_read_seeprom, stored in the image in console byte order
+int bspRead(const char *entity, uint32_t instance, const char *attribute, uint32_t size, uint16_t *out) {
+    if (strcmp(entity, "EE") != 0 || strcmp(attribute, "access") != 0 || size != 2 || instance >= sizeof(emu.seeprom) / 2)
+        return -1;
+
+    memcpy(out, emu.seeprom + instance * 2, 2);
+    return 0;
+}
+
+int iosuhax_host_init(const iosuhax_host_config_t *config) {
+    if (emu.initialized)
+        return -1;
+
+    memset(&emu, 0, sizeof(emu));
+    emu.config = *config;
+
+    if (emu.config.ram_size) {
+        emu.ram = (uint8_t *) calloc(1, emu.config.ram_size);
+        if (!emu.ram)
+            return -1;
+    }
+    emu_load_image(config->otp, emu.otp, sizeof(emu.otp));
+    emu_load_image(config->seeprom, emu.seeprom, sizeof(emu.seeprom));
+
+    pthread_mutex_init(&emu.lock, NULL);
+    for (int i = 0; i < EMU_IOS_HANDLES; i++)
+        pthread_mutex_init(&emu.handleLocks[i], NULL);
+    for (int i = 0; i < EMU_CLIENTS; i++)
+        pthread_mutex_init(&emu.clientLocks[i], NULL);
+    pthread_mutex_init(&emu.jobLock, NULL);
+    pthread_cond_init(&emu.jobCond, NULL);
+
+    emu.features = config->features;
+    emu.latency  = config->latency_us;
+
+    if (pthread_create(&emu.worker, NULL, emu_worker, NULL) != 0) {
+        free(emu.ram);
+        return -1;
+    }
+
+    emu.initialized = 1;
+    return 0;
+}
+
+void iosuhax_host_shutdown(void) {
+    if (!emu.initialized)
+        return;
+
+    pthread_mutex_lock(&emu.jobLock);
+    emu.stop = 1;
+    pthread_cond_signal(&emu.jobCond);
+    pthread_mutex_unlock(&emu.jobLock);
+    pthread_join(emu.worker, NULL);
+
+    for (int i = 0; i < EMU_FILES; i++) {
+        if (emu.files[i].used)
+            close(emu.files[i].fd);
+    }
+    for (int i = 0; i < EMU_DIRS; i++) {
+        if (emu.dirs[i].used)
+            closedir(emu.dirs[i].dir);
+    }
+    for (int i = 0; i < EMU_RAWS; i++) {
+        if (emu.raws[i].used)
+            close(emu.raws[i].fd);
+    }
+
+    free(emu.ram);
+    emu.ram         = NULL;
+    emu.initialized = 0;
+}
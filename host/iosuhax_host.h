@@ -0,0 +1,119 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#ifndef __IOSUHAX_HOST_H_
+#define __IOSUHAX_HOST_H_
+
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/iosupport.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! IOSU side of /dev/iosuhax for host builds. Requests are decoded with the layouts documented in
+//! source/iosuhax_ipc.h and served from a directory tree, a RAM region and disk image files.
+
+//! optional requests, a disabled one is rejected the way an IOSU without it rejects it
+#define IOSUHAX_HOST_FEATURE_IOCTLV         (1 << 0) // vectored READFILE/WRITEFILE/RAW_READ/RAW_WRITE
+#define IOSUHAX_HOST_FEATURE_READDIR_MULTI  (1 << 1)
+#define IOSUHAX_HOST_FEATURE_OPENFILE_STAT  (1 << 2)
+#define IOSUHAX_HOST_FEATURE_FILEPOS64      (1 << 3)
+#define IOSUHAX_HOST_FEATURE_BATCH          (1 << 4)
+#define IOSUHAX_HOST_FEATURE_ALL            0x1F
+
+//! not part of IOSUHAX_HOST_FEATURE_ALL: vectored requests succeed without being handled and leave the
+//! result vector untouched, like an IOSU that routes ioctlv but has no handler for it
+#define IOSUHAX_HOST_QUIRK_IOCTLV_NO_RESULT (1 << 5)
+
+#define IOSUHAX_HOST_DEVICES_MAX 4
+
+typedef struct {
+    const char *device_path; // e.g. "/dev/sdcard01"
+    const char *image;       // disk image served by RAW_OPEN/READ/WRITE, NULL if the device has none
+    const char *directory;   // directory a MOUNT of the device maps its volume path to, NULL if it can't be mounted
+} iosuhax_host_device_t;
+
+typedef struct {
+    const char *root;     // FSA paths outside of a mounted volume are resolved below this directory
+    uint32_t ram_address; // IOSU address of the RAM region served by the MEM and KERN requests
+    uint32_t ram_size;
+    const char *otp;      // 0x400 byte OTP image, zeros if NULL
+    const char *seeprom;  // 0x200 byte SEEPROM image for bspRead, zeros if NULL
+    iosuhax_host_device_t devices[IOSUHAX_HOST_DEVICES_MAX];
+    uint32_t features;   // IOSUHAX_HOST_FEATURE_*
+    uint32_t latency_us; // minimum time every request takes, models the IPC round trip (the host sleep granularity adds to it).
+                         // Requests on different IOS handles overlap, requests on the same FSA client run one at a time.
+    int reorder;         // async requests queued together complete in reverse order
+} iosuhax_host_config_t;
+
+//! root ".", a 1 MiB RAM region at 0x10000000, every feature and no latency
+void iosuhax_host_default_config(iosuhax_host_config_t *config);
+
+//! the configuration is copied, the strings have to stay valid until iosuhax_host_shutdown
+int iosuhax_host_init(const iosuhax_host_config_t *config);
+
+//! closes everything IOSU side, the library has to be closed before
+void iosuhax_host_shutdown(void);
+
+//! changes the optional requests at run time, the library only probes them once per process
+void iosuhax_host_set_features(uint32_t features);
+
+void iosuhax_host_set_latency(uint32_t latency_us);
+
+//! total number of requests served since iosuhax_host_init
+uint64_t iosuhax_host_request_count(void);
+
+//! newlib style calls dispatching "name:/path" through devoptab_list, they set errno and return -1 on failure
+int iosuhax_host_open(const char *path, int flags, int mode);
+
+int iosuhax_host_close(int fd);
+
+ssize_t iosuhax_host_read(int fd, void *buf, size_t len);
+
+ssize_t iosuhax_host_write(int fd, const void *buf, size_t len);
+
+off_t iosuhax_host_lseek(int fd, off_t pos, int whence);
+
+int iosuhax_host_fstat(int fd, struct stat *st);
+
+int iosuhax_host_stat(const char *path, struct stat *st);
+
+int iosuhax_host_unlink(const char *path);
+
+int iosuhax_host_mkdir(const char *path, int mode);
+
+DIR_ITER *iosuhax_host_diropen(const char *path);
+
+int iosuhax_host_dirnext(DIR_ITER *dir, char *filename, struct stat *st); // filename holds NAME_MAX + 1 bytes
+
+int iosuhax_host_dirclose(DIR_ITER *dir);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __IOSUHAX_HOST_H_
@@ -0,0 +1,488 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax.h"
+#include "iosuhax_host.h"
+#include "iosuhax_ipc.h"
+#include <byteswap.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+//! Replays a request trace recorded with IOSUHAX_TraceStart through the public IOSUHAX_* API against
+//! the host emulator and reports throughput and latency per request type.
+//!
+//! The trace file is the record buffer written out as is, on the console that is big endian. The
+//! byte order is detected from the request codes, so traces recorded with a host build work as well.
+//!
+//! Records only carry the request code, the sizes and the timing. Every request is mapped to the public
+//! call that sends it, with the payload size taken from the record, against a generated fixture: one
+//! file and one raw image of the fixture size and a directory of small files. Requests that can't be
+//! derived from a record (SVC, MOUNT, BATCH, ...) are counted as skipped.
+
+#define REPLAY_BUFFER_SIZE  (4 * 1024 * 1024)
+#define REPLAY_DIR_ENTRIES  64
+#define REPLAY_HANDLES      32
+#define REPLAY_SAMPLES_MAX  (1024 * 1024)
+#define REPLAY_SECTOR_SIZE  0x200
+
+typedef struct {
+    uint32_t count;
+    uint64_t bytes;
+    uint64_t trace_us; // time the request took in the trace
+    uint32_t sample_cnt;
+    uint32_t *samples; // replay latencies in microseconds
+} replay_op_stats_t;
+
+static replay_op_stats_t replayStats[IOSUHAX_STATS_REQUEST_COUNT];
+static uint32_t replaySkipped;
+
+static int fsaFd;
+static int fileHandles[REPLAY_HANDLES];
+static uint32_t fileHandleCnt;
+static int fileHandle; // used by requests that carry a handle
+static int dirHandle;
+static int rawHandle;
+static uint64_t fixtureSize;
+static uint64_t rawSector;
+static uint8_t *replayBuffer;
+
+static const char *replay_op_name(uint32_t request) {
+    switch (request) {
+        case IOCTL_MEM_WRITE:         return "MEM_WRITE";
+        case IOCTL_MEM_READ:          return "MEM_READ";
+        case IOCTL_SVC:               return "SVC";
+        case IOCTL_MEMCPY:            return "MEMCPY";
+        case IOCTL_KERN_READ32:       return "KERN_READ32";
+        case IOCTL_KERN_WRITE32:      return "KERN_WRITE32";
+        case IOCTL_READ_OTP:          return "READ_OTP";
+        case IOCTL_FSA_OPEN:          return "FSA_OPEN";
+        case IOCTL_FSA_CLOSE:         return "FSA_CLOSE";
+        case IOCTL_FSA_MOUNT:         return "MOUNT";
+        case IOCTL_FSA_UNMOUNT:       return "UNMOUNT";
+        case IOCTL_FSA_GETDEVICEINFO: return "GETDEVICEINFO";
+        case IOCTL_FSA_OPENDIR:       return "OPENDIR";
+        case IOCTL_FSA_READDIR:       return "READDIR";
+        case IOCTL_FSA_CLOSEDIR:      return "CLOSEDIR";
+        case IOCTL_FSA_MAKEDIR:       return "MAKEDIR";
+        case IOCTL_FSA_OPENFILE:      return "OPENFILE";
+        case IOCTL_FSA_READFILE:      return "READFILE";
+        case IOCTL_FSA_WRITEFILE:     return "WRITEFILE";
+        case IOCTL_FSA_STATFILE:      return "STATFILE";
+        case IOCTL_FSA_CLOSEFILE:     return "CLOSEFILE";
+        case IOCTL_FSA_SETFILEPOS:    return "SETFILEPOS";
+        case IOCTL_FSA_GETSTAT:       return "GETSTAT";
+        case IOCTL_FSA_REMOVE:        return "REMOVE";
+        case IOCTL_FSA_REWINDDIR:     return "REWINDDIR";
+        case IOCTL_FSA_CHDIR:         return "CHDIR";
+        case IOCTL_FSA_RAW_OPEN:      return "RAW_OPEN";
+        case IOCTL_FSA_RAW_READ:      return "RAW_READ";
+        case IOCTL_FSA_RAW_WRITE:     return "RAW_WRITE";
+        case IOCTL_FSA_RAW_CLOSE:     return "RAW_CLOSE";
+        case IOCTL_FSA_CHANGEMODE:    return "CHANGEMODE";
+        case IOCTL_FSA_FLUSHVOLUME:   return "FLUSHVOLUME";
+        case IOCTL_CHECK_IF_IOSUHAX:  return "CHECK_IF_IOSUHAX";
+        case IOCTL_FSA_BATCH:         return "BATCH";
+        case IOCTL_FSA_READDIR_MULTI: return "READDIR_MULTI";
+        case IOCTL_FSA_OPENFILE_STAT: return "OPENFILE_STAT";
+        case IOCTL_FSA_SETFILEPOS64:  return "SETFILEPOS64";
+        case IOCTL_FSA_GETFILEPOS64:  return "GETFILEPOS64";
+    }
+    return "UNKNOWN";
+}
+
+static uint64_t replay_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//! Payload of a data request. The ioctl form carries it at offset 0x40 of the request or reply, the
+//! ioctlv form in a vector of its own next to the 'header' bytes of input words or the result word.
+static uint32_t replay_payload(uint32_t size, uint32_t header) {
+    if (size >= header && ((size - header) & 0x3F) == 0)
+        return size - header;
+    return size > 0x40 ? size - 0x40 : 0;
+}
+
+static uint32_t replay_clamp(uint32_t size) {
+    return size < REPLAY_BUFFER_SIZE ? size : REPLAY_BUFFER_SIZE;
+}
+
+static int replay_open_file(const char *mode) {
+    int handle;
+    int res = IOSUHAX_FSA_OpenFile(fsaFd, "/vol/replay/file.bin", mode, &handle);
+    if (res < 0)
+        return res;
+
+    if (fileHandleCnt == REPLAY_HANDLES) {
+        IOSUHAX_FSA_CloseFile(fsaFd, fileHandles[0]);
+        memmove(fileHandles, fileHandles + 1, sizeof(int) * (REPLAY_HANDLES - 1));
+        fileHandleCnt--;
+    }
+    fileHandles[fileHandleCnt++] = handle;
+    return 0;
+}
+
+//! Sends the request(s) the record stands for, returns the payload size or -1 if the record is skipped.
+static int64_t replay_request(const IOSUHAX_TraceRecord *record) {
+    FSStat stat;
+    FSDirectoryEntry entries[IOSUHAX_READDIR_MULTI_MAX];
+    uint64_t pos;
+    uint32_t size;
+
+    switch (record->request) {
+        case IOCTL_MEM_READ:
+            size = replay_clamp(record->out_size);
+            IOSUHAX_memread(0x10000000, replayBuffer, size < 0x100000 ? size : 0x100000);
+            return size;
+        case IOCTL_MEM_WRITE:
+            size = replay_clamp(record->in_size > 4 ? record->in_size - 4 : 0);
+            IOSUHAX_memwrite(0x10000000, replayBuffer, size < 0x100000 ? size : 0x100000);
+            return size;
+        case IOCTL_KERN_READ32:
+            IOSUHAX_kern_read32(0x10000000, (uint32_t *) replayBuffer, record->out_size / 4 < 0x40000 ? record->out_size / 4 : 0x40000);
+            return record->out_size;
+        case IOCTL_KERN_WRITE32:
+            IOSUHAX_kern_write32(0x10000000, 0);
+            return 0;
+        case IOCTL_READ_OTP:
+            IOSUHAX_read_otp(replayBuffer, 0x400);
+            return 0x400;
+        case IOCTL_FSA_GETDEVICEINFO:
+            IOSUHAX_FSA_GetDeviceInfo(fsaFd, "/dev/sdcard01", 0, (uint32_t *) replayBuffer);
+            return 0;
+        case IOCTL_FSA_OPENDIR:
+            if (dirHandle)
+                IOSUHAX_FSA_CloseDir(fsaFd, dirHandle);
+            dirHandle = 0;
+            IOSUHAX_FSA_OpenDir(fsaFd, "/vol/replay/dir", &dirHandle);
+            return 0;
+        case IOCTL_FSA_READDIR:
+        case IOCTL_FSA_READDIR_MULTI: {
+            uint32_t cnt = (record->request == IOCTL_FSA_READDIR) ? 1 : (record->out_size - 4) / sizeof(FSDirectoryEntry);
+            if (cnt == 0 || cnt > IOSUHAX_READDIR_MULTI_MAX)
+                cnt = IOSUHAX_READDIR_MULTI_MAX;
+            if (!dirHandle)
+                IOSUHAX_FSA_OpenDir(fsaFd, "/vol/replay/dir", &dirHandle);
+            if (IOSUHAX_FSA_ReadDirMulti(fsaFd, dirHandle, entries, cnt) <= 0)
+                IOSUHAX_FSA_RewindDir(fsaFd, dirHandle);
+            return 0;
+        }
+        case IOCTL_FSA_REWINDDIR:
+            IOSUHAX_FSA_RewindDir(fsaFd, dirHandle);
+            return 0;
+        case IOCTL_FSA_CLOSEDIR:
+            if (dirHandle)
+                IOSUHAX_FSA_CloseDir(fsaFd, dirHandle);
+            dirHandle = 0;
+            return 0;
+        case IOCTL_FSA_MAKEDIR:
+            IOSUHAX_FSA_MakeDir(fsaFd, "/vol/replay/made", 0x660);
+            return 0;
+        case IOCTL_FSA_REMOVE:
+            IOSUHAX_FSA_Remove(fsaFd, "/vol/replay/made");
+            return 0;
+        case IOCTL_FSA_CHDIR:
+            IOSUHAX_FSA_ChangeDir(fsaFd, "/vol/replay");
+            return 0;
+        case IOCTL_FSA_CHANGEMODE:
+            IOSUHAX_FSA_ChangeMode(fsaFd, "/vol/replay/file.bin", 0x666);
+            return 0;
+        case IOCTL_FSA_FLUSHVOLUME:
+            IOSUHAX_FSA_FlushVolume(fsaFd, "/vol/replay");
+            return 0;
+        case IOCTL_FSA_GETSTAT:
+            IOSUHAX_FSA_GetStat(fsaFd, "/vol/replay/file.bin", &stat);
+            return 0;
+        case IOCTL_FSA_OPENFILE:
+            replay_open_file("r+");
+            return 0;
+        case IOCTL_FSA_OPENFILE_STAT: {
+            int handle;
+            if (IOSUHAX_FSA_OpenFileStat(fsaFd, "/vol/replay/file.bin", "r+", &handle, &stat, &pos) == 0)
+                IOSUHAX_FSA_CloseFile(fsaFd, handle);
+            return 0;
+        }
+        case IOCTL_FSA_CLOSEFILE:
+            if (fileHandleCnt == 0)
+                return -1;
+            IOSUHAX_FSA_CloseFile(fsaFd, fileHandles[--fileHandleCnt]);
+            return 0;
+        case IOCTL_FSA_STATFILE:
+            IOSUHAX_FSA_StatFile(fsaFd, fileHandle, &stat);
+            return 0;
+        case IOCTL_FSA_SETFILEPOS:
+        case IOCTL_FSA_SETFILEPOS64:
+            IOSUHAX_FSA_SetFilePos64(fsaFd, fileHandle, 0);
+            return 0;
+        case IOCTL_FSA_GETFILEPOS64:
+            IOSUHAX_FSA_GetFilePos64(fsaFd, fileHandle, &pos);
+            return 0;
+        case IOCTL_FSA_READFILE:
+            size = replay_clamp(replay_payload(record->out_size, 4));
+            if (size && IOSUHAX_FSA_ReadFile(fsaFd, replayBuffer, 1, size, fileHandle, 0) < (int) size)
+                IOSUHAX_FSA_SetFilePos64(fsaFd, fileHandle, 0);
+            return size;
+        case IOCTL_FSA_WRITEFILE:
+            size = replay_clamp(replay_payload(record->in_size, 0x14));
+            if (size)
+                IOSUHAX_FSA_WriteFile(fsaFd, replayBuffer, 1, size, fileHandle, 0);
+            // the fixture keeps its size
+            IOSUHAX_FSA_GetFilePos64(fsaFd, fileHandle, &pos);
+            if (pos >= fixtureSize)
+                IOSUHAX_FSA_SetFilePos64(fsaFd, fileHandle, 0);
+            return size;
+        case IOCTL_FSA_RAW_READ:
+        case IOCTL_FSA_RAW_WRITE: {
+            size = (record->request == IOCTL_FSA_RAW_READ) ? replay_payload(record->out_size, 4) : replay_payload(record->in_size, 0x18);
+            uint32_t blocks = replay_clamp(size) / REPLAY_SECTOR_SIZE;
+            if (blocks == 0)
+                blocks = 1;
+            if ((rawSector + blocks) * REPLAY_SECTOR_SIZE > fixtureSize)
+                rawSector = 0;
+            if (record->request == IOCTL_FSA_RAW_READ)
+                IOSUHAX_FSA_RawRead(fsaFd, replayBuffer, REPLAY_SECTOR_SIZE, blocks, rawSector, rawHandle);
+            else
+                IOSUHAX_FSA_RawWrite(fsaFd, replayBuffer, REPLAY_SECTOR_SIZE, blocks, rawSector, rawHandle);
+            rawSector += blocks;
+            return blocks * REPLAY_SECTOR_SIZE;
+        }
+    }
+    return -1;
+}
+
+static int replay_compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static int replay_fixture(const char *dir, uint64_t size) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/volume", dir);
+    if (mkdir(path, 0777) != 0)
+        return -1;
+    snprintf(path, sizeof(path), "%s/volume/dir", dir);
+    if (mkdir(path, 0777) != 0)
+        return -1;
+    for (int i = 0; i < REPLAY_DIR_ENTRIES; i++) {
+        snprintf(path, sizeof(path), "%s/volume/dir/entry%03d.bin", dir, i);
+        int fd = open(path, O_WRONLY | O_CREAT, 0666);
+        if (fd < 0 || write(fd, path, 16) != 16)
+            return -1;
+        close(fd);
+    }
+
+    const char *files[] = {"volume/file.bin", "raw.img"};
+    for (int i = 0; i < 2; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+        int fd = open(path, O_WRONLY | O_CREAT, 0666);
+        if (fd < 0 || ftruncate(fd, size) != 0)
+            return -1;
+        close(fd);
+    }
+    return 0;
+}
+
+static void replay_usage(void) {
+    fprintf(stderr, "usage: iosuhax_replay [-t] [-l latency_us] [-f features] [-s fixture_size] trace.bin\n"
+                    "  -t  keep the request start times of the trace instead of replaying back to back\n"
+                    "  -l  latency the emulator adds to every request\n"
+                    "  -f  IOSUHAX_HOST_FEATURE_* mask of the emulated IOSU, all by default\n"
+                    "  -s  size of the fixture file and raw image, 64 MiB by default\n");
+}
+
+int main(int argc, char **argv) {
+    int keepTiming    = 0;
+    uint32_t latency  = 0;
+    uint32_t features = IOSUHAX_HOST_FEATURE_ALL;
+    fixtureSize       = 64 * 1024 * 1024;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "tl:f:s:")) != -1) {
+        switch (opt) {
+            case 't':
+                keepTiming = 1;
+                break;
+            case 'l':
+                latency = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                features = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                fixtureSize = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                replay_usage();
+                return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        replay_usage();
+        return 1;
+    }
+
+    FILE *f = fopen(argv[optind], "rb");
+    if (!f) {
+        perror(argv[optind]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint32_t recordCnt           = fileSize / sizeof(IOSUHAX_TraceRecord);
+    IOSUHAX_TraceRecord *records = (IOSUHAX_TraceRecord *) malloc(recordCnt ? recordCnt * sizeof(IOSUHAX_TraceRecord) : 1);
+    if (!records || fread(records, sizeof(IOSUHAX_TraceRecord), recordCnt, f) != recordCnt) {
+        fprintf(stderr, "failed to read %s\n", argv[optind]);
+        return 1;
+    }
+    fclose(f);
+
+    // request codes are below 0x100, a swapped one is not
+    int swap = 0;
+    for (uint32_t i = 0; i < recordCnt && !swap; i++)
+        swap = records[i].request > 0xFFFF;
+    if (swap) {
+        for (uint32_t i = 0; i < recordCnt; i++) {
+            uint32_t *words = (uint32_t *) &records[i];
+            for (uint32_t w = 0; w < sizeof(IOSUHAX_TraceRecord) / 4; w++)
+                words[w] = bswap_32(words[w]);
+        }
+    }
+
+    char dir[] = "/tmp/iosuhax_replay_XXXXXX";
+    char volume[512], image[512];
+    if (!mkdtemp(dir) || replay_fixture(dir, fixtureSize) != 0) {
+        fprintf(stderr, "failed to create the fixture\n");
+        return 1;
+    }
+    snprintf(volume, sizeof(volume), "%s/volume", dir);
+    snprintf(image, sizeof(image), "%s/raw.img", dir);
+
+    iosuhax_host_config_t config;
+    iosuhax_host_default_config(&config);
+    config.root                   = dir;
+    config.devices[0].device_path = "/dev/sdcard01";
+    config.devices[0].image       = image;
+    config.devices[0].directory   = volume;
+    config.features               = features;
+    config.latency_us             = latency;
+
+    replayBuffer = (uint8_t *) aligned_alloc(0x40, REPLAY_BUFFER_SIZE);
+    if (!replayBuffer || iosuhax_host_init(&config) != 0 || IOSUHAX_Open(NULL) < 0) {
+        fprintf(stderr, "failed to start the emulator\n");
+        return 1;
+    }
+    memset(replayBuffer, 0x5A, REPLAY_BUFFER_SIZE);
+
+    fsaFd = IOSUHAX_FSA_Open();
+    if (fsaFd < 0 || IOSUHAX_FSA_Mount(fsaFd, "/dev/sdcard01", "/vol/replay", 2, NULL, 0) != 0 ||
+        IOSUHAX_FSA_OpenFile(fsaFd, "/vol/replay/file.bin", "r+", &fileHandle) != 0 ||
+        IOSUHAX_FSA_RawOpen(fsaFd, "/dev/sdcard01", &rawHandle) != 0) {
+        fprintf(stderr, "failed to set up the fixture volume\n");
+        return 1;
+    }
+
+    uint64_t replayStart = replay_now_us();
+    uint64_t busy        = 0;
+    for (uint32_t i = 0; i < recordCnt; i++) {
+        const IOSUHAX_TraceRecord *record = &records[i];
+        if (record->request >= IOSUHAX_STATS_REQUEST_COUNT) {
+            replaySkipped++;
+            continue;
+        }
+
+        if (keepTiming) {
+            uint64_t now = replay_now_us() - replayStart;
+            if (record->start_us > now)
+                usleep(record->start_us - now);
+        }
+
+        uint64_t start = replay_now_us();
+        int64_t bytes  = replay_request(record);
+        uint64_t time  = replay_now_us() - start;
+        if (bytes < 0) {
+            replaySkipped++;
+            continue;
+        }
+        busy += time;
+
+        replay_op_stats_t *stats = &replayStats[record->request];
+        if (!stats->samples)
+            stats->samples = (uint32_t *) malloc(sizeof(uint32_t) * REPLAY_SAMPLES_MAX);
+        if (stats->samples && stats->sample_cnt < REPLAY_SAMPLES_MAX)
+            stats->samples[stats->sample_cnt++] = (uint32_t) time;
+        stats->count++;
+        stats->bytes += bytes;
+        stats->trace_us += record->time_us;
+    }
+    uint64_t total = replay_now_us() - replayStart;
+
+    printf("# %u records, %u skipped, %llu us replayed, %llu us in requests, %llu emulator requests\n", recordCnt, replaySkipped,
+           (unsigned long long) total, (unsigned long long) busy, (unsigned long long) iosuhax_host_request_count());
+    printf("%-16s %8s %12s %10s %10s %10s %10s %12s\n", "op", "count", "bytes", "avg_us", "p50_us", "p99_us", "MiB/s", "trace_avg_us");
+
+    for (uint32_t request = 0; request < IOSUHAX_STATS_REQUEST_COUNT; request++) {
+        replay_op_stats_t *stats = &replayStats[request];
+        if (!stats->count)
+            continue;
+
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < stats->sample_cnt; i++)
+            sum += stats->samples[i];
+        qsort(stats->samples, stats->sample_cnt, sizeof(uint32_t), replay_compare_u32);
+
+        double avg = (double) sum / stats->sample_cnt;
+        double mib = sum ? (double) stats->bytes / (1024.0 * 1024.0) / ((double) sum / 1000000.0) : 0.0;
+        printf("%-16s %8u %12llu %10.1f %10u %10u %10.1f %12.1f\n", replay_op_name(request), stats->count, (unsigned long long) stats->bytes, avg,
+               stats->samples[stats->sample_cnt / 2], stats->samples[(uint32_t) (stats->sample_cnt * 0.99)], mib,
+               (double) stats->trace_us / stats->count);
+        free(stats->samples);
+    }
+
+    while (fileHandleCnt)
+        IOSUHAX_FSA_CloseFile(fsaFd, fileHandles[--fileHandleCnt]);
+    if (dirHandle)
+        IOSUHAX_FSA_CloseDir(fsaFd, dirHandle);
+    IOSUHAX_FSA_CloseFile(fsaFd, fileHandle);
+    IOSUHAX_FSA_RawClose(fsaFd, rawHandle);
+    IOSUHAX_FSA_Unmount(fsaFd, "/vol/replay", 2);
+    IOSUHAX_FSA_Close(fsaFd);
+    IOSUHAX_Close();
+    iosuhax_host_shutdown();
+
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", dir);
+    if (system(cmd) != 0)
+        fprintf(stderr, "failed to remove %s\n", dir);
+
+    free(records);
+    free(replayBuffer);
+    return 0;
+}
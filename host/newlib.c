@@ -0,0 +1,262 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax_host.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! Host replacement for the parts of devkitPPC's newlib the devoptab relies on: the device table,
+//! the handle table behind file descriptors and the per thread reent structure.
+
+#define HOST_HANDLES_MAX 256
+
+static __thread struct _reent hostReent;
+
+struct _reent *__getreent(void) {
+    return &hostReent;
+}
+
+static const devoptab_t hostStdNull = {.name = "stdnull"};
+
+//! a slot is free while it points to the same table as slot 0, the devoptab adds itself from slot 3 on
+const devoptab_t *devoptab_list[STD_MAX] = {
+        &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull,
+        &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull, &hostStdNull,
+};
+
+static __handle hostHandles[HOST_HANDLES_MAX];
+static pthread_mutex_t hostHandleLock = PTHREAD_MUTEX_INITIALIZER;
+
+__handle *__get_handle(int fd) {
+    if (fd < 0 || fd >= HOST_HANDLES_MAX || hostHandles[fd].refcount == 0)
+        return NULL;
+    return &hostHandles[fd];
+}
+
+//! Returns the index of the device "path" starts with, -1 if there is none.
+static int host_find_device(const char *path) {
+    const char *colon = strchr(path, ':');
+    if (!colon)
+        return -1;
+
+    size_t len = colon - path;
+    for (int i = 3; i < STD_MAX; i++) {
+        const devoptab_t *devoptab = devoptab_list[i];
+        if (devoptab == devoptab_list[0] || !devoptab->name)
+            continue;
+        if (strlen(devoptab->name) == len && strncmp(devoptab->name, path, len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+//! Runs a devoptab call and moves its error to errno the way newlib does.
+#define HOST_CALL(call)                  \
+    ({                                   \
+        struct _reent *r = __getreent(); \
+        r->_errno        = 0;            \
+        __auto_type res  = (call);       \
+        if (r->_errno)                   \
+            errno = r->_errno;           \
+        res;                             \
+    })
+
+int iosuhax_host_open(const char *path, int flags, int mode) {
+    int device = host_find_device(path);
+    if (device < 0) {
+        errno = ENODEV;
+        return -1;
+    }
+
+    const devoptab_t *devoptab = devoptab_list[device];
+    if (!devoptab->open_r) {
+        errno = ENOSYS;
+        return -1;
+    }
+
+    void *fileStruct = calloc(1, devoptab->structSize);
+    if (!fileStruct) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    pthread_mutex_lock(&hostHandleLock);
+    int fd = 3;
+    while (fd < HOST_HANDLES_MAX && hostHandles[fd].refcount)
+        fd++;
+    if (fd == HOST_HANDLES_MAX) {
+        pthread_mutex_unlock(&hostHandleLock);
+        free(fileStruct);
+        errno = EMFILE;
+        return -1;
+    }
+    hostHandles[fd].device     = device;
+    hostHandles[fd].fileStruct = fileStruct;
+    hostHandles[fd].refcount   = 1;
+    pthread_mutex_unlock(&hostHandleLock);
+
+    // the devoptabs expect newlib's flag values
+    int newlibFlags = (flags & O_ACCMODE) == O_RDWR ? 2 : (flags & O_ACCMODE) == O_WRONLY ? 1 : 0;
+    if (flags & O_APPEND)
+        newlibFlags |= 0x0008;
+    if (flags & O_CREAT)
+        newlibFlags |= 0x0200;
+    if (flags & O_TRUNC)
+        newlibFlags |= 0x0400;
+    if (flags & O_EXCL)
+        newlibFlags |= 0x0800;
+
+    if (HOST_CALL(devoptab->open_r(__getreent(), fileStruct, path, newlibFlags, mode)) == -1) {
+        pthread_mutex_lock(&hostHandleLock);
+        hostHandles[fd].refcount = 0;
+        pthread_mutex_unlock(&hostHandleLock);
+        free(fileStruct);
+        return -1;
+    }
+    return fd;
+}
+
+int iosuhax_host_close(int fd) {
+    __handle *handle = __get_handle(fd);
+    if (!handle) {
+        errno = EBADF;
+        return -1;
+    }
+
+    const devoptab_t *devoptab = devoptab_list[handle->device];
+    int res                    = devoptab->close_r ? HOST_CALL(devoptab->close_r(__getreent(), handle->fileStruct)) : 0;
+
+    pthread_mutex_lock(&hostHandleLock);
+    free(handle->fileStruct);
+    handle->fileStruct = NULL;
+    handle->refcount   = 0;
+    pthread_mutex_unlock(&hostHandleLock);
+    return res;
+}
+
+ssize_t iosuhax_host_read(int fd, void *buf, size_t len) {
+    __handle *handle = __get_handle(fd);
+    if (!handle) {
+        errno = EBADF;
+        return -1;
+    }
+    return HOST_CALL(devoptab_list[handle->device]->read_r(__getreent(), handle->fileStruct, (char *) buf, len));
+}
+
+ssize_t iosuhax_host_write(int fd, const void *buf, size_t len) {
+    __handle *handle = __get_handle(fd);
+    if (!handle) {
+        errno = EBADF;
+        return -1;
+    }
+    return HOST_CALL(devoptab_list[handle->device]->write_r(__getreent(), handle->fileStruct, (const char *) buf, len));
+}
+
+off_t iosuhax_host_lseek(int fd, off_t pos, int whence) {
+    __handle *handle = __get_handle(fd);
+    if (!handle) {
+        errno = EBADF;
+        return -1;
+    }
+    return HOST_CALL(devoptab_list[handle->device]->seek_r(__getreent(), handle->fileStruct, pos, whence));
+}
+
+int iosuhax_host_fstat(int fd, struct stat *st) {
+    __handle *handle = __get_handle(fd);
+    if (!handle) {
+        errno = EBADF;
+        return -1;
+    }
+    return HOST_CALL(devoptab_list[handle->device]->fstat_r(__getreent(), handle->fileStruct, st));
+}
+
+int iosuhax_host_stat(const char *path, struct stat *st) {
+    int device = host_find_device(path);
+    if (device < 0) {
+        errno = ENODEV;
+        return -1;
+    }
+    return HOST_CALL(devoptab_list[device]->stat_r(__getreent(), path, st));
+}
+
+int iosuhax_host_unlink(const char *path) {
+    int device = host_find_device(path);
+    if (device < 0) {
+        errno = ENODEV;
+        return -1;
+    }
+    return HOST_CALL(devoptab_list[device]->unlink_r(__getreent(), path));
+}
+
+int iosuhax_host_mkdir(const char *path, int mode) {
+    int device = host_find_device(path);
+    if (device < 0) {
+        errno = ENODEV;
+        return -1;
+    }
+    return HOST_CALL(devoptab_list[device]->mkdir_r(__getreent(), path, mode));
+}
+
+DIR_ITER *iosuhax_host_diropen(const char *path) {
+    int device = host_find_device(path);
+    if (device < 0) {
+        errno = ENODEV;
+        return NULL;
+    }
+
+    const devoptab_t *devoptab = devoptab_list[device];
+
+    DIR_ITER *dir = (DIR_ITER *) malloc(sizeof(DIR_ITER));
+    if (!dir) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    dir->device    = device;
+    dir->dirStruct = calloc(1, devoptab->dirStateSize);
+    if (!dir->dirStruct) {
+        free(dir);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (!HOST_CALL(devoptab->diropen_r(__getreent(), dir, path))) {
+        free(dir->dirStruct);
+        free(dir);
+        return NULL;
+    }
+    return dir;
+}
+
+int iosuhax_host_dirnext(DIR_ITER *dir, char *filename, struct stat *st) {
+    return HOST_CALL(devoptab_list[dir->device]->dirnext_r(__getreent(), dir, filename, st));
+}
+
+int iosuhax_host_dirclose(DIR_ITER *dir) {
+    int res = HOST_CALL(devoptab_list[dir->device]->dirclose_r(__getreent(), dir));
+    free(dir->dirStruct);
+    free(dir);
+    return res;
+}
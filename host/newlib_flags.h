@@ -0,0 +1,47 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#ifndef __NEWLIB_FLAGS_H_
+#define __NEWLIB_FLAGS_H_
+
+//! Forced into the library sources: devoptab open_r sees the open flags with newlib's values, like
+//! on the console. iosuhax_host_open translates the host's flags to these.
+#include <fcntl.h>
+
+#undef O_RDONLY
+#undef O_WRONLY
+#undef O_RDWR
+#undef O_APPEND
+#undef O_CREAT
+#undef O_TRUNC
+#undef O_EXCL
+
+#define O_RDONLY 0
+#define O_WRONLY 1
+#define O_RDWR   2
+#define O_APPEND 0x0008
+#define O_CREAT  0x0200
+#define O_TRUNC  0x0400
+#define O_EXCL   0x0800
+
+#endif // __NEWLIB_FLAGS_H_
@@ -0,0 +1,291 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax.h"
+#include "iosuhax_devoptab.h"
+#include "iosuhax_host.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//! Runs the wrappers, the devoptab, raw access and async requests once against the emulator.
+//! usage: smoke [IOSUHAX_HOST_FEATURE_* mask], 0 runs every fallback path
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return 1;                                                                 \
+        }                                                                             \
+    } while (0)
+
+static int smoke_mem(void) {
+    uint8_t data[16] = {0x11, 0x22, 0x33, 0x44};
+    uint8_t back[16];
+    uint32_t word;
+
+    CHECK(IOSUHAX_memwrite(0x10000000, data, sizeof(data)) >= 0);
+    CHECK(IOSUHAX_memread(0x10000000, back, sizeof(back)) >= 0);
+    CHECK(memcmp(data, back, sizeof(data)) == 0);
+
+    // RAM holds the console's big endian image
+    CHECK(IOSUHAX_kern_read32(0x10000000, &word, 1) >= 0);
+    CHECK(word == 0x11223344);
+    CHECK(IOSUHAX_kern_write32(0x10000004, 0xAABBCCDD) >= 0);
+    CHECK(IOSUHAX_memread(0x10000004, back, 4) >= 0);
+    CHECK(back[0] == 0xAA && back[3] == 0xDD);
+
+    CHECK(IOSUHAX_memread(0x20000000, back, 4) < 0);
+    return 0;
+}
+
+static int smoke_fsa(int fsaFd) {
+    int handle;
+    FSStat stat;
+    uint64_t size;
+    char data[100];
+    int res;
+
+    CHECK(IOSUHAX_FSA_MakeDir(fsaFd, "/vol/sd/dir", 0x666) == 0);
+    CHECK(IOSUHAX_FSA_MakeDir(fsaFd, "/vol/sd/dir", 0x666) == FS_ERROR_ALREADY_EXISTS);
+    CHECK(IOSUHAX_FSA_OpenFile(fsaFd, "/vol/sd/dir/a.bin", "w", &handle) == 0);
+    CHECK(IOSUHAX_FSA_WriteFile(fsaFd, "hello world", 1, 11, handle, 0) == 11);
+    CHECK(IOSUHAX_FSA_CloseFile(fsaFd, handle) == 0);
+
+    CHECK(IOSUHAX_FSA_OpenFileStat(fsaFd, "/vol/sd/dir/a.bin", "r", &handle, &stat, &size) == 0);
+    CHECK(size == 11 && stat.size == 11 && (stat.flags & FS_STAT_DIRECTORY) == 0);
+    CHECK(IOSUHAX_FSA_SetFilePos64(fsaFd, handle, 6) == 0);
+    size = 0;
+    CHECK(IOSUHAX_FSA_ReadFile(fsaFd, data, 1, sizeof(data), handle, 0) == 5);
+    CHECK(memcmp(data, "world", 5) == 0);
+    res = IOSUHAX_FSA_GetFilePos64(fsaFd, handle, &size);
+    CHECK((res == 0 && size == 11) || res == FS_STATUS_UNSUPPORTED_CMD);
+    CHECK(IOSUHAX_FSA_CloseFile(fsaFd, handle) == 0);
+
+    CHECK(IOSUHAX_FSA_GetStat(fsaFd, "/vol/sd/missing", &stat) == FS_ERROR_NOT_FOUND);
+    CHECK(IOSUHAX_FSA_GetStat(fsaFd, "/vol/sd/../etc", &stat) == FS_ERROR_INVALID_PATH);
+
+    FSDirectoryEntry entries[4];
+    CHECK(IOSUHAX_FSA_OpenDir(fsaFd, "/vol/sd/dir", &handle) == 0);
+    CHECK(IOSUHAX_FSA_ReadDirMulti(fsaFd, handle, entries, 4) == 1);
+    CHECK(strcmp(entries[0].name, "a.bin") == 0);
+    CHECK(IOSUHAX_FSA_ReadDir(fsaFd, handle, entries) == FS_ERROR_END_OF_DIR);
+    CHECK(IOSUHAX_FSA_CloseDir(fsaFd, handle) == 0);
+
+    IOSUHAX_Batch *batch = IOSUHAX_CreateBatch(fsaFd, 4);
+    int results[4];
+    CHECK(batch);
+    CHECK(IOSUHAX_Batch_OpenFile(batch, "/vol/sd/dir/a.bin", "r", &handle) == 0);
+    CHECK(IOSUHAX_Batch_ReadFile(batch, data, 1, 5, IOSUHAX_BATCH_OP_HANDLE(0), 0) == 1);
+    CHECK(IOSUHAX_Batch_CloseFile(batch, IOSUHAX_BATCH_OP_HANDLE(0)) == 2);
+    CHECK(IOSUHAX_Batch_Submit(batch, results) == 3);
+    CHECK(results[0] == 0 && results[1] == 5 && results[2] == 0);
+    CHECK(memcmp(data, "hello", 5) == 0);
+    IOSUHAX_DestroyBatch(batch);
+    return 0;
+}
+
+//! runs before smoke_raw, so the aligned read is the first vectored raw request
+static int smoke_async_raw(int fsaFd) {
+    IOSUHAX_AsyncQueue *queue = IOSUHAX_CreateAsyncQueue(2);
+    IOSUHAX_AsyncResult result;
+    static uint8_t sector[0x240] __attribute__((aligned(0x40)));
+    int handle;
+
+    CHECK(queue);
+    for (int i = 0; i < 512; i++)
+        sector[i + 1] = (uint8_t) i;
+
+    // the unaligned write goes through the staging copy
+    CHECK(IOSUHAX_FSA_RawOpen(fsaFd, "/dev/sdcard01", &handle) == 0);
+    CHECK(IOSUHAX_FSA_RawWrite(fsaFd, sector + 1, 512, 1, 5, handle) >= 0);
+    memset(sector, 0, sizeof(sector));
+    CHECK(IOSUHAX_FSA_RawReadAsync(queue, fsaFd, sector, 512, 1, 5, handle, NULL) == 0);
+    CHECK(IOSUHAX_WaitAsyncQueue(queue, &result) == 1 && result.result >= 0);
+    CHECK(sector[1] == 1 && sector[511] == 0xFF);
+    CHECK(IOSUHAX_FSA_RawClose(fsaFd, handle) == 0);
+    CHECK(IOSUHAX_DestroyAsyncQueue(queue) == 0);
+    return 0;
+}
+
+static int smoke_raw(int fsaFd) {
+    int handle;
+    uint8_t sector[512];
+    uint8_t back[512];
+
+    for (int i = 0; i < 512; i++)
+        sector[i] = (uint8_t) i;
+
+    CHECK(IOSUHAX_FSA_RawOpen(fsaFd, "/dev/sdcard01", &handle) == 0);
+    CHECK(IOSUHAX_FSA_RawWrite(fsaFd, sector, 512, 1, 3, handle) >= 0);
+    CHECK(IOSUHAX_FSA_RawRead(fsaFd, back, 512, 1, 3, handle) >= 0);
+    CHECK(memcmp(sector, back, sizeof(back)) == 0);
+    CHECK(IOSUHAX_FSA_RawClose(fsaFd, handle) == 0);
+    return 0;
+}
+
+static int smoke_async(int fsaFd) {
+    IOSUHAX_AsyncQueue *queue = IOSUHAX_CreateAsyncQueue(8);
+    IOSUHAX_AsyncResult result;
+    char data[4][4];
+    int handle;
+
+    CHECK(queue);
+    CHECK(IOSUHAX_FSA_OpenFile(fsaFd, "/vol/sd/dir/a.bin", "r", &handle) == 0);
+    for (int i = 0; i < 4; i++)
+        CHECK(IOSUHAX_FSA_ReadFileAsync(queue, fsaFd, data[i], 1, 2, handle, 0, (void *) (intptr_t) i) == 0);
+
+    int seen = 0;
+    while (IOSUHAX_WaitAsyncQueue(queue, &result) == 1) {
+        CHECK(result.result == 2);
+        seen++;
+    }
+    CHECK(seen == 4);
+
+    // submitted in order, every request continues where the one before ended
+    CHECK(memcmp(data[0], "he", 2) == 0 && memcmp(data[3], "wo", 2) == 0);
+    CHECK(IOSUHAX_FSA_CloseFile(fsaFd, handle) == 0);
+    CHECK(IOSUHAX_DestroyAsyncQueue(queue) == 0);
+    return 0;
+}
+
+static int smoke_devoptab(int fsaFd) {
+    struct stat st;
+    char data[32];
+
+    CHECK(mount_fs("sd", fsaFd, NULL, "/vol/sd") == 0);
+
+    int fd = iosuhax_host_open("sd:/dir/b.txt", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    CHECK(fd >= 0);
+    CHECK(iosuhax_host_write(fd, "0123456789", 10) == 10);
+    errno = 0;
+    CHECK(mount_fs_pread(fd, data, 4, 0) == -1 && errno == EACCES);
+    CHECK(iosuhax_host_close(fd) == 0);
+
+    CHECK(iosuhax_host_stat("sd:/dir/b.txt", &st) == 0 && st.st_size == 10);
+
+    fd = iosuhax_host_open("sd:/dir/b.txt", O_RDONLY, 0);
+    CHECK(fd >= 0);
+    CHECK(iosuhax_host_fstat(fd, &st) == 0 && st.st_size == 10);
+    CHECK(iosuhax_host_lseek(fd, -4, SEEK_END) == 6);
+    CHECK(iosuhax_host_read(fd, data, sizeof(data)) == 4);
+    CHECK(memcmp(data, "6789", 4) == 0);
+    errno = EINTR;
+    CHECK(mount_fs_pread(fd, data, 4, 2) == 4 && memcmp(data, "2345", 4) == 0 && errno == EINTR);
+    CHECK(mount_fs_pread(fd, data, 4, 10) == 0 && errno == EINTR);
+    CHECK(iosuhax_host_close(fd) == 0);
+
+    CHECK(iosuhax_host_unlink("sd:/dir/b.txt") == 0);
+    CHECK(iosuhax_host_stat("sd:/dir/b.txt", &st) == -1);
+    CHECK(unmount_fs("sd") == 0);
+    return 0;
+}
+
+//! a write through one file has to be seen by cached reads through another
+static int smoke_devoptab_cached(int fsaFd) {
+    struct stat st;
+    char data[32];
+
+    mount_fs_options_t options = {0};
+    options.page_cache_size    = 4 * 0x4000;
+    options.stat_cache_size    = 16;
+    options.fsa_handle_count   = 2;
+    CHECK(mount_fs_ex("sc", fsaFd, NULL, "/vol/sd", &options) == 0);
+
+    int fd = iosuhax_host_open("sc:/c.txt", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    CHECK(fd >= 0);
+    CHECK(iosuhax_host_write(fd, "aaaaaaaa", 8) == 8);
+    CHECK(iosuhax_host_close(fd) == 0);
+
+    int rfd = iosuhax_host_open("sc:/c.txt", O_RDONLY, 0);
+    CHECK(rfd >= 0);
+    CHECK(iosuhax_host_read(rfd, data, 8) == 8 && memcmp(data, "aaaaaaaa", 8) == 0);
+    CHECK(iosuhax_host_stat("sc:/c.txt", &st) == 0 && st.st_size == 8);
+
+    fd = iosuhax_host_open("sc:/c.txt", O_RDWR, 0);
+    CHECK(fd >= 0);
+    CHECK(iosuhax_host_write(fd, "bbbbbbbbbbbb", 12) == 12);
+    CHECK(iosuhax_host_close(fd) == 0);
+
+    CHECK(iosuhax_host_lseek(rfd, 0, SEEK_SET) == 0);
+    CHECK(iosuhax_host_read(rfd, data, sizeof(data)) == 12 && memcmp(data, "bbbbbbbbbbbb", 12) == 0);
+    CHECK(iosuhax_host_stat("sc:/c.txt", &st) == 0 && st.st_size == 12);
+    CHECK(iosuhax_host_close(rfd) == 0);
+
+    mount_fs_stats_t stats;
+    CHECK(mount_fs_get_stats("sc", &stats) == 0);
+    CHECK(stats.page_cache_misses >= 2);
+
+    CHECK(iosuhax_host_unlink("sc:/c.txt") == 0);
+    CHECK(unmount_fs("sc") == 0);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    char scratch[] = "/tmp/iosuhax_smoke_XXXXXX";
+    const char *dir = mkdtemp(scratch);
+    char sd[512], image[512];
+
+    if (!dir)
+        return 1;
+    snprintf(sd, sizeof(sd), "%s/sd", dir);
+    snprintf(image, sizeof(image), "%s/sd.img", dir);
+    mkdir(sd, 0777);
+    if (truncate(image, 0x10000) != 0) {
+        int fd = open(image, O_RDWR | O_CREAT, 0666);
+        if (fd < 0 || ftruncate(fd, 0x10000) != 0)
+            return 1;
+        close(fd);
+    }
+
+    iosuhax_host_config_t config;
+    iosuhax_host_default_config(&config);
+    config.root                   = dir;
+    config.devices[0].device_path = "/dev/sdcard01";
+    config.devices[0].image       = image;
+    config.devices[0].directory   = sd;
+    config.reorder                = 1;
+    if (argc > 1)
+        config.features = strtoul(argv[1], NULL, 0);
+    CHECK(iosuhax_host_init(&config) == 0);
+
+    CHECK(IOSUHAX_Open(NULL) >= 0);
+    int fsaFd = IOSUHAX_FSA_Open();
+    CHECK(fsaFd >= 0);
+    CHECK(IOSUHAX_FSA_Mount(fsaFd, "/dev/sdcard01", "/vol/sd", 2, NULL, 0) == 0);
+
+    int res = smoke_mem() || smoke_fsa(fsaFd) || smoke_async_raw(fsaFd) || smoke_raw(fsaFd) || smoke_async(fsaFd) || smoke_devoptab(fsaFd) ||
+              smoke_devoptab_cached(fsaFd);
+
+    IOSUHAX_FSA_Unmount(fsaFd, "/vol/sd", 2);
+    IOSUHAX_FSA_Close(fsaFd);
+    IOSUHAX_Close();
+    iosuhax_host_shutdown();
+
+    printf("%s, %llu requests\n", res ? "FAILED" : "ok", (unsigned long long) iosuhax_host_request_count());
+    return res;
+}
@@ -38,7 +38,13 @@ extern "C" {
 #define FSA_MOUNTFLAGS_BINDMOUNT (1 << 0)
 #define FSA_MOUNTFLAGS_GLOBAL    (1 << 1)
 
+#define IOSUHAX_MAX_HANDLES 3 // one per PPC core
+
 int IOSUHAX_Open(const char *dev); // if dev == NULL the default path /dev/iosuhax will be used
+int IOSUHAX_OpenEx(const char *dev, uint32_t handle_cnt); // opens up to handle_cnt handles, requests use the handle of the calling core
+//! Waits for the requests in flight on other threads, async ones until they complete, then closes the handles.
+//! Requests that start afterwards fail with -1. Threads on the same core still share a handle, and async
+//! queues outlive the handles, they only fail their new requests until IOSUHAX_Open is called again.
 int IOSUHAX_Close(void);
 
 int IOSUHAX_memwrite(uint32_t address, const uint8_t *buffer, uint32_t size); // IOSU external input
@@ -75,6 +81,11 @@ int IOSUHAX_FSA_OpenDir(int fsaFd, const char *path, int *outHandle);
 
 int IOSUHAX_FSA_ReadDir(int fsaFd, int handle, FSDirectoryEntry *out_data);
 
+#define IOSUHAX_READDIR_MULTI_MAX 16 // entries read per request, larger counts are split
+
+// reads up to max_cnt entries, returns the number read or, if not even one could be read, the same error ReadDir returns
+int IOSUHAX_FSA_ReadDirMulti(int fsaFd, int handle, FSDirectoryEntry *out_data, uint32_t max_cnt);
+
 int IOSUHAX_FSA_RewindDir(int fsaFd, int dirHandle);
 
 int IOSUHAX_FSA_CloseDir(int fsaFd, int handle);
@@ -83,6 +94,11 @@ int IOSUHAX_FSA_ChangeDir(int fsaFd, const char *path);
 
 int IOSUHAX_FSA_OpenFile(int fsaFd, const char *path, const char *mode, int *outHandle);
 
+// opens the file and stats it with one request where IOSU supports it, the file is not left open if either step fails.
+// outSize receives the full 64 bit file size, FSStat only has the low 32 bits.
+int IOSUHAX_FSA_OpenFileStat(int fsaFd, const char *path, const char *mode, int *outHandle, FSStat *out_data, uint64_t *outSize);
+
+// data aligned to 0x40 with a total size that is a multiple of 0x40 is transferred without a staging copy
 int IOSUHAX_FSA_ReadFile(int fsaFd, void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags);
 
 int IOSUHAX_FSA_WriteFile(int fsaFd, const void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags);
@@ -93,6 +109,12 @@ int IOSUHAX_FSA_CloseFile(int fsaFd, int fileHandle);
 
 int IOSUHAX_FSA_SetFilePos(int fsaFd, int fileHandle, uint32_t position);
 
+// positions past 4 GiB fail with FS_STATUS_FILE_TOO_BIG if IOSU only supports 32 bit positions
+int IOSUHAX_FSA_SetFilePos64(int fsaFd, int fileHandle, uint64_t position);
+
+// fails with FS_STATUS_UNSUPPORTED_CMD if IOSU only supports 32 bit positions
+int IOSUHAX_FSA_GetFilePos64(int fsaFd, int fileHandle, uint64_t *outPosition);
+
 int IOSUHAX_FSA_GetStat(int fsaFd, const char *path, FSStat *out_data);
 
 int IOSUHAX_FSA_Remove(int fsaFd, const char *path);
@@ -101,12 +123,136 @@ int IOSUHAX_FSA_ChangeMode(int fsaFd, const char *path, int mode);
 
 int IOSUHAX_FSA_RawOpen(int fsaFd, const char *device_path, int *outHandle);
 
+// data aligned to 0x40 with a total size that is a multiple of 0x40 is transferred without a staging copy
 int IOSUHAX_FSA_RawRead(int fsaFd, void *data, uint32_t block_size, uint32_t block_cnt, uint64_t sector_offset, int device_handle);
 
 int IOSUHAX_FSA_RawWrite(int fsaFd, const void *data, uint32_t block_size, uint32_t block_cnt, uint64_t sector_offset, int device_handle);
 
 int IOSUHAX_FSA_RawClose(int fsaFd, int device_handle);
 
+#define IOSUHAX_RAW_CHUNK_SIZE_DEFAULT (1024 * 1024)
+
+// Raw transfers larger than chunk_size that need a staging copy are split into chunks, 0 disables splitting
+void IOSUHAX_SetRawChunkSize(uint32_t chunk_size);
+
+//! Asynchronous requests: every *Async call queues one request and returns immediately.
+//! Its completion is reported through IOSUHAX_PollAsyncQueue/IOSUHAX_WaitAsyncQueue together
+//! with the cookie given on submission. Output buffers and handles are only valid after that.
+//! The requests of a queue are executed in submission order, so reads and writes continue at the file
+//! position the previous request left. Completions may be reported in any order.
+typedef struct _IOSUHAX_AsyncQueue IOSUHAX_AsyncQueue;
+
+typedef struct {
+    void *cookie; // value passed on submission
+    int result;   // same value the synchronous function would have returned
+} IOSUHAX_AsyncResult;
+
+IOSUHAX_AsyncQueue *IOSUHAX_CreateAsyncQueue(uint32_t depth); // depth = max number of requests in flight
+
+int IOSUHAX_DestroyAsyncQueue(IOSUHAX_AsyncQueue *queue); // fails while requests are in flight
+
+int IOSUHAX_PollAsyncQueue(IOSUHAX_AsyncQueue *queue, IOSUHAX_AsyncResult *result); // returns 1 if a result was taken, 0 if none is ready
+
+int IOSUHAX_WaitAsyncQueue(IOSUHAX_AsyncQueue *queue, IOSUHAX_AsyncResult *result); // returns 1 if a result was taken, 0 if nothing is in flight
+
+int IOSUHAX_FSA_OpenDirAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, const char *path, int *outHandle, void *cookie);
+
+int IOSUHAX_FSA_ReadDirAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, int handle, FSDirectoryEntry *out_data, void *cookie);
+
+int IOSUHAX_FSA_CloseDirAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, int handle, void *cookie);
+
+int IOSUHAX_FSA_OpenFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, const char *path, const char *mode, int *outHandle, void *cookie);
+
+int IOSUHAX_FSA_ReadFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags, void *cookie);
+
+int IOSUHAX_FSA_WriteFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, const void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags, void *cookie);
+
+int IOSUHAX_FSA_StatFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, int fileHandle, FSStat *out_data, void *cookie);
+
+int IOSUHAX_FSA_CloseFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, int fileHandle, void *cookie);
+
+int IOSUHAX_FSA_RawReadAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, void *data, uint32_t block_size, uint32_t block_cnt, uint64_t sector_offset, int device_handle, void *cookie);
+
+int IOSUHAX_FSA_RawWriteAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, const void *data, uint32_t block_size, uint32_t block_cnt, uint64_t sector_offset, int device_handle, void *cookie);
+
+//! Batches: record several FSA operations and send them to IOSU in one request.
+//! Every IOSUHAX_Batch_* call returns the index of the recorded operation or a negative error.
+//! Output pointers are filled by IOSUHAX_Batch_Submit, which also stores one result per operation.
+//! If IOSU does not understand batches, the operations are dispatched one by one instead.
+typedef struct _IOSUHAX_Batch IOSUHAX_Batch;
+
+//! use as file handle to refer to the handle returned by an earlier OpenFile in the same batch
+#define IOSUHAX_BATCH_OP_HANDLE(op_index) (-0x10000 - (int) (op_index))
+
+IOSUHAX_Batch *IOSUHAX_CreateBatch(int fsaFd, uint32_t max_ops);
+
+void IOSUHAX_DestroyBatch(IOSUHAX_Batch *batch);
+
+void IOSUHAX_ResetBatch(IOSUHAX_Batch *batch); // drop all recorded operations
+
+int IOSUHAX_Batch_GetStat(IOSUHAX_Batch *batch, const char *path, FSStat *out_data);
+
+int IOSUHAX_Batch_OpenFile(IOSUHAX_Batch *batch, const char *path, const char *mode, int *outHandle);
+
+int IOSUHAX_Batch_ReadFile(IOSUHAX_Batch *batch, void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags);
+
+int IOSUHAX_Batch_CloseFile(IOSUHAX_Batch *batch, int fileHandle);
+
+int IOSUHAX_Batch_Remove(IOSUHAX_Batch *batch, const char *path);
+
+int IOSUHAX_Batch_MakeDir(IOSUHAX_Batch *batch, const char *path, uint32_t flags);
+
+int IOSUHAX_Batch_Submit(IOSUHAX_Batch *batch, int *results); // results: one entry per recorded operation, returns the operation count
+
+typedef struct {
+    uint32_t hits;      // staging buffers served from the pool
+    uint32_t misses;    // staging buffers that had to be allocated
+    uint32_t oversized; // staging buffers too large to be pooled
+    uint32_t cached;    // idle buffers currently held by the pool
+    uint64_t copied;    // payload bytes copied in or out of staging buffers
+} IOSUHAX_BufferStats;
+
+int IOSUHAX_GetBufferStats(IOSUHAX_BufferStats *stats);
+
+void IOSUHAX_ResetBufferStats(void);
+
+//! Per request statistics, only collected if the library is built with IOSUHAX_ENABLE_STATS defined.
+#define IOSUHAX_STATS_REQUEST_COUNT   0x65 // one entry per request code
+#define IOSUHAX_STATS_LATENCY_BUCKETS 20
+
+typedef struct {
+    uint32_t calls;
+    uint32_t errors;     // failed IPC calls and negative FSA results
+    uint32_t allocs;     // staging buffers requested for the call
+    uint64_t bytes_in;   // bytes sent to IOSU
+    uint64_t bytes_out;  // bytes received from IOSU
+    uint32_t latency[IOSUHAX_STATS_LATENCY_BUCKETS]; // latency[n]: calls that took 2^n up to 2^(n+1) microseconds, n = 0 includes faster ones
+} IOSUHAX_IoctlStats;
+
+int IOSUHAX_GetStats(uint32_t request, IOSUHAX_IoctlStats *stats); // request: IOCTL code, returns -1 if statistics are not compiled in
+
+void IOSUHAX_ResetStats(void);
+
+//! Request trace, only available if the library is built with IOSUHAX_ENABLE_TRACE defined.
+//! Every request to /dev/iosuhax appends one record to the buffer given to IOSUHAX_TraceStart,
+//! once the buffer is full further records are dropped.
+#define IOSUHAX_TRACE_HASH_PAYLOAD (1 << 0) // store FNV-1a hashes of the request and reply payloads
+
+typedef struct {
+    uint32_t request;  // IOCTL code
+    uint32_t in_size;  // bytes sent to IOSU
+    uint32_t out_size; // bytes received from IOSU
+    int32_t result;    // IPC result
+    uint32_t start_us; // microseconds since IOSUHAX_TraceStart
+    uint32_t time_us;  // duration of the request
+    uint32_t in_hash;  // 0 unless IOSUHAX_TRACE_HASH_PAYLOAD is set
+    uint32_t out_hash;
+} IOSUHAX_TraceRecord;
+
+int IOSUHAX_TraceStart(IOSUHAX_TraceRecord *buffer, uint32_t max_records, uint32_t flags); // returns -1 if tracing is not compiled in or already running
+
+int IOSUHAX_TraceStop(uint32_t *dropped); // returns the number of records written, dropped receives the number of lost ones
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
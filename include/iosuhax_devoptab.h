@@ -24,18 +24,68 @@
 #ifndef __IOSUHAX_DEVOPTAB_H_
 #define __IOSUHAX_DEVOPTAB_H_
 
+#include <stdint.h>
+#include <sys/types.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+//! recommended read_ahead_size and write_back_size, mount_fs and mount_fs_ex(NULL) keep both disabled
+#define MOUNT_FS_READ_AHEAD_DEFAULT 0x8000
+#define MOUNT_FS_WRITE_BACK_DEFAULT 0x8000
+#define MOUNT_FS_FSA_HANDLES_MAX    4
+
+typedef struct {
+    uint32_t read_ahead_size;     // maximum read-ahead per open file in bytes, 0 disables read-ahead
+    uint32_t write_back_size;     // small writes are collected up to this size per open file, 0 disables write-back
+    uint32_t page_cache_size;     // memory for file pages shared by all files of the mount, 0 disables the cache
+    uint32_t stat_cache_size;     // number of stat results kept per mount, 0 disables the cache
+    uint32_t stat_cache_ttl;      // milliseconds a cached stat result stays valid, 0 keeps it until the path is changed through this mount
+    uint32_t stat_cache_negative; // also cache paths that do not exist
+    uint32_t fsa_handle_count;    // FSA handles used by the files of the mount, up to MOUNT_FS_FSA_HANDLES_MAX, 0 or 1 uses fsaFd only
+    uint32_t read_only;           // refuse everything that modifies the volume with EROFS, namespace requests then run without locking
+} mount_fs_options_t;
+
+typedef struct {
+    uint32_t read_ahead_hits;    // reads served from the read-ahead buffer
+    uint32_t read_ahead_misses;  // reads that had to refill the read-ahead buffer
+    uint32_t write_back_writes;  // writes collected in the write-back buffer
+    uint32_t write_back_flushes; // write-back buffers written to the file
+    uint32_t page_cache_hits;    // pages found in the page cache
+    uint32_t page_cache_misses;  // pages that had to be read
+    uint32_t page_cache_evictions;
+    uint32_t stat_cache_hits;          // stat calls answered from the stat cache
+    uint32_t stat_cache_negative_hits; // stat calls answered with ENOENT from the stat cache
+    uint32_t stat_cache_misses;
+    uint32_t file_lock_waits;      // file requests that had to wait for another thread using the same file or streaming on the same handle
+    uint32_t namespace_lock_waits; // requests that had to wait for a namespace change, or namespace changes that waited for requests
+    uint32_t cache_lock_waits;     // waits for the caches and counters shared by the mount
+} mount_fs_stats_t;
+
 //! virtual name example:   sd or odd (for sd:/ or odd:/ access)
 //! fsaFd:                  fd received by IOSUHAX_FSA_Open();
 //! dev_path:               (optional) if a device should be mounted to the mount_path. If NULL no IOSUHAX_FSA_Mount is not executed.
 //! mount_path:             path to map to virtual device name
 int mount_fs(const char *virt_name, int fsaFd, const char *dev_path, const char *mount_path);
 
+//! same as mount_fs, options == NULL uses the defaults: no read-ahead, write-back or caches and fsaFd only
+int mount_fs_ex(const char *virt_name, int fsaFd, const char *dev_path, const char *mount_path, const mount_fs_options_t *options);
+
+int mount_fs_get_stats(const char *virt_name, mount_fs_stats_t *stats);
+
+void mount_fs_reset_stats(const char *virt_name);
+
+//! waits for calls on the device that are in progress on other threads, files and directories opened
+//! through it have to be closed before
 int unmount_fs(const char *virt_name);
 
+//! read/write at offset on a file opened through a mount_fs device without moving its file position.
+//! Returns -1 with errno set if nothing was transferred because of an error, 0 at the end of the file.
+ssize_t mount_fs_pread(int fd, void *buf, size_t len, off_t offset);
+
+ssize_t mount_fs_pwrite(int fd, const void *buf, size_t len, off_t offset);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,98 +22,94 @@
  * distribution.
  ***************************************************************************/
 #include "iosuhax.h"
+#include "iosuhax_buffer_pool.h"
+#include "iosuhax_ipc.h"
+#include "iosuhax_stats.h"
 #include "os_functions.h"
-#include <malloc.h>
 #include <string.h>
 
-#define IOSUHAX_MAGIC_WORD      0x4E696365
-
-#define IOCTL_MEM_WRITE         0x00
-#define IOCTL_MEM_READ          0x01
-#define IOCTL_SVC               0x02
-#define IOCTL_MEMCPY            0x04
-#define IOCTL_REPEATED_WRITE    0x05
-#define IOCTL_KERN_READ32       0x06
-#define IOCTL_KERN_WRITE32      0x07
-#define IOCTL_READ_OTP          0x08
-
-#define IOCTL_FSA_OPEN          0x40
-#define IOCTL_FSA_CLOSE         0x41
-#define IOCTL_FSA_MOUNT         0x42
-#define IOCTL_FSA_UNMOUNT       0x43
-#define IOCTL_FSA_GETDEVICEINFO 0x44
-#define IOCTL_FSA_OPENDIR       0x45
-#define IOCTL_FSA_READDIR       0x46
-#define IOCTL_FSA_CLOSEDIR      0x47
-#define IOCTL_FSA_MAKEDIR       0x48
-#define IOCTL_FSA_OPENFILE      0x49
-#define IOCTL_FSA_READFILE      0x4A
-#define IOCTL_FSA_WRITEFILE     0x4B
-#define IOCTL_FSA_STATFILE      0x4C
-#define IOCTL_FSA_CLOSEFILE     0x4D
-#define IOCTL_FSA_SETFILEPOS    0x4E
-#define IOCTL_FSA_GETSTAT       0x4F
-#define IOCTL_FSA_REMOVE        0x50
-#define IOCTL_FSA_REWINDDIR     0x51
-#define IOCTL_FSA_CHDIR         0x52
-#define IOCTL_FSA_RENAME        0x53
-#define IOCTL_FSA_RAW_OPEN      0x54
-#define IOCTL_FSA_RAW_READ      0x55
-#define IOCTL_FSA_RAW_WRITE     0x56
-#define IOCTL_FSA_RAW_CLOSE     0x57
-#define IOCTL_FSA_CHANGEMODE    0x58
-#define IOCTL_FSA_FLUSHVOLUME   0x59
-#define IOCTL_CHECK_IF_IOSUHAX  0x5B
-
-static int iosuhaxHandle = -1;
-
-#define ALIGN(align)      __attribute__((aligned(align)))
-#define ALIGN_0x20        ALIGN(0x20)
-#define ROUNDUP(x, align) (((x) + ((align) -1)) & ~((align) -1))
-
-int IOSUHAX_Open(const char *dev) {
-    if (iosuhaxHandle >= 0)
-        return iosuhaxHandle;
-
-    iosuhaxHandle = IOS_Open((char *) (dev ? dev : "/dev/iosuhax"), 0);
-    if (iosuhaxHandle >= 0 && dev) //make sure device is actually iosuhax
-    {
-        ALIGN_0x20 int res[0x20 >> 2];
-        *res = 0;
-
-        IOS_Ioctl(iosuhaxHandle, IOCTL_CHECK_IF_IOSUHAX, (void *) 0, 0, res, 4);
-        if (*res != IOSUHAX_MAGIC_WORD) {
-            IOS_Close(iosuhaxHandle);
-            iosuhaxHandle = -1;
-        }
+int iosuhaxRawIoctlvSupported    = 1;
+int iosuhaxFileIoctlvSupported   = 1;
+int iosuhaxFileIoctlvConfirmed   = 0;
+int iosuhaxOpenFileStatSupported = 1;
+
+#define PATH_REQUEST_MAX_STRINGS 2
+
+//! cleared once IOSU rejects IOCTL_FSA_READDIR_MULTI, directories are then read one entry per request
+static int readDirMultiSupported = 1;
+
+//! cleared once IOSU rejects IOCTL_FSA_SETFILEPOS64/GETFILEPOS64, positions are then limited to 32 bit
+static int filePos64Supported = 1;
+
+//! raw transfers that need a staging copy are split into chunks of this size, 0 disables splitting
+static uint32_t rawChunkSize = IOSUHAX_RAW_CHUNK_SIZE_DEFAULT;
+
+//! Sends the header words and the caller's data buffer as separate vectors so no staging copy is needed.
+//! Returns the IPC result, the result word written by IOSU is stored in 'result'.
+static int IOSUHAX_ioctlv_data(int iosuhaxHandle, uint32_t request, uint32_t *header, uint32_t header_size, void *data, uint32_t data_size, int isWrite, int *result) {
+    ALIGN_0x20 ios_vec_t vecs[3];
+    memset(vecs, 0, sizeof(vecs));
+
+    vecs[0].vaddr = header;
+    vecs[0].len   = header_size;
+
+    if (isWrite) {
+        vecs[1].vaddr = data;
+        vecs[1].len   = data_size;
+        vecs[2].vaddr = result;
+        vecs[2].len   = sizeof(int);
+        return iosuhax_ioctlv(iosuhaxHandle, request, 2, 1, vecs);
     }
 
-    return iosuhaxHandle;
+    vecs[1].vaddr = result;
+    vecs[1].len   = sizeof(int);
+    vecs[2].vaddr = data;
+    vecs[2].len   = data_size;
+    return iosuhax_ioctlv(iosuhaxHandle, request, 1, 2, vecs);
 }
 
-int IOSUHAX_Close(void) {
-    if (iosuhaxHandle < 0)
-        return 0;
+//! Allocates a request of 'word_cnt' header words followed by the given strings. Every string is measured once
+//! and copied right behind the previous one, its offset goes to header word 1 + i. 'tail_size' bytes are
+//! reserved after the strings. The other header words are left to the caller.
+static uint32_t *IOSUHAX_path_request(uint32_t request, uint32_t word_cnt, const char **strings, uint32_t str_cnt, uint32_t tail_size, uint32_t *io_buf_size) {
+    uint32_t lens[PATH_REQUEST_MAX_STRINGS];
+    uint32_t size = sizeof(uint32_t) * word_cnt;
 
-    int res       = IOS_Close(iosuhaxHandle);
-    iosuhaxHandle = -1;
-    return res;
+    for (uint32_t i = 0; i < str_cnt; i++) {
+        lens[i] = strlen(strings[i]) + 1;
+        size += lens[i];
+    }
+
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(request, size + tail_size);
+    if (!io_buf)
+        return NULL;
+
+    uint32_t offset = sizeof(uint32_t) * word_cnt;
+    for (uint32_t i = 0; i < str_cnt; i++) {
+        io_buf[1 + i] = offset;
+        memcpy(((char *) io_buf) + offset, strings[i], lens[i]);
+        offset += lens[i];
+    }
+
+    *io_buf_size = size + tail_size;
+    return io_buf;
 }
 
 int IOSUHAX_memwrite(uint32_t address, const uint8_t *buffer, uint32_t size) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, ROUNDUP(size + 4, 0x20));
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_MEM_WRITE, size + 4);
     if (!io_buf)
         return -2;
 
     io_buf[0] = address;
     memcpy(io_buf + 1, buffer, size);
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_MEM_WRITE, io_buf, size + 4, 0, 0);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_MEM_WRITE, io_buf, size + 4, 0, 0);
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, size + 4);
     return res;
 }
 
@@ -138,6 +134,7 @@ int IOSUHAX_ODM_GetDiscKey(uint8_t *discKey) {
 }
 
 int IOSUHAX_memread(uint32_t address, uint8_t *out_buffer, uint32_t size) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -147,21 +144,22 @@ int IOSUHAX_memread(uint32_t address, uint8_t *out_buffer, uint32_t size) {
     void *tmp_buf = NULL;
 
     if (((uintptr_t) out_buffer & 0x1F) || (size & 0x1F)) {
-        tmp_buf = (uint32_t *) memalign(0x20, ROUNDUP(size, 0x20));
+        tmp_buf = iosuhax_request_alloc(IOCTL_MEM_READ, size);
         if (!tmp_buf)
             return -2;
     }
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_MEM_READ, io_buf, sizeof(address), tmp_buf ? tmp_buf : out_buffer, size);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_MEM_READ, io_buf, sizeof(address), tmp_buf ? tmp_buf : out_buffer, size);
 
     if (res >= 0 && tmp_buf)
         memcpy(out_buffer, tmp_buf, size);
 
-    free(tmp_buf);
+    iosuhax_buffer_free(tmp_buf, size);
     return res;
 }
 
 int IOSUHAX_memcpy(uint32_t dst, uint32_t src, uint32_t size) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -170,10 +168,11 @@ int IOSUHAX_memcpy(uint32_t dst, uint32_t src, uint32_t size) {
     io_buf[1] = src;
     io_buf[2] = size;
 
-    return IOS_Ioctl(iosuhaxHandle, IOCTL_MEMCPY, io_buf, 3 * sizeof(uint32_t), 0, 0);
+    return iosuhax_ioctl(iosuhaxHandle, IOCTL_MEMCPY, io_buf, 3 * sizeof(uint32_t), 0, 0);
 }
 
 int IOSUHAX_kern_write32(uint32_t address, uint32_t value) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -181,17 +180,18 @@ int IOSUHAX_kern_write32(uint32_t address, uint32_t value) {
     io_buf[0] = address;
     io_buf[1] = value;
 
-    return IOS_Ioctl(iosuhaxHandle, IOCTL_KERN_WRITE32, io_buf, 2 * sizeof(uint32_t), 0, 0);
+    return iosuhax_ioctl(iosuhaxHandle, IOCTL_KERN_WRITE32, io_buf, 2 * sizeof(uint32_t), 0, 0);
 }
 
 int IOSUHAX_read_otp(uint8_t *out_buffer, uint32_t size) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0) {
         return iosuhaxHandle;
     }
 
     ALIGN_0x20 uint32_t io_buf[0x400 >> 2];
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_READ_OTP, 0, 0, io_buf, 0x400);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_READ_OTP, 0, 0, io_buf, 0x400);
 
     if (res >= 0) {
         memcpy(out_buffer, io_buf, size > 0x400 ? 0x400 : size);
@@ -232,6 +232,7 @@ int IOSUHAX_read_seeprom(uint8_t *out_buffer, uint32_t offset, uint32_t size) {
 }
 
 int IOSUHAX_kern_read32(uint32_t address, uint32_t *out_buffer, uint32_t count) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -241,21 +242,22 @@ int IOSUHAX_kern_read32(uint32_t address, uint32_t *out_buffer, uint32_t count)
     void *tmp_buf = NULL;
 
     if (((uintptr_t) out_buffer & 0x1F) || ((count * 4) & 0x1F)) {
-        tmp_buf = (uint32_t *) memalign(0x20, ROUNDUP((count * 4), 0x20));
+        tmp_buf = iosuhax_request_alloc(IOCTL_KERN_READ32, count * 4);
         if (!tmp_buf)
             return -2;
     }
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_KERN_READ32, io_buf, sizeof(address), tmp_buf ? tmp_buf : out_buffer, count * 4);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_KERN_READ32, io_buf, sizeof(address), tmp_buf ? tmp_buf : out_buffer, count * 4);
 
     if (res >= 0 && tmp_buf)
         memcpy(out_buffer, tmp_buf, count * 4);
 
-    free(tmp_buf);
+    iosuhax_buffer_free(tmp_buf, count * 4);
     return res;
 }
 
 int IOSUHAX_SVC(uint32_t svc_id, uint32_t *args, uint32_t arg_cnt) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -270,7 +272,7 @@ int IOSUHAX_SVC(uint32_t svc_id, uint32_t *args, uint32_t arg_cnt) {
     }
 
     ALIGN_0x20 int result[0x20 >> 2];
-    int ret = IOS_Ioctl(iosuhaxHandle, IOCTL_SVC, arguments, (1 + arg_cnt) * 4, result, 4);
+    int ret = iosuhax_ioctl(iosuhaxHandle, IOCTL_SVC, arguments, (1 + arg_cnt) * 4, result, 4);
     if (ret < 0)
         return ret;
 
@@ -278,12 +280,13 @@ int IOSUHAX_SVC(uint32_t svc_id, uint32_t *args, uint32_t arg_cnt) {
 }
 
 int IOSUHAX_FSA_Open(void) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     ALIGN_0x20 int io_buf[0x20 >> 2];
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_OPEN, 0, 0, io_buf, sizeof(int));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_OPEN, 0, 0, io_buf, sizeof(int));
     if (res < 0)
         return res;
 
@@ -291,13 +294,14 @@ int IOSUHAX_FSA_Open(void) {
 }
 
 int IOSUHAX_FSA_Close(int fsaFd) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     ALIGN_0x20 int io_buf[0x20 >> 2];
     io_buf[0] = fsaFd;
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_CLOSE, io_buf, sizeof(fsaFd), io_buf, sizeof(fsaFd));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_CLOSE, io_buf, sizeof(fsaFd), io_buf, sizeof(fsaFd));
     if (res < 0)
         return res;
 
@@ -305,167 +309,172 @@ int IOSUHAX_FSA_Close(int fsaFd) {
 }
 
 int IOSUHAX_FSA_Mount(int fsaFd, const char *device_path, const char *volume_path, uint32_t flags, const char *arg_string, int arg_string_len) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
-    const int input_cnt = 6;
+    const int input_cnt   = 6;
+    const char *strings[] = {device_path, volume_path};
+    uint32_t tail_size    = arg_string_len ? arg_string_len + 1 : 0;
 
-    int io_buf_size = (sizeof(uint32_t) * input_cnt) + strlen(device_path) + strlen(volume_path) + arg_string_len + 3;
-
-    ALIGN_0x20 int io_buf[ROUNDUP(io_buf_size, 0x20) >> 2];
-    memset(io_buf, 0, io_buf_size);
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_MOUNT, input_cnt, strings, 2, tail_size, &io_buf_size);
+    if (!io_buf)
+        return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
-    io_buf[2] = io_buf[1] + strlen(device_path) + 1;
     io_buf[3] = flags;
-    io_buf[4] = arg_string_len ? (io_buf[2] + strlen(volume_path) + 1) : 0;
+    io_buf[4] = arg_string_len ? (io_buf_size - tail_size) : 0;
     io_buf[5] = arg_string_len;
 
-    strcpy(((char *) io_buf) + io_buf[1], device_path);
-    strcpy(((char *) io_buf) + io_buf[2], volume_path);
-
-    if (arg_string_len)
+    if (arg_string_len) {
         memcpy(((char *) io_buf) + io_buf[4], arg_string, arg_string_len);
+        ((char *) io_buf)[io_buf[4] + arg_string_len] = 0;
+    }
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_MOUNT, io_buf, io_buf_size, io_buf, 4);
-    if (res < 0)
-        return res;
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_MOUNT, io_buf, io_buf_size, io_buf, 4);
+    if (res >= 0)
+        res = io_buf[0];
 
-    return io_buf[0];
+    iosuhax_buffer_free(io_buf, io_buf_size);
+    return res;
 }
 
 int IOSUHAX_FSA_Unmount(int fsaFd, const char *path, uint32_t flags) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 3;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + 1;
-
-    ALIGN_0x20 int io_buf[ROUNDUP(io_buf_size, 0x20) >> 2];
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_UNMOUNT, input_cnt, &path, 1, 0, &io_buf_size);
+    if (!io_buf)
+        return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
     io_buf[2] = flags;
-    strcpy(((char *) io_buf) + io_buf[1], path);
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_UNMOUNT, io_buf, io_buf_size, io_buf, 4);
-    if (res < 0)
-        return res;
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_UNMOUNT, io_buf, io_buf_size, io_buf, 4);
+    if (res >= 0)
+        res = io_buf[0];
 
-    return io_buf[0];
+    iosuhax_buffer_free(io_buf, io_buf_size);
+    return res;
 }
 
 int IOSUHAX_FSA_FlushVolume(int fsaFd, const char *volume_path) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 2;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(volume_path) + 1;
-
-    ALIGN_0x20 int io_buf[ROUNDUP(io_buf_size, 0x20) >> 2];
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_FLUSHVOLUME, input_cnt, &volume_path, 1, 0, &io_buf_size);
+    if (!io_buf)
+        return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
-    strcpy(((char *) io_buf) + io_buf[1], volume_path);
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_FLUSHVOLUME, io_buf, io_buf_size, io_buf, 4);
-    if (res < 0)
-        return res;
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_FLUSHVOLUME, io_buf, io_buf_size, io_buf, 4);
+    if (res >= 0)
+        res = io_buf[0];
 
-    return io_buf[0];
+    iosuhax_buffer_free(io_buf, io_buf_size);
+    return res;
 }
 
 int IOSUHAX_FSA_GetDeviceInfo(int fsaFd, const char *device_path, int type, uint32_t *out_data) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 3;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(device_path) + 1;
-
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_GETDEVICEINFO, input_cnt, &device_path, 1, 0, &io_buf_size);
     if (!io_buf)
         return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
     io_buf[2] = type;
-    strcpy(((char *) io_buf) + io_buf[1], device_path);
 
     uint32_t out_buf[1 + 0x64 / 4];
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_GETDEVICEINFO, io_buf, io_buf_size, out_buf, sizeof(out_buf));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_GETDEVICEINFO, io_buf, io_buf_size, out_buf, sizeof(out_buf));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
     memcpy(out_data, out_buf + 1, 0x64);
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return out_buf[0];
 }
 
 int IOSUHAX_FSA_MakeDir(int fsaFd, const char *path, uint32_t flags) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 3;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + 1;
-
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_MAKEDIR, input_cnt, &path, 1, 0, &io_buf_size);
     if (!io_buf)
         return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
     io_buf[2] = flags;
-    strcpy(((char *) io_buf) + io_buf[1], path);
 
     int result;
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_MAKEDIR, io_buf, io_buf_size, &result, sizeof(result));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_MAKEDIR, io_buf, io_buf_size, &result, sizeof(result));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result;
 }
 
 int IOSUHAX_FSA_OpenDir(int fsaFd, const char *path, int *outHandle) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 2;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + 1;
-
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_OPENDIR, input_cnt, &path, 1, 0, &io_buf_size);
     if (!io_buf)
         return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
-    strcpy(((char *) io_buf) + io_buf[1], path);
 
     int result_vec[2];
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_OPENDIR, io_buf, io_buf_size, result_vec, sizeof(result_vec));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_OPENDIR, io_buf, io_buf_size, result_vec, sizeof(result_vec));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
     *outHandle = result_vec[1];
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result_vec[0];
 }
 
+//! Force FS_STAT_FILE when a size is set.
+static void IOSUHAX_fix_dir_entry(FSDirectoryEntry *entry) {
+    if ((entry->info.flags & FS_STAT_DIRECTORY) != FS_STAT_DIRECTORY && entry->info.size > 0) {
+        entry->info.flags |= FS_STAT_FILE;
+    }
+}
+
 int IOSUHAX_FSA_ReadDir(int fsaFd, int handle, FSDirectoryEntry *out_data) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -473,7 +482,7 @@ int IOSUHAX_FSA_ReadDir(int fsaFd, int handle, FSDirectoryEntry *out_data) {
 
     int io_buf_size = sizeof(uint32_t) * input_cnt;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_READDIR, io_buf_size);
     if (!io_buf)
         return -2;
 
@@ -481,33 +490,115 @@ int IOSUHAX_FSA_ReadDir(int fsaFd, int handle, FSDirectoryEntry *out_data) {
     io_buf[1] = handle;
 
     int result_vec_size = 4 + sizeof(FSDirectoryEntry);
-    uint8_t *result_vec = (uint8_t *) memalign(0x20, result_vec_size);
+    uint8_t *result_vec = (uint8_t *) iosuhax_request_alloc(IOCTL_FSA_READDIR, result_vec_size);
     if (!result_vec) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return -2;
     }
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_READDIR, io_buf, io_buf_size, result_vec, result_vec_size);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_READDIR, io_buf, io_buf_size, result_vec, result_vec_size);
     if (res < 0) {
-        free(result_vec);
-        free(io_buf);
+        iosuhax_buffer_free(result_vec, result_vec_size);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
     int result = *(int *) result_vec;
     memcpy(out_data, result_vec + 4, sizeof(FSDirectoryEntry));
+    IOSUHAX_fix_dir_entry(out_data);
 
-    // Force FS_STAT_FILE when a size is set.
-    if ((out_data->info.flags & FS_STAT_DIRECTORY) != FS_STAT_DIRECTORY && out_data->info.size > 0) {
-        out_data->info.flags |= FS_STAT_FILE;
+    iosuhax_buffer_free(io_buf, io_buf_size);
+    iosuhax_buffer_free(result_vec, result_vec_size);
+    return result;
+}
+
+int IOSUHAX_FSA_ReadDirMulti(int fsaFd, int handle, FSDirectoryEntry *out_data, uint32_t max_cnt) {
+    int iosuhaxHandle = iosuhax_get_handle();
+    if (iosuhaxHandle < 0)
+        return iosuhaxHandle;
+
+    uint32_t done = 0;
+
+    if (readDirMultiSupported && max_cnt > 0) {
+        const int input_cnt = 3;
+
+        uint32_t chunk_max = (max_cnt < IOSUHAX_READDIR_MULTI_MAX) ? max_cnt : IOSUHAX_READDIR_MULTI_MAX;
+
+        int io_buf_size = sizeof(uint32_t) * input_cnt;
+        int result_vec_size = 4 + sizeof(FSDirectoryEntry) * chunk_max;
+
+        uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_READDIR_MULTI, io_buf_size);
+        if (!io_buf)
+            return -2;
+
+        uint8_t *result_vec = (uint8_t *) iosuhax_request_alloc(IOCTL_FSA_READDIR_MULTI, result_vec_size);
+        if (!result_vec) {
+            iosuhax_buffer_free(io_buf, io_buf_size);
+            return -2;
+        }
+
+        while (done < max_cnt) {
+            uint32_t cnt = max_cnt - done;
+            if (cnt > chunk_max)
+                cnt = chunk_max;
+
+            io_buf[0] = fsaFd;
+            io_buf[1] = handle;
+            io_buf[2] = cnt;
+
+            //! stays out of range if IOSU does not know the request and leaves the reply alone
+            *(int *) result_vec = 0x7FFFFFFF;
+
+            int res    = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_READDIR_MULTI, io_buf, io_buf_size, result_vec, 4 + sizeof(FSDirectoryEntry) * cnt);
+            int result = *(int *) result_vec;
+            if (res < 0 && !IOSUHAX_IOCTL_UNSUPPORTED(res)) {
+                iosuhax_buffer_free(io_buf, io_buf_size);
+                iosuhax_buffer_free(result_vec, result_vec_size);
+                return done ? (int) done : res;
+            }
+            if (res < 0 || result > (int) cnt) {
+                //! IOSU does not handle the request, read the rest one entry at a time
+                readDirMultiSupported = 0;
+                break;
+            }
+
+            if (result < 0) {
+                // entries read so far are returned, the error shows up again on the next call
+                iosuhax_buffer_free(io_buf, io_buf_size);
+                iosuhax_buffer_free(result_vec, result_vec_size);
+                return done ? (int) done : result;
+            }
+
+            for (int i = 0; i < result; i++) {
+                memcpy(&out_data[done + i], result_vec + 4 + sizeof(FSDirectoryEntry) * i, sizeof(FSDirectoryEntry));
+                IOSUHAX_fix_dir_entry(&out_data[done + i]);
+            }
+
+            done += result;
+            if ((uint32_t) result < cnt)
+                break;
+        }
+
+        iosuhax_buffer_free(io_buf, io_buf_size);
+        iosuhax_buffer_free(result_vec, result_vec_size);
+
+        if (readDirMultiSupported)
+            return done;
     }
 
-    free(io_buf);
-    free(result_vec);
-    return result;
+    // whatever is left is read one entry per request, errors after the first entry are reported by the next call
+    while (done < max_cnt) {
+        int result = IOSUHAX_FSA_ReadDir(fsaFd, handle, out_data + done);
+        if (result < 0)
+            return done ? (int) done : result;
+        done++;
+    }
+
+    return done;
 }
 
 int IOSUHAX_FSA_RewindDir(int fsaFd, int dirHandle) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -515,7 +606,7 @@ int IOSUHAX_FSA_RewindDir(int fsaFd, int dirHandle) {
 
     int io_buf_size = sizeof(uint32_t) * input_cnt;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_REWINDDIR, io_buf_size);
     if (!io_buf)
         return -2;
 
@@ -524,17 +615,18 @@ int IOSUHAX_FSA_RewindDir(int fsaFd, int dirHandle) {
 
     int result;
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_REWINDDIR, io_buf, io_buf_size, &result, sizeof(result));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_REWINDDIR, io_buf, io_buf_size, &result, sizeof(result));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result;
 }
 
 int IOSUHAX_FSA_CloseDir(int fsaFd, int handle) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -542,7 +634,7 @@ int IOSUHAX_FSA_CloseDir(int fsaFd, int handle) {
 
     int io_buf_size = sizeof(uint32_t) * input_cnt;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_CLOSEDIR, io_buf_size);
     if (!io_buf)
         return -2;
 
@@ -551,84 +643,180 @@ int IOSUHAX_FSA_CloseDir(int fsaFd, int handle) {
 
     int result;
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_CLOSEDIR, io_buf, io_buf_size, &result, sizeof(result));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_CLOSEDIR, io_buf, io_buf_size, &result, sizeof(result));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result;
 }
 
 int IOSUHAX_FSA_ChangeDir(int fsaFd, const char *path) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 2;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + 1;
-
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_CHDIR, input_cnt, &path, 1, 0, &io_buf_size);
     if (!io_buf)
         return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
-    strcpy(((char *) io_buf) + io_buf[1], path);
 
     int result;
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_CHDIR, io_buf, io_buf_size, &result, sizeof(result));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_CHDIR, io_buf, io_buf_size, &result, sizeof(result));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result;
 }
 
 int IOSUHAX_FSA_OpenFile(int fsaFd, const char *path, const char *mode, int *outHandle) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
-    const int input_cnt = 3;
-
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + strlen(mode) + 2;
+    const int input_cnt   = 3;
+    const char *strings[] = {path, mode};
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_OPENFILE, input_cnt, strings, 2, 0, &io_buf_size);
     if (!io_buf)
         return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
-    io_buf[2] = io_buf[1] + strlen(path) + 1;
-    strcpy(((char *) io_buf) + io_buf[1], path);
-    strcpy(((char *) io_buf) + io_buf[2], mode);
 
     int result_vec[2];
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_OPENFILE, io_buf, io_buf_size, result_vec, sizeof(result_vec));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_OPENFILE, io_buf, io_buf_size, result_vec, sizeof(result_vec));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
     *outHandle = result_vec[1];
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result_vec[0];
 }
 
+int IOSUHAX_FSA_OpenFileStat(int fsaFd, const char *path, const char *mode, int *outHandle, FSStat *out_data, uint64_t *outSize) {
+    int iosuhaxHandle = iosuhax_get_handle();
+    if (iosuhaxHandle < 0)
+        return iosuhaxHandle;
+
+    if (iosuhaxOpenFileStatSupported) {
+        const int input_cnt   = 3;
+        const char *strings[] = {path, mode};
+
+        uint32_t io_buf_size;
+        uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_OPENFILE_STAT, input_cnt, strings, 2, 0, &io_buf_size);
+        if (!io_buf)
+            return -2;
+
+        io_buf[0] = fsaFd;
+
+        int out_buf_size     = 8 + sizeof(FSStat) + 8;
+        uint32_t *out_buffer = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_OPENFILE_STAT, out_buf_size);
+        if (!out_buffer) {
+            iosuhax_buffer_free(io_buf, io_buf_size);
+            return -2;
+        }
+
+        //! stays untouched if IOSU does not know the request
+        out_buffer[0] = 0x7FFFFFFF;
+
+        int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_OPENFILE_STAT, io_buf, io_buf_size, out_buffer, out_buf_size);
+        int result = out_buffer[0];
+        if (res < 0 && !IOSUHAX_IOCTL_UNSUPPORTED(res)) {
+            iosuhax_buffer_free(io_buf, io_buf_size);
+            iosuhax_buffer_free(out_buffer, out_buf_size);
+            return res;
+        }
+        if (res >= 0 && result != 0x7FFFFFFF) {
+            *outHandle = out_buffer[1];
+            if (result == 0) {
+                memcpy(out_data, out_buffer + 2, sizeof(FSStat));
+
+                const uint32_t *size_words = out_buffer + 2 + sizeof(FSStat) / 4;
+                *outSize                   = ((uint64_t) size_words[0] << 32) | size_words[1];
+
+                // Force FS_STAT_FILE when a size is set.
+                if ((out_data->flags & FS_STAT_DIRECTORY) != FS_STAT_DIRECTORY && out_data->size > 0) {
+                    out_data->flags |= FS_STAT_FILE;
+                }
+            }
+
+            iosuhax_buffer_free(io_buf, io_buf_size);
+            iosuhax_buffer_free(out_buffer, out_buf_size);
+            return result;
+        }
+
+        //! IOSU does not handle the request, open and stat separately
+        iosuhaxOpenFileStatSupported = 0;
+        iosuhax_buffer_free(io_buf, io_buf_size);
+        iosuhax_buffer_free(out_buffer, out_buf_size);
+    }
+
+    int result = IOSUHAX_FSA_OpenFile(fsaFd, path, mode, outHandle);
+    if (result != 0)
+        return result;
+
+    result = IOSUHAX_FSA_StatFile(fsaFd, *outHandle, out_data);
+    if (result != 0) {
+        IOSUHAX_FSA_CloseFile(fsaFd, *outHandle);
+        return result;
+    }
+
+    //! an IOSU without OPENFILE_STAT has no large file support either
+    *outSize = out_data->size;
+    return result;
+}
+
 int IOSUHAX_FSA_ReadFile(int fsaFd, void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 5;
 
+    uint32_t data_size = size * cnt;
+
+    if (iosuhaxFileIoctlvSupported && IS_VECTOR_ALIGNED(data, data_size)) {
+        ALIGN_0x20 uint32_t header[0x20 >> 2];
+        ALIGN_0x20 int result[0x20 >> 2];
+
+        header[0] = fsaFd;
+        header[1] = size;
+        header[2] = cnt;
+        header[3] = fileHandle;
+        header[4] = flags;
+
+        //! stays untouched if IOSU accepts the vectored request without handling it
+        result[0] = 0x7FFFFFFF;
+
+        int res = IOSUHAX_ioctlv_data(iosuhaxHandle, IOCTL_FSA_READFILE, header, sizeof(uint32_t) * input_cnt, data, data_size, 0, result);
+        if (res < 0 && !IOSUHAX_IOCTL_UNSUPPORTED(res))
+            return res;
+        if (res >= 0 && result[0] != 0x7FFFFFFF) {
+            iosuhaxFileIoctlvConfirmed = 1;
+            return result[0];
+        }
+
+        //! IOSU does not handle the vectored request, fall back to the staging copy
+        iosuhaxFileIoctlvSupported = 0;
+    }
+
     int io_buf_size = sizeof(uint32_t) * input_cnt;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_READFILE, io_buf_size);
     if (!io_buf)
         return -2;
 
@@ -638,40 +826,69 @@ int IOSUHAX_FSA_ReadFile(int fsaFd, void *data, uint32_t size, uint32_t cnt, int
     io_buf[3] = fileHandle;
     io_buf[4] = flags;
 
-    int out_buf_size = ((size * cnt + 0x40) + 0x3F) & ~0x3F;
+    int out_buf_size = ((data_size + 0x40) + 0x3F) & ~0x3F;
 
-    uint32_t *out_buffer = (uint32_t *) memalign(0x40, out_buf_size);
+    uint32_t *out_buffer = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_READFILE, out_buf_size);
     if (!out_buffer) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return -2;
     }
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_READFILE, io_buf, io_buf_size, out_buffer, out_buf_size);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_READFILE, io_buf, io_buf_size, out_buffer, out_buf_size);
     if (res < 0) {
-        free(out_buffer);
-        free(io_buf);
+        iosuhax_buffer_free(out_buffer, out_buf_size);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
     //! data is put to offset 0x40 to align the buffer output
-    memcpy(data, ((uint8_t *) out_buffer) + 0x40, size * cnt);
+    memcpy(data, ((uint8_t *) out_buffer) + 0x40, data_size);
+    iosuhax_buffer_count_copy(data_size);
 
     int result = out_buffer[0];
 
-    free(out_buffer);
-    free(io_buf);
+    iosuhax_buffer_free(out_buffer, out_buf_size);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result;
 }
 
 int IOSUHAX_FSA_WriteFile(int fsaFd, const void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 5;
 
-    int io_buf_size = ((sizeof(uint32_t) * input_cnt + size * cnt + 0x40) + 0x3F) & ~0x3F;
+    uint32_t data_size = size * cnt;
+
+    if (iosuhaxFileIoctlvSupported && IS_VECTOR_ALIGNED(data, data_size)) {
+        ALIGN_0x20 uint32_t header[0x20 >> 2];
+        ALIGN_0x20 int result[0x20 >> 2];
+
+        header[0] = fsaFd;
+        header[1] = size;
+        header[2] = cnt;
+        header[3] = fileHandle;
+        header[4] = flags;
+
+        //! stays untouched if IOSU accepts the vectored request without handling it
+        result[0] = 0x7FFFFFFF;
+
+        int res = IOSUHAX_ioctlv_data(iosuhaxHandle, IOCTL_FSA_WRITEFILE, header, sizeof(uint32_t) * input_cnt, (void *) data, data_size, 1, result);
+        if (res < 0 && !IOSUHAX_IOCTL_UNSUPPORTED(res))
+            return res;
+        if (res >= 0 && result[0] != 0x7FFFFFFF) {
+            iosuhaxFileIoctlvConfirmed = 1;
+            return result[0];
+        }
+
+        //! IOSU does not handle the vectored request, fall back to the staging copy
+        iosuhaxFileIoctlvSupported = 0;
+    }
+
+    int io_buf_size = ((sizeof(uint32_t) * input_cnt + data_size + 0x40) + 0x3F) & ~0x3F;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_WRITEFILE, io_buf_size);
     if (!io_buf)
         return -2;
 
@@ -682,19 +899,21 @@ int IOSUHAX_FSA_WriteFile(int fsaFd, const void *data, uint32_t size, uint32_t c
     io_buf[4] = flags;
 
     //! data is put to offset 0x40 to align the buffer input
-    memcpy(((uint8_t *) io_buf) + 0x40, data, size * cnt);
+    memcpy(((uint8_t *) io_buf) + 0x40, data, data_size);
+    iosuhax_buffer_count_copy(data_size);
 
     int result;
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_WRITEFILE, io_buf, io_buf_size, &result, sizeof(result));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_WRITEFILE, io_buf, io_buf_size, &result, sizeof(result));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result;
 }
 
 int IOSUHAX_FSA_StatFile(int fsaFd, int fileHandle, FSStat *out_data) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -702,7 +921,7 @@ int IOSUHAX_FSA_StatFile(int fsaFd, int fileHandle, FSStat *out_data) {
 
     int io_buf_size = sizeof(uint32_t) * input_cnt;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_STATFILE, io_buf_size);
     if (!io_buf)
         return -2;
 
@@ -710,16 +929,16 @@ int IOSUHAX_FSA_StatFile(int fsaFd, int fileHandle, FSStat *out_data) {
     io_buf[1] = fileHandle;
 
     int out_buf_size     = 4 + sizeof(FSStat);
-    uint32_t *out_buffer = (uint32_t *) memalign(0x20, out_buf_size);
+    uint32_t *out_buffer = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_STATFILE, out_buf_size);
     if (!out_buffer) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return -2;
     }
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_STATFILE, io_buf, io_buf_size, out_buffer, out_buf_size);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_STATFILE, io_buf, io_buf_size, out_buffer, out_buf_size);
     if (res < 0) {
-        free(io_buf);
-        free(out_buffer);
+        iosuhax_buffer_free(io_buf, io_buf_size);
+        iosuhax_buffer_free(out_buffer, out_buf_size);
         return res;
     }
 
@@ -731,12 +950,13 @@ int IOSUHAX_FSA_StatFile(int fsaFd, int fileHandle, FSStat *out_data) {
         out_data->flags |= FS_STAT_FILE;
     }
 
-    free(io_buf);
-    free(out_buffer);
+    iosuhax_buffer_free(io_buf, io_buf_size);
+    iosuhax_buffer_free(out_buffer, out_buf_size);
     return result;
 }
 
 int IOSUHAX_FSA_CloseFile(int fsaFd, int fileHandle) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -744,7 +964,7 @@ int IOSUHAX_FSA_CloseFile(int fsaFd, int fileHandle) {
 
     int io_buf_size = sizeof(uint32_t) * input_cnt;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_CLOSEFILE, io_buf_size);
     if (!io_buf)
         return -2;
 
@@ -753,17 +973,18 @@ int IOSUHAX_FSA_CloseFile(int fsaFd, int fileHandle) {
 
     int result;
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_CLOSEFILE, io_buf, io_buf_size, &result, sizeof(result));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_CLOSEFILE, io_buf, io_buf_size, &result, sizeof(result));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result;
 }
 
 int IOSUHAX_FSA_SetFilePos(int fsaFd, int fileHandle, uint32_t position) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -771,7 +992,7 @@ int IOSUHAX_FSA_SetFilePos(int fsaFd, int fileHandle, uint32_t position) {
 
     int io_buf_size = sizeof(uint32_t) * input_cnt;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_SETFILEPOS, io_buf_size);
     if (!io_buf)
         return -2;
 
@@ -781,43 +1002,118 @@ int IOSUHAX_FSA_SetFilePos(int fsaFd, int fileHandle, uint32_t position) {
 
     int result;
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_SETFILEPOS, io_buf, io_buf_size, &result, sizeof(result));
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_SETFILEPOS, io_buf, io_buf_size, &result, sizeof(result));
     if (res < 0) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return res;
     }
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return result;
 }
 
-int IOSUHAX_FSA_GetStat(int fsaFd, const char *path, FSStat *out_data) {
+int IOSUHAX_FSA_SetFilePos64(int fsaFd, int fileHandle, uint64_t position) {
+    if (!filePos64Supported) {
+        if (position > 0xFFFFFFFF)
+            return FS_STATUS_FILE_TOO_BIG;
+        return IOSUHAX_FSA_SetFilePos(fsaFd, fileHandle, (uint32_t) position);
+    }
+
+    int iosuhaxHandle = iosuhax_get_handle();
+    if (iosuhaxHandle < 0)
+        return iosuhaxHandle;
+
+    const int input_cnt = 4;
+
+    int io_buf_size = sizeof(uint32_t) * input_cnt;
+
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_SETFILEPOS64, io_buf_size);
+    if (!io_buf)
+        return -2;
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = fileHandle;
+    io_buf[2] = (uint32_t) (position >> 32);
+    io_buf[3] = (uint32_t) position;
+
+    //! stays untouched if IOSU does not know the request
+    int result = 0x7FFFFFFF;
+
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_SETFILEPOS64, io_buf, io_buf_size, &result, sizeof(result));
+    iosuhax_buffer_free(io_buf, io_buf_size);
+
+    if (res < 0 && !IOSUHAX_IOCTL_UNSUPPORTED(res))
+        return res;
+    if (res < 0 || result == 0x7FFFFFFF) {
+        filePos64Supported = 0;
+        return IOSUHAX_FSA_SetFilePos64(fsaFd, fileHandle, position);
+    }
+    return result;
+}
+
+int IOSUHAX_FSA_GetFilePos64(int fsaFd, int fileHandle, uint64_t *outPosition) {
+    //! IOSUHAX has no 32 bit GETFILEPOS to fall back to
+    if (!filePos64Supported)
+        return FS_STATUS_UNSUPPORTED_CMD;
+
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 2;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + 1;
+    int io_buf_size = sizeof(uint32_t) * input_cnt;
+
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_GETFILEPOS64, io_buf_size);
+    if (!io_buf)
+        return -2;
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = fileHandle;
+
+    uint32_t result_vec[3];
+    result_vec[0] = 0x7FFFFFFF;
+
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_GETFILEPOS64, io_buf, io_buf_size, result_vec, sizeof(result_vec));
+    iosuhax_buffer_free(io_buf, io_buf_size);
+
+    if (res < 0 && !IOSUHAX_IOCTL_UNSUPPORTED(res))
+        return res;
+    if (res < 0 || result_vec[0] == 0x7FFFFFFF) {
+        filePos64Supported = 0;
+        return FS_STATUS_UNSUPPORTED_CMD;
+    }
+
+    if (result_vec[0] == 0)
+        *outPosition = ((uint64_t) result_vec[1] << 32) | result_vec[2];
+    return (int) result_vec[0];
+}
+
+int IOSUHAX_FSA_GetStat(int fsaFd, const char *path, FSStat *out_data) {
+    int iosuhaxHandle = iosuhax_get_handle();
+    if (iosuhaxHandle < 0)
+        return iosuhaxHandle;
+
+    const int input_cnt = 2;
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_GETSTAT, input_cnt, &path, 1, 0, &io_buf_size);
     if (!io_buf)
         return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
-    strcpy(((char *) io_buf) + io_buf[1], path);
 
     int out_buf_size     = 4 + sizeof(FSStat);
-    uint32_t *out_buffer = (uint32_t *) memalign(0x20, out_buf_size);
+    uint32_t *out_buffer = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_GETSTAT, out_buf_size);
     if (!out_buffer) {
-        free(io_buf);
+        iosuhax_buffer_free(io_buf, io_buf_size);
         return -2;
     }
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_GETSTAT, io_buf, io_buf_size, out_buffer, out_buf_size);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_GETSTAT, io_buf, io_buf_size, out_buffer, out_buf_size);
     if (res < 0) {
-        free(io_buf);
-        free(out_buffer);
+        iosuhax_buffer_free(io_buf, io_buf_size);
+        iosuhax_buffer_free(out_buffer, out_buf_size);
         return res;
     }
 
@@ -829,89 +1125,172 @@ int IOSUHAX_FSA_GetStat(int fsaFd, const char *path, FSStat *out_data) {
         out_data->flags |= FS_STAT_FILE;
     }
 
-    free(io_buf);
-    free(out_buffer);
+    iosuhax_buffer_free(io_buf, io_buf_size);
+    iosuhax_buffer_free(out_buffer, out_buf_size);
     return result;
 }
 
 int IOSUHAX_FSA_Remove(int fsaFd, const char *path) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 2;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + 1;
-
-    uint32_t *io_buf = (uint32_t *) memalign(0x20, ROUNDUP(io_buf_size, 0x20));
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_REMOVE, input_cnt, &path, 1, 0, &io_buf_size);
     if (!io_buf)
         return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
-    strcpy(((char *) io_buf) + io_buf[1], path);
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_REMOVE, io_buf, io_buf_size, io_buf, 4);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_REMOVE, io_buf, io_buf_size, io_buf, 4);
     if (res >= 0)
         res = io_buf[0];
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return res;
 }
 
 int IOSUHAX_FSA_ChangeMode(int fsaFd, const char *path, int mode) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 3;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + 1;
-
-    ALIGN_0x20 uint32_t io_buf[ROUNDUP(io_buf_size, 0x20) >> 2];
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_CHANGEMODE, input_cnt, &path, 1, 0, &io_buf_size);
+    if (!io_buf)
+        return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
     io_buf[2] = mode;
-    strcpy(((char *) io_buf) + io_buf[1], path);
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_CHANGEMODE, io_buf, io_buf_size, io_buf, 4);
-    if (res < 0)
-        return res;
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_CHANGEMODE, io_buf, io_buf_size, io_buf, 4);
+    if (res >= 0)
+        res = io_buf[0];
 
-    return io_buf[0];
+    iosuhax_buffer_free(io_buf, io_buf_size);
+    return res;
 }
 
 int IOSUHAX_FSA_RawOpen(int fsaFd, const char *device_path, int *outHandle) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 2;
 
-    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(device_path) + 1;
-
-    ALIGN_0x20 uint32_t io_buf[ROUNDUP(io_buf_size, 0x20) >> 2];
+    uint32_t io_buf_size;
+    uint32_t *io_buf = IOSUHAX_path_request(IOCTL_FSA_RAW_OPEN, input_cnt, &device_path, 1, 0, &io_buf_size);
+    if (!io_buf)
+        return -2;
 
     io_buf[0] = fsaFd;
-    io_buf[1] = sizeof(uint32_t) * input_cnt;
-    strcpy(((char *) io_buf) + io_buf[1], device_path);
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_RAW_OPEN, io_buf, io_buf_size, io_buf, 2 * sizeof(int));
-    if (res < 0)
-        return res;
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_RAW_OPEN, io_buf, io_buf_size, io_buf, 2 * sizeof(int));
+    if (res >= 0) {
+        if (outHandle)
+            *outHandle = io_buf[1];
+        res = io_buf[0];
+    }
 
-    if (outHandle)
-        *outHandle = io_buf[1];
+    iosuhax_buffer_free(io_buf, io_buf_size);
+    return res;
+}
 
-    return io_buf[0];
+void IOSUHAX_SetRawChunkSize(uint32_t chunk_size) {
+    rawChunkSize = chunk_size;
+}
+
+//! Splits a raw transfer into chunks with two of them in flight, so the next chunk is
+//! transferred while the previous one is copied. Peak staging memory is two chunks.
+static int IOSUHAX_FSA_RawChunked(int fsaFd, uint8_t *data, uint32_t block_size, uint32_t block_cnt, uint64_t sector_offset, int device_handle, int isWrite) {
+    uint32_t chunk_blocks = rawChunkSize / block_size;
+    if (chunk_blocks == 0)
+        chunk_blocks = 1;
+
+    IOSUHAX_AsyncQueue *queue = IOSUHAX_CreateAsyncQueue(2);
+    if (!queue)
+        return -2;
+
+    uint32_t submitted = 0;
+    int result         = 0;
+
+    while (1) {
+        // keep the queue filled until all chunks are submitted or one failed
+        while (result >= 0 && submitted < block_cnt) {
+            uint32_t blocks = block_cnt - submitted;
+            if (blocks > chunk_blocks)
+                blocks = chunk_blocks;
+
+            uint8_t *chunk = data + (size_t) submitted * block_size;
+            int res;
+            if (isWrite)
+                res = IOSUHAX_FSA_RawWriteAsync(queue, fsaFd, chunk, block_size, blocks, sector_offset + submitted, device_handle, NULL);
+            else
+                res = IOSUHAX_FSA_RawReadAsync(queue, fsaFd, chunk, block_size, blocks, sector_offset + submitted, device_handle, NULL);
+
+            if (res == -3) // queue full
+                break;
+            if (res < 0) {
+                result = res;
+                break;
+            }
+            submitted += blocks;
+        }
+
+        IOSUHAX_AsyncResult completion;
+        if (IOSUHAX_WaitAsyncQueue(queue, &completion) <= 0)
+            break;
+
+        if (completion.result < 0 && result >= 0)
+            result = completion.result;
+    }
+
+    IOSUHAX_DestroyAsyncQueue(queue);
+    return result;
 }
 
 int IOSUHAX_FSA_RawRead(int fsaFd, void *data, uint32_t block_size, uint32_t block_cnt, uint64_t sector_offset, int device_handle) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
     const int input_cnt = 6;
 
-    int io_buf_size  = 0x40 + block_size * block_cnt;
-    uint32_t *io_buf = (uint32_t *) memalign(0x40, ROUNDUP(io_buf_size, 0x40));
+    uint32_t data_size = block_size * block_cnt;
+
+    if (iosuhaxRawIoctlvSupported && IS_VECTOR_ALIGNED(data, data_size)) {
+        ALIGN_0x20 uint32_t header[0x20 >> 2];
+        ALIGN_0x20 int result[0x20 >> 2];
+
+        header[0] = fsaFd;
+        header[1] = block_size;
+        header[2] = block_cnt;
+        header[3] = (sector_offset >> 32) & 0xFFFFFFFF;
+        header[4] = sector_offset & 0xFFFFFFFF;
+        header[5] = device_handle;
+
+        //! stays untouched if IOSU accepts the vectored request without handling it
+        result[0] = 0x7FFFFFFF;
+
+        int res = IOSUHAX_ioctlv_data(iosuhaxHandle, IOCTL_FSA_RAW_READ, header, sizeof(uint32_t) * input_cnt, data, data_size, 0, result);
+        if (res < 0 && !IOSUHAX_IOCTL_UNSUPPORTED(res))
+            return res;
+        if (res >= 0 && result[0] != 0x7FFFFFFF)
+            return result[0];
+
+        //! IOSU does not handle the vectored request, fall back to the staging copy
+        iosuhaxRawIoctlvSupported = 0;
+    }
+
+    if (rawChunkSize && data_size > rawChunkSize)
+        return IOSUHAX_FSA_RawChunked(fsaFd, (uint8_t *) data, block_size, block_cnt, sector_offset, device_handle, 0);
+
+    int io_buf_size  = 0x40 + data_size;
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_RAW_READ, io_buf_size);
 
     if (!io_buf)
         return -2;
@@ -923,25 +1302,58 @@ int IOSUHAX_FSA_RawRead(int fsaFd, void *data, uint32_t block_size, uint32_t blo
     io_buf[4] = sector_offset & 0xFFFFFFFF;
     io_buf[5] = device_handle;
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_RAW_READ, io_buf, sizeof(uint32_t) * input_cnt, io_buf, io_buf_size);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_RAW_READ, io_buf, sizeof(uint32_t) * input_cnt, io_buf, io_buf_size);
     if (res >= 0) {
         //! data is put to offset 0x40 to align the buffer output
-        memcpy(data, ((uint8_t *) io_buf) + 0x40, block_size * block_cnt);
+        memcpy(data, ((uint8_t *) io_buf) + 0x40, data_size);
+        iosuhax_buffer_count_copy(data_size);
 
         res = io_buf[0];
     }
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return res;
 }
 
 int IOSUHAX_FSA_RawWrite(int fsaFd, const void *data, uint32_t block_size, uint32_t block_cnt, uint64_t sector_offset, int device_handle) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
-    int io_buf_size = ROUNDUP(0x40 + block_size * block_cnt, 0x40);
+    const int input_cnt = 6;
+
+    uint32_t data_size = block_size * block_cnt;
+
+    if (iosuhaxRawIoctlvSupported && IS_VECTOR_ALIGNED(data, data_size)) {
+        ALIGN_0x20 uint32_t header[0x20 >> 2];
+        ALIGN_0x20 int result[0x20 >> 2];
+
+        header[0] = fsaFd;
+        header[1] = block_size;
+        header[2] = block_cnt;
+        header[3] = (sector_offset >> 32) & 0xFFFFFFFF;
+        header[4] = sector_offset & 0xFFFFFFFF;
+        header[5] = device_handle;
+
+        //! stays untouched if IOSU accepts the vectored request without handling it
+        result[0] = 0x7FFFFFFF;
+
+        int res = IOSUHAX_ioctlv_data(iosuhaxHandle, IOCTL_FSA_RAW_WRITE, header, sizeof(uint32_t) * input_cnt, (void *) data, data_size, 1, result);
+        if (res < 0 && !IOSUHAX_IOCTL_UNSUPPORTED(res))
+            return res;
+        if (res >= 0 && result[0] != 0x7FFFFFFF)
+            return result[0];
+
+        //! IOSU does not handle the vectored request, fall back to the staging copy
+        iosuhaxRawIoctlvSupported = 0;
+    }
+
+    if (rawChunkSize && data_size > rawChunkSize)
+        return IOSUHAX_FSA_RawChunked(fsaFd, (uint8_t *) data, block_size, block_cnt, sector_offset, device_handle, 1);
+
+    int io_buf_size = ROUNDUP(0x40 + data_size, 0x40);
 
-    uint32_t *io_buf = (uint32_t *) memalign(0x40, io_buf_size);
+    uint32_t *io_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_RAW_WRITE, io_buf_size);
     if (!io_buf)
         return -2;
 
@@ -953,18 +1365,20 @@ int IOSUHAX_FSA_RawWrite(int fsaFd, const void *data, uint32_t block_size, uint3
     io_buf[5] = device_handle;
 
     //! data is put to offset 0x40 to align the buffer input
-    memcpy(((uint8_t *) io_buf) + 0x40, data, block_size * block_cnt);
+    memcpy(((uint8_t *) io_buf) + 0x40, data, data_size);
+    iosuhax_buffer_count_copy(data_size);
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_RAW_WRITE, io_buf, io_buf_size, io_buf, 4);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_RAW_WRITE, io_buf, io_buf_size, io_buf, 4);
     if (res >= 0)
         res = io_buf[0];
 
-    free(io_buf);
+    iosuhax_buffer_free(io_buf, io_buf_size);
     return res;
 }
 
 
 int IOSUHAX_FSA_RawClose(int fsaFd, int device_handle) {
+    int iosuhaxHandle = iosuhax_get_handle();
     if (iosuhaxHandle < 0)
         return iosuhaxHandle;
 
@@ -977,7 +1391,7 @@ int IOSUHAX_FSA_RawClose(int fsaFd, int device_handle) {
     io_buf[0] = fsaFd;
     io_buf[1] = device_handle;
 
-    int res = IOS_Ioctl(iosuhaxHandle, IOCTL_FSA_RAW_CLOSE, io_buf, io_buf_size, io_buf, 4);
+    int res = iosuhax_ioctl(iosuhaxHandle, IOCTL_FSA_RAW_CLOSE, io_buf, io_buf_size, io_buf, 4);
     if (res < 0)
         return res;
 
@@ -0,0 +1,669 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax.h"
+#include "iosuhax_buffer_pool.h"
+#include "iosuhax_ipc.h"
+#include "iosuhax_stats.h"
+#include "os_functions.h"
+#include <coreinit/messagequeue.h>
+#include <malloc.h>
+#include <string.h>
+
+typedef enum {
+    ASYNC_OP_RESULT,    // result word only
+    ASYNC_OP_HANDLE,    // result word followed by a handle
+    ASYNC_OP_READ,      // result word, data at offset 0x40
+    ASYNC_OP_STAT,      // result word followed by a FSStat
+    ASYNC_OP_DIR_ENTRY, // result word followed by a FSDirectoryEntry
+} async_op_t;
+
+typedef struct _async_request_t {
+    //! first cache line receives the small outputs, keep it apart from the fields below
+    ALIGN_0x40 uint32_t out_inline[0x40 >> 2];
+    uint32_t in_inline[0x40 >> 2];
+    IOSUHAX_AsyncQueue *queue;
+    async_op_t op;
+    uint32_t request;
+    int vectored; // in_inline holds the header, data is sent as its own vector
+    ALIGN_0x20 ios_vec_t vecs[3];
+    void *cookie;
+    int error;
+    uint32_t *in_buf;
+    uint32_t in_buf_size;
+    uint32_t *out_buf;
+    uint32_t out_buf_size;
+    void *user_data;
+    uint32_t user_size;
+    int *outHandle;
+    void *staging; // pooled buffer used when the inline buffers are too small
+    uint32_t staging_size;
+#ifdef IOSUHAX_INSTRUMENTED
+    OSTime submitted;
+    OSTime completed;
+#endif
+} async_request_t;
+
+struct _IOSUHAX_AsyncQueue {
+    OSMessageQueue messageQueue;
+    OSMessage *messages;
+    uint32_t depth;
+    uint32_t inFlight;
+    int handle; // /dev/iosuhax handle of the requests in flight, picked again once the queue is idle
+    uint32_t mutex[(OS_MUTEX_SIZE + 3) >> 2];
+};
+
+static async_request_t *async_request_alloc(IOSUHAX_AsyncQueue *queue, async_op_t op, void *cookie) {
+    async_request_t *req = (async_request_t *) iosuhax_buffer_alloc(sizeof(async_request_t));
+    if (!req)
+        return NULL;
+
+    memset(req, 0, sizeof(async_request_t));
+    req->queue        = queue;
+    req->op           = op;
+    req->cookie       = cookie;
+    req->in_buf       = req->in_inline;
+    req->out_buf      = req->out_inline;
+    req->out_buf_size = sizeof(uint32_t);
+    return req;
+}
+
+static void async_request_free(async_request_t *req) {
+    iosuhax_buffer_free(req->staging, req->staging_size);
+    iosuhax_buffer_free(req, sizeof(async_request_t));
+}
+
+//! Returns a pooled buffer that is released together with the request.
+//! A request carries at most one, either for its input or its output.
+static uint32_t *async_request_staging(async_request_t *req, uint32_t size) {
+    req->staging      = iosuhax_buffer_alloc(size);
+    req->staging_size = size;
+    return (uint32_t *) req->staging;
+}
+
+//! Uses the inline buffer for small inputs, a staging buffer otherwise.
+static uint32_t *async_request_input(async_request_t *req, uint32_t size) {
+    req->in_buf_size = size;
+    if (size > sizeof(req->in_inline)) {
+        req->in_buf = async_request_staging(req, size);
+    }
+    return req->in_buf;
+}
+
+static uint32_t *async_request_output(async_request_t *req, uint32_t size) {
+    req->out_buf_size = size;
+    if (size > sizeof(req->out_inline)) {
+        req->out_buf = async_request_staging(req, size);
+    }
+    return req->out_buf;
+}
+
+//! Called by the IPC driver, only hands the request over to the queue owner.
+static void async_callback(int error, void *context) {
+    async_request_t *req = (async_request_t *) context;
+    req->error           = error;
+#ifdef IOSUHAX_INSTRUMENTED
+    req->completed = OSGetSystemTime();
+#endif
+
+    // the handle is no longer used, IOSUHAX_Close may close it
+    iosuhax_transport_leave();
+
+    OSMessage message;
+    message.message = req;
+    message.args[0] = 0;
+    message.args[1] = 0;
+    message.args[2] = 0;
+
+    // can't fail, submission makes sure there are never more requests than message slots
+    OSSendMessage(&req->queue->messageQueue, &message, OS_MESSAGE_FLAGS_NONE);
+}
+
+static int async_submit(async_request_t *req, uint32_t request) {
+    IOSUHAX_AsyncQueue *queue = req->queue;
+    req->request              = request;
+
+    int handle = iosuhax_get_handle();
+    if (handle < 0) {
+        async_request_free(req);
+        return handle;
+    }
+
+    OSLockMutex(queue->mutex);
+    if (queue->inFlight >= queue->depth) {
+        OSUnlockMutex(queue->mutex);
+        async_request_free(req);
+        return -3;
+    }
+
+    // IOSU serves the requests of one handle in the order they were sent, file reads and writes carry no
+    // position and depend on it. Requests in flight together therefore stay on one handle, even if the
+    // submitting thread moves to another core.
+    if (queue->inFlight == 0)
+        queue->handle = handle;
+    handle = queue->handle;
+
+    if (iosuhax_transport_enter(handle) < 0) {
+        OSUnlockMutex(queue->mutex);
+        async_request_free(req);
+        return -1;
+    }
+    queue->inFlight++;
+    OSUnlockMutex(queue->mutex);
+
+#ifdef IOSUHAX_ENABLE_STATS
+    iosuhax_stats_count_alloc(request);
+    if (req->staging)
+        iosuhax_stats_count_alloc(request);
+#endif
+#ifdef IOSUHAX_INSTRUMENTED
+    req->submitted = OSGetSystemTime();
+#endif
+
+    int res;
+    if (req->vectored) {
+        // reads send the header in and get the result and data back, writes send header and data
+        uint32_t vec_in = (req->op == ASYNC_OP_READ) ? 1 : 2;
+        res             = IOS_IoctlvAsync(handle, request, vec_in, 3 - vec_in, req->vecs, async_callback, req);
+    } else {
+        res = IOS_IoctlAsync(handle, request, req->in_buf, req->in_buf_size, req->out_buf, req->out_buf_size, async_callback, req);
+    }
+
+    if (res < 0) {
+        iosuhax_transport_leave();
+        OSLockMutex(queue->mutex);
+        queue->inFlight--;
+        OSUnlockMutex(queue->mutex);
+        async_request_free(req);
+        return res;
+    }
+
+    return 0;
+}
+
+//! Prepares a request that passes the caller's aligned buffer to IOSU without a staging copy.
+//! The header words have to be written to in_inline before.
+static void async_request_vectored(async_request_t *req, uint32_t header_size, void *data, uint32_t data_size) {
+    req->vectored  = 1;
+    req->user_data = data;
+    req->user_size = data_size;
+
+    req->vecs[0].vaddr = req->in_inline;
+    req->vecs[0].len   = header_size;
+
+    //! stays untouched if IOSU accepts the vectored request without handling it
+    req->out_inline[0] = 0x7FFFFFFF;
+
+    if (req->op == ASYNC_OP_READ) {
+        req->vecs[1].vaddr = req->out_inline;
+        req->vecs[1].len   = sizeof(uint32_t);
+        req->vecs[2].vaddr = data;
+        req->vecs[2].len   = data_size;
+    } else {
+        req->vecs[1].vaddr = data;
+        req->vecs[1].len   = data_size;
+        req->vecs[2].vaddr = req->out_inline;
+        req->vecs[2].len   = sizeof(uint32_t);
+    }
+}
+
+//! IOSU does not handle vectored requests. Disables them and repeats the request through the
+//! synchronous staging path. Only raw requests can get here, they carry their offset so the
+//! repeat does not depend on the order other requests of the queue complete in. Async file
+//! requests are sent vectored only once a synchronous one went through, see iosuhaxFileIoctlvConfirmed.
+//! Should one still come back unhandled, it fails and the ones after it use the staging copy.
+static int async_retry_vectored(async_request_t *req) {
+    uint32_t *header = req->in_inline;
+
+    switch (req->request) {
+        case IOCTL_FSA_RAW_READ:
+            iosuhaxRawIoctlvSupported = 0;
+            return IOSUHAX_FSA_RawRead(header[0], req->user_data, header[1], header[2], ((uint64_t) header[3] << 32) | header[4], header[5]);
+        case IOCTL_FSA_RAW_WRITE:
+            iosuhaxRawIoctlvSupported = 0;
+            return IOSUHAX_FSA_RawWrite(header[0], req->user_data, header[1], header[2], ((uint64_t) header[3] << 32) | header[4], header[5]);
+    }
+    iosuhaxFileIoctlvSupported = 0;
+    return (req->error < 0) ? req->error : -4;
+}
+
+//! Post-processing of a completed request, runs on the thread that takes the result.
+static void async_complete(async_request_t *req, IOSUHAX_AsyncResult *result) {
+    IOSUHAX_AsyncQueue *queue = req->queue;
+
+    int res = req->error;
+
+#ifdef IOSUHAX_INSTRUMENTED
+    if (req->vectored) {
+        uint32_t vec_in = (req->op == ASYNC_OP_READ) ? 1 : 2;
+        iosuhax_instrument(req->request, res, req->vecs, vec_in, 3 - vec_in, req->submitted, req->completed);
+    } else {
+        ios_vec_t vecs[2] = {{0, req->in_buf_size, req->in_buf}, {0, req->out_buf_size, req->out_buf}};
+        iosuhax_instrument(req->request, res, vecs, 1, 1, req->submitted, req->completed);
+    }
+#endif
+
+    if (req->vectored) {
+        if (res >= 0 && req->out_inline[0] != 0x7FFFFFFF)
+            res = (int) req->out_inline[0];
+        else if (res >= 0 || IOSUHAX_IOCTL_UNSUPPORTED(res))
+            res = async_retry_vectored(req);
+    } else if (res >= 0) {
+        res = (int) req->out_buf[0];
+
+        switch (req->op) {
+            case ASYNC_OP_RESULT:
+                break;
+            case ASYNC_OP_HANDLE:
+                if (req->outHandle)
+                    *req->outHandle = (int) req->out_buf[1];
+                break;
+            case ASYNC_OP_READ:
+                //! data is put to offset 0x40 to align the buffer output
+                memcpy(req->user_data, ((uint8_t *) req->out_buf) + 0x40, req->user_size);
+                iosuhax_buffer_count_copy(req->user_size);
+                break;
+            case ASYNC_OP_STAT: {
+                FSStat *out_data = (FSStat *) req->user_data;
+                memcpy(out_data, req->out_buf + 1, sizeof(FSStat));
+
+                // Force FS_STAT_FILE when a size is set.
+                if ((out_data->flags & FS_STAT_DIRECTORY) != FS_STAT_DIRECTORY && out_data->size > 0) {
+                    out_data->flags |= FS_STAT_FILE;
+                }
+                break;
+            }
+            case ASYNC_OP_DIR_ENTRY: {
+                FSDirectoryEntry *out_data = (FSDirectoryEntry *) req->user_data;
+                memcpy(out_data, req->out_buf + 1, sizeof(FSDirectoryEntry));
+
+                // Force FS_STAT_FILE when a size is set.
+                if ((out_data->info.flags & FS_STAT_DIRECTORY) != FS_STAT_DIRECTORY && out_data->info.size > 0) {
+                    out_data->info.flags |= FS_STAT_FILE;
+                }
+                break;
+            }
+        }
+    }
+
+    if (result) {
+        result->cookie = req->cookie;
+        result->result = res;
+    }
+
+    async_request_free(req);
+
+    OSLockMutex(queue->mutex);
+    queue->inFlight--;
+    OSUnlockMutex(queue->mutex);
+}
+
+IOSUHAX_AsyncQueue *IOSUHAX_CreateAsyncQueue(uint32_t depth) {
+    if (depth == 0)
+        return NULL;
+
+    IOSUHAX_AsyncQueue *queue = (IOSUHAX_AsyncQueue *) malloc(sizeof(IOSUHAX_AsyncQueue));
+    if (!queue)
+        return NULL;
+
+    queue->messages = (OSMessage *) malloc(sizeof(OSMessage) * depth);
+    if (!queue->messages) {
+        free(queue);
+        return NULL;
+    }
+
+    queue->depth    = depth;
+    queue->inFlight = 0;
+    queue->handle   = -1;
+    OSInitMutex(queue->mutex);
+    OSInitMessageQueue(&queue->messageQueue, queue->messages, depth);
+    return queue;
+}
+
+int IOSUHAX_DestroyAsyncQueue(IOSUHAX_AsyncQueue *queue) {
+    if (!queue)
+        return -1;
+
+    OSLockMutex(queue->mutex);
+    uint32_t inFlight = queue->inFlight;
+    OSUnlockMutex(queue->mutex);
+
+    if (inFlight > 0)
+        return -1;
+
+    free(queue->messages);
+    free(queue);
+    return 0;
+}
+
+int IOSUHAX_PollAsyncQueue(IOSUHAX_AsyncQueue *queue, IOSUHAX_AsyncResult *result) {
+    if (!queue)
+        return -1;
+
+    OSMessage message;
+    if (!OSReceiveMessage(&queue->messageQueue, &message, OS_MESSAGE_FLAGS_NONE))
+        return 0;
+
+    async_complete((async_request_t *) message.message, result);
+    return 1;
+}
+
+int IOSUHAX_WaitAsyncQueue(IOSUHAX_AsyncQueue *queue, IOSUHAX_AsyncResult *result) {
+    if (!queue)
+        return -1;
+
+    OSLockMutex(queue->mutex);
+    uint32_t inFlight = queue->inFlight;
+    OSUnlockMutex(queue->mutex);
+
+    if (inFlight == 0)
+        return 0;
+
+    OSMessage message;
+    OSReceiveMessage(&queue->messageQueue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+
+    async_complete((async_request_t *) message.message, result);
+    return 1;
+}
+
+int IOSUHAX_FSA_OpenDirAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, const char *path, int *outHandle, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_HANDLE, cookie);
+    if (!req)
+        return -2;
+
+    const int input_cnt = 2;
+
+    uint32_t *io_buf = async_request_input(req, sizeof(uint32_t) * input_cnt + strlen(path) + 1);
+    if (!io_buf) {
+        async_request_free(req);
+        return -2;
+    }
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = sizeof(uint32_t) * input_cnt;
+    strcpy(((char *) io_buf) + io_buf[1], path);
+
+    req->outHandle    = outHandle;
+    req->out_buf_size = 2 * sizeof(uint32_t);
+
+    return async_submit(req, IOCTL_FSA_OPENDIR);
+}
+
+int IOSUHAX_FSA_ReadDirAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, int handle, FSDirectoryEntry *out_data, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_DIR_ENTRY, cookie);
+    if (!req)
+        return -2;
+
+    uint32_t *io_buf = async_request_input(req, sizeof(uint32_t) * 2);
+    io_buf[0]        = fsaFd;
+    io_buf[1]        = handle;
+
+    if (!async_request_output(req, 4 + sizeof(FSDirectoryEntry))) {
+        async_request_free(req);
+        return -2;
+    }
+
+    req->user_data = out_data;
+
+    return async_submit(req, IOCTL_FSA_READDIR);
+}
+
+int IOSUHAX_FSA_CloseDirAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, int handle, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_RESULT, cookie);
+    if (!req)
+        return -2;
+
+    uint32_t *io_buf = async_request_input(req, sizeof(uint32_t) * 2);
+    io_buf[0]        = fsaFd;
+    io_buf[1]        = handle;
+
+    return async_submit(req, IOCTL_FSA_CLOSEDIR);
+}
+
+int IOSUHAX_FSA_OpenFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, const char *path, const char *mode, int *outHandle, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_HANDLE, cookie);
+    if (!req)
+        return -2;
+
+    const int input_cnt = 3;
+
+    int path_len = strlen(path);
+
+    uint32_t *io_buf = async_request_input(req, sizeof(uint32_t) * input_cnt + path_len + strlen(mode) + 2);
+    if (!io_buf) {
+        async_request_free(req);
+        return -2;
+    }
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = sizeof(uint32_t) * input_cnt;
+    io_buf[2] = io_buf[1] + path_len + 1;
+    strcpy(((char *) io_buf) + io_buf[1], path);
+    strcpy(((char *) io_buf) + io_buf[2], mode);
+
+    req->outHandle    = outHandle;
+    req->out_buf_size = 2 * sizeof(uint32_t);
+
+    return async_submit(req, IOCTL_FSA_OPENFILE);
+}
+
+int IOSUHAX_FSA_ReadFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_READ, cookie);
+    if (!req)
+        return -2;
+
+    uint32_t *io_buf = async_request_input(req, sizeof(uint32_t) * 5);
+    io_buf[0]        = fsaFd;
+    io_buf[1]        = size;
+    io_buf[2]        = cnt;
+    io_buf[3]        = fileHandle;
+    io_buf[4]        = flags;
+
+    if (iosuhaxFileIoctlvConfirmed && iosuhaxFileIoctlvSupported && IS_VECTOR_ALIGNED(data, size * cnt)) {
+        async_request_vectored(req, sizeof(uint32_t) * 5, data, size * cnt);
+        return async_submit(req, IOCTL_FSA_READFILE);
+    }
+
+    if (!async_request_output(req, ROUNDUP(size * cnt + 0x40, 0x40))) {
+        async_request_free(req);
+        return -2;
+    }
+
+    req->user_data = data;
+    req->user_size = size * cnt;
+
+    return async_submit(req, IOCTL_FSA_READFILE);
+}
+
+int IOSUHAX_FSA_WriteFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, const void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_RESULT, cookie);
+    if (!req)
+        return -2;
+
+    if (iosuhaxFileIoctlvConfirmed && iosuhaxFileIoctlvSupported && IS_VECTOR_ALIGNED(data, size * cnt)) {
+        req->in_inline[0] = fsaFd;
+        req->in_inline[1] = size;
+        req->in_inline[2] = cnt;
+        req->in_inline[3] = fileHandle;
+        req->in_inline[4] = flags;
+        async_request_vectored(req, sizeof(uint32_t) * 5, (void *) data, size * cnt);
+        return async_submit(req, IOCTL_FSA_WRITEFILE);
+    }
+
+    uint32_t *io_buf = async_request_input(req, ROUNDUP(sizeof(uint32_t) * 5 + size * cnt + 0x40, 0x40));
+    if (!io_buf) {
+        async_request_free(req);
+        return -2;
+    }
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = size;
+    io_buf[2] = cnt;
+    io_buf[3] = fileHandle;
+    io_buf[4] = flags;
+
+    //! data is put to offset 0x40 to align the buffer input
+    memcpy(((uint8_t *) io_buf) + 0x40, data, size * cnt);
+    iosuhax_buffer_count_copy(size * cnt);
+
+    return async_submit(req, IOCTL_FSA_WRITEFILE);
+}
+
+int IOSUHAX_FSA_StatFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, int fileHandle, FSStat *out_data, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_STAT, cookie);
+    if (!req)
+        return -2;
+
+    uint32_t *io_buf = async_request_input(req, sizeof(uint32_t) * 2);
+    io_buf[0]        = fsaFd;
+    io_buf[1]        = fileHandle;
+
+    if (!async_request_output(req, 4 + sizeof(FSStat))) {
+        async_request_free(req);
+        return -2;
+    }
+
+    req->user_data = out_data;
+
+    return async_submit(req, IOCTL_FSA_STATFILE);
+}
+
+int IOSUHAX_FSA_CloseFileAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, int fileHandle, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_RESULT, cookie);
+    if (!req)
+        return -2;
+
+    uint32_t *io_buf = async_request_input(req, sizeof(uint32_t) * 2);
+    io_buf[0]        = fsaFd;
+    io_buf[1]        = fileHandle;
+
+    return async_submit(req, IOCTL_FSA_CLOSEFILE);
+}
+
+int IOSUHAX_FSA_RawReadAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, void *data, uint32_t block_size, uint32_t block_cnt, uint64_t sector_offset, int device_handle, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_READ, cookie);
+    if (!req)
+        return -2;
+
+    if (iosuhaxRawIoctlvSupported && IS_VECTOR_ALIGNED(data, block_size * block_cnt)) {
+        req->in_inline[0] = fsaFd;
+        req->in_inline[1] = block_size;
+        req->in_inline[2] = block_cnt;
+        req->in_inline[3] = (sector_offset >> 32) & 0xFFFFFFFF;
+        req->in_inline[4] = sector_offset & 0xFFFFFFFF;
+        req->in_inline[5] = device_handle;
+        async_request_vectored(req, sizeof(uint32_t) * 6, data, block_size * block_cnt);
+        return async_submit(req, IOCTL_FSA_RAW_READ);
+    }
+
+    // raw reads use a single buffer for the request header and the reply
+    uint32_t *io_buf = async_request_output(req, ROUNDUP(0x40 + block_size * block_cnt, 0x40));
+    if (!io_buf) {
+        async_request_free(req);
+        return -2;
+    }
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = block_size;
+    io_buf[2] = block_cnt;
+    io_buf[3] = (sector_offset >> 32) & 0xFFFFFFFF;
+    io_buf[4] = sector_offset & 0xFFFFFFFF;
+    io_buf[5] = device_handle;
+
+    req->in_buf      = io_buf;
+    req->in_buf_size = sizeof(uint32_t) * 6;
+    req->user_data   = data;
+    req->user_size   = block_size * block_cnt;
+
+    return async_submit(req, IOCTL_FSA_RAW_READ);
+}
+
+int IOSUHAX_FSA_RawWriteAsync(IOSUHAX_AsyncQueue *queue, int fsaFd, const void *data, uint32_t block_size, uint32_t block_cnt, uint64_t sector_offset, int device_handle, void *cookie) {
+    if (!queue)
+        return -1;
+
+    async_request_t *req = async_request_alloc(queue, ASYNC_OP_RESULT, cookie);
+    if (!req)
+        return -2;
+
+    if (iosuhaxRawIoctlvSupported && IS_VECTOR_ALIGNED(data, block_size * block_cnt)) {
+        req->in_inline[0] = fsaFd;
+        req->in_inline[1] = block_size;
+        req->in_inline[2] = block_cnt;
+        req->in_inline[3] = (sector_offset >> 32) & 0xFFFFFFFF;
+        req->in_inline[4] = sector_offset & 0xFFFFFFFF;
+        req->in_inline[5] = device_handle;
+        async_request_vectored(req, sizeof(uint32_t) * 6, (void *) data, block_size * block_cnt);
+        return async_submit(req, IOCTL_FSA_RAW_WRITE);
+    }
+
+    uint32_t *io_buf = async_request_input(req, ROUNDUP(0x40 + block_size * block_cnt, 0x40));
+    if (!io_buf) {
+        async_request_free(req);
+        return -2;
+    }
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = block_size;
+    io_buf[2] = block_cnt;
+    io_buf[3] = (sector_offset >> 32) & 0xFFFFFFFF;
+    io_buf[4] = sector_offset & 0xFFFFFFFF;
+    io_buf[5] = device_handle;
+
+    //! data is put to offset 0x40 to align the buffer input
+    memcpy(((uint8_t *) io_buf) + 0x40, data, block_size * block_cnt);
+    iosuhax_buffer_count_copy(block_size * block_cnt);
+
+    // the result word is written back to the start of the request buffer
+    req->out_buf      = io_buf;
+    req->out_buf_size = 4;
+
+    return async_submit(req, IOCTL_FSA_RAW_WRITE);
+}
@@ -0,0 +1,376 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax.h"
+#include "iosuhax_buffer_pool.h"
+#include "iosuhax_ipc.h"
+#include "iosuhax_stats.h"
+#include "os_functions.h"
+#include <malloc.h>
+#include <string.h>
+
+//! IOCTL_FSA_BATCH request layout:
+//!   0x00: fsaFd, operation count, request size, reply size
+//!   0x10: one entry per operation: code, entry size, arguments.
+//!         Strings follow the arguments, their offsets are relative to the entry start.
+//!         A file handle of IOSUHAX_BATCH_OP_HANDLE(n) refers to the handle opened by entry n.
+//!
+//! Reply layout:
+//!   0x00: number of executed operations
+//!   0x40: one slot per operation, the result word followed by its output.
+//!         ReadFile slots are 0x40 aligned and have the data at offset 0x40 of the slot.
+
+#define BATCH_REQUEST_HEADER_SIZE 0x10
+#define BATCH_REPLY_HEADER_SIZE   0x40
+#define BATCH_REQUEST_MIN_SIZE    0x400
+
+typedef struct _batch_op_t {
+    uint32_t code;
+    uint32_t in_offset;
+    uint32_t out_offset;
+    void *out_data;
+    uint32_t out_size;
+    int fileHandle;
+    int openedHandle;
+    int result;
+} batch_op_t;
+
+struct _IOSUHAX_Batch {
+    int fsaFd;
+    uint32_t max_ops;
+    uint32_t op_count;
+    uint8_t *in_buf;
+    uint32_t in_size;
+    uint32_t in_capacity;
+    uint32_t out_size;
+    batch_op_t *ops;
+};
+
+//! cleared once IOSU rejects a batch, afterwards every batch is dispatched sequentially
+static int batchIoctlSupported = 1;
+
+IOSUHAX_Batch *IOSUHAX_CreateBatch(int fsaFd, uint32_t max_ops) {
+    if (max_ops == 0)
+        return NULL;
+
+    IOSUHAX_Batch *batch = (IOSUHAX_Batch *) malloc(sizeof(IOSUHAX_Batch) + sizeof(batch_op_t) * max_ops);
+    if (!batch)
+        return NULL;
+
+    batch->in_buf = (uint8_t *) iosuhax_request_alloc(IOCTL_FSA_BATCH, BATCH_REQUEST_MIN_SIZE);
+    if (!batch->in_buf) {
+        free(batch);
+        return NULL;
+    }
+
+    batch->fsaFd       = fsaFd;
+    batch->max_ops     = max_ops;
+    batch->in_capacity = BATCH_REQUEST_MIN_SIZE;
+    batch->ops         = (batch_op_t *) (batch + 1);
+
+    IOSUHAX_ResetBatch(batch);
+    return batch;
+}
+
+void IOSUHAX_DestroyBatch(IOSUHAX_Batch *batch) {
+    if (!batch)
+        return;
+
+    iosuhax_buffer_free(batch->in_buf, batch->in_capacity);
+    free(batch);
+}
+
+void IOSUHAX_ResetBatch(IOSUHAX_Batch *batch) {
+    if (!batch)
+        return;
+
+    batch->op_count = 0;
+    batch->in_size  = BATCH_REQUEST_HEADER_SIZE;
+    batch->out_size = BATCH_REPLY_HEADER_SIZE;
+}
+
+//! Appends an entry made of 'arg_cnt' argument words and up to two strings.
+static int batch_append(IOSUHAX_Batch *batch, uint32_t code, const uint32_t *args, int arg_cnt, const char *str1, const char *str2, uint32_t out_size) {
+    if (batch->op_count >= batch->max_ops)
+        return -3;
+
+    int header_size = sizeof(uint32_t) * (2 + arg_cnt + (str1 ? 1 : 0) + (str2 ? 1 : 0));
+    int str1_len    = str1 ? strlen(str1) + 1 : 0;
+    int str2_len    = str2 ? strlen(str2) + 1 : 0;
+    int entry_size  = ROUNDUP(header_size + str1_len + str2_len, 4);
+
+    if (batch->in_size + entry_size > batch->in_capacity) {
+        uint32_t capacity = batch->in_capacity;
+        while (batch->in_size + entry_size > capacity)
+            capacity <<= 1;
+
+        uint8_t *in_buf = (uint8_t *) iosuhax_request_alloc(IOCTL_FSA_BATCH, capacity);
+        if (!in_buf)
+            return -2;
+
+        memcpy(in_buf, batch->in_buf, batch->in_size);
+        iosuhax_buffer_free(batch->in_buf, batch->in_capacity);
+        batch->in_buf      = in_buf;
+        batch->in_capacity = capacity;
+    }
+
+    uint32_t *entry = (uint32_t *) (batch->in_buf + batch->in_size);
+    int word        = 0;
+    entry[word++]   = code;
+    entry[word++]   = entry_size;
+    if (str1)
+        entry[word++] = header_size;
+    if (str2)
+        entry[word++] = header_size + str1_len;
+    for (int i = 0; i < arg_cnt; i++)
+        entry[word++] = args[i];
+
+    if (str1)
+        memcpy(((uint8_t *) entry) + header_size, str1, str1_len);
+    if (str2)
+        memcpy(((uint8_t *) entry) + header_size + str1_len, str2, str2_len);
+
+    batch_op_t *op = &batch->ops[batch->op_count];
+    memset(op, 0, sizeof(batch_op_t));
+    op->code      = code;
+    op->in_offset = batch->in_size;
+
+    if (code == IOCTL_FSA_READFILE) {
+        op->out_offset  = ROUNDUP(batch->out_size, 0x40);
+        batch->out_size = op->out_offset + 0x40 + ROUNDUP(out_size, 0x40);
+    } else {
+        op->out_offset  = batch->out_size;
+        batch->out_size = op->out_offset + ROUNDUP(sizeof(uint32_t) + out_size, 4);
+    }
+
+    batch->in_size += entry_size;
+    return batch->op_count++;
+}
+
+static int batch_check_handle(IOSUHAX_Batch *batch, int fileHandle) {
+    if (fileHandle > IOSUHAX_BATCH_OP_HANDLE(0))
+        return 0;
+
+    uint32_t index = (uint32_t) (IOSUHAX_BATCH_OP_HANDLE(0) - fileHandle);
+    if (index >= batch->op_count || batch->ops[index].code != IOCTL_FSA_OPENFILE)
+        return -1;
+
+    return 0;
+}
+
+int IOSUHAX_Batch_GetStat(IOSUHAX_Batch *batch, const char *path, FSStat *out_data) {
+    if (!batch || !path || !out_data)
+        return -1;
+
+    int index = batch_append(batch, IOCTL_FSA_GETSTAT, NULL, 0, path, NULL, sizeof(FSStat));
+    if (index >= 0)
+        batch->ops[index].out_data = out_data;
+    return index;
+}
+
+int IOSUHAX_Batch_OpenFile(IOSUHAX_Batch *batch, const char *path, const char *mode, int *outHandle) {
+    if (!batch || !path || !mode)
+        return -1;
+
+    int index = batch_append(batch, IOCTL_FSA_OPENFILE, NULL, 0, path, mode, sizeof(uint32_t));
+    if (index >= 0)
+        batch->ops[index].out_data = outHandle;
+    return index;
+}
+
+int IOSUHAX_Batch_ReadFile(IOSUHAX_Batch *batch, void *data, uint32_t size, uint32_t cnt, int fileHandle, uint32_t flags) {
+    if (!batch || batch_check_handle(batch, fileHandle) < 0)
+        return -1;
+
+    uint32_t args[4] = {size, cnt, (uint32_t) fileHandle, flags};
+
+    int index = batch_append(batch, IOCTL_FSA_READFILE, args, 4, NULL, NULL, size * cnt);
+    if (index >= 0) {
+        batch->ops[index].out_data   = data;
+        batch->ops[index].out_size   = size * cnt;
+        batch->ops[index].fileHandle = fileHandle;
+    }
+    return index;
+}
+
+int IOSUHAX_Batch_CloseFile(IOSUHAX_Batch *batch, int fileHandle) {
+    if (!batch || batch_check_handle(batch, fileHandle) < 0)
+        return -1;
+
+    uint32_t args[1] = {(uint32_t) fileHandle};
+
+    int index = batch_append(batch, IOCTL_FSA_CLOSEFILE, args, 1, NULL, NULL, 0);
+    if (index >= 0)
+        batch->ops[index].fileHandle = fileHandle;
+    return index;
+}
+
+int IOSUHAX_Batch_Remove(IOSUHAX_Batch *batch, const char *path) {
+    if (!batch || !path)
+        return -1;
+
+    return batch_append(batch, IOCTL_FSA_REMOVE, NULL, 0, path, NULL, 0);
+}
+
+int IOSUHAX_Batch_MakeDir(IOSUHAX_Batch *batch, const char *path, uint32_t flags) {
+    if (!batch || !path)
+        return -1;
+
+    uint32_t args[1] = {flags};
+
+    return batch_append(batch, IOCTL_FSA_MAKEDIR, args, 1, path, NULL, 0);
+}
+
+//! Maps a handle reference to the handle opened earlier in the batch.
+//! Returns the error of the referenced OpenFile if it failed.
+static int batch_resolve_handle(IOSUHAX_Batch *batch, int fileHandle, int *resolved) {
+    if (fileHandle > IOSUHAX_BATCH_OP_HANDLE(0)) {
+        *resolved = fileHandle;
+        return 0;
+    }
+
+    batch_op_t *open_op = &batch->ops[IOSUHAX_BATCH_OP_HANDLE(0) - fileHandle];
+    if (open_op->result < 0)
+        return open_op->result;
+
+    *resolved = open_op->openedHandle;
+    return 0;
+}
+
+static void batch_dispatch_sequential(IOSUHAX_Batch *batch, uint32_t first) {
+    for (uint32_t i = first; i < batch->op_count; i++) {
+        batch_op_t *op  = &batch->ops[i];
+        uint32_t *entry = (uint32_t *) (batch->in_buf + op->in_offset);
+        int fileHandle;
+
+        switch (op->code) {
+            case IOCTL_FSA_GETSTAT:
+                op->result = IOSUHAX_FSA_GetStat(batch->fsaFd, ((char *) entry) + entry[2], (FSStat *) op->out_data);
+                break;
+            case IOCTL_FSA_OPENFILE:
+                op->result = IOSUHAX_FSA_OpenFile(batch->fsaFd, ((char *) entry) + entry[2], ((char *) entry) + entry[3], &op->openedHandle);
+                if (op->out_data)
+                    *(int *) op->out_data = op->openedHandle;
+                break;
+            case IOCTL_FSA_READFILE:
+                op->result = batch_resolve_handle(batch, op->fileHandle, &fileHandle);
+                if (op->result == 0)
+                    op->result = IOSUHAX_FSA_ReadFile(batch->fsaFd, op->out_data, entry[2], entry[3], fileHandle, entry[5]);
+                break;
+            case IOCTL_FSA_CLOSEFILE:
+                op->result = batch_resolve_handle(batch, op->fileHandle, &fileHandle);
+                if (op->result == 0)
+                    op->result = IOSUHAX_FSA_CloseFile(batch->fsaFd, fileHandle);
+                break;
+            case IOCTL_FSA_REMOVE:
+                op->result = IOSUHAX_FSA_Remove(batch->fsaFd, ((char *) entry) + entry[2]);
+                break;
+            case IOCTL_FSA_MAKEDIR:
+                op->result = IOSUHAX_FSA_MakeDir(batch->fsaFd, ((char *) entry) + entry[2], entry[3]);
+                break;
+        }
+    }
+}
+
+//! Copies the outputs of the operations IOSU executed out of the batch reply.
+static void batch_copy_reply(IOSUHAX_Batch *batch, const uint8_t *out_buf, uint32_t done) {
+    for (uint32_t i = 0; i < done; i++) {
+        batch_op_t *op       = &batch->ops[i];
+        const uint32_t *slot = (const uint32_t *) (out_buf + op->out_offset);
+
+        op->result = (int) slot[0];
+
+        switch (op->code) {
+            case IOCTL_FSA_GETSTAT: {
+                FSStat *out_data = (FSStat *) op->out_data;
+                memcpy(out_data, slot + 1, sizeof(FSStat));
+
+                // Force FS_STAT_FILE when a size is set.
+                if ((out_data->flags & FS_STAT_DIRECTORY) != FS_STAT_DIRECTORY && out_data->size > 0) {
+                    out_data->flags |= FS_STAT_FILE;
+                }
+                break;
+            }
+            case IOCTL_FSA_OPENFILE:
+                op->openedHandle = (int) slot[1];
+                if (op->out_data)
+                    *(int *) op->out_data = op->openedHandle;
+                break;
+            case IOCTL_FSA_READFILE:
+                //! data is put to offset 0x40 of the slot to align the buffer output
+                memcpy(op->out_data, ((const uint8_t *) slot) + 0x40, op->out_size);
+                iosuhax_buffer_count_copy(op->out_size);
+                break;
+        }
+    }
+}
+
+int IOSUHAX_Batch_Submit(IOSUHAX_Batch *batch, int *results) {
+    if (!batch)
+        return -1;
+
+    int handle = iosuhax_get_handle();
+    if (handle < 0)
+        return handle;
+
+    if (batch->op_count == 0)
+        return 0;
+
+    uint32_t done = 0;
+
+    if (batchIoctlSupported) {
+        uint32_t *out_buf = (uint32_t *) iosuhax_request_alloc(IOCTL_FSA_BATCH, batch->out_size);
+        if (!out_buf)
+            return -2;
+
+        uint32_t *header = (uint32_t *) batch->in_buf;
+        header[0]        = batch->fsaFd;
+        header[1]        = batch->op_count;
+        header[2]        = batch->in_size;
+        header[3]        = batch->out_size;
+
+        out_buf[0] = 0xFFFFFFFF;
+
+        int res = iosuhax_ioctl(handle, IOCTL_FSA_BATCH, batch->in_buf, batch->in_size, out_buf, batch->out_size);
+        if (res >= 0 && out_buf[0] <= batch->op_count) {
+            done = out_buf[0];
+            batch_copy_reply(batch, (const uint8_t *) out_buf, done);
+        } else if (res >= 0 || IOSUHAX_IOCTL_UNSUPPORTED(res)) {
+            //! IOSU does not handle batches, dispatch each operation on its own
+            batchIoctlSupported = 0;
+        }
+        // any other failure only sends this batch through the sequential path
+
+        iosuhax_buffer_free(out_buf, batch->out_size);
+    }
+
+    // whatever IOSU did not get to is executed one by one
+    batch_dispatch_sequential(batch, done);
+
+    if (results) {
+        for (uint32_t i = 0; i < batch->op_count; i++)
+            results[i] = batch->ops[i].result;
+    }
+
+    return batch->op_count;
+}
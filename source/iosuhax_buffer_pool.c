@@ -0,0 +1,172 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax_buffer_pool.h"
+#include "iosuhax.h"
+#include "iosuhax_ipc.h"
+#include "os_functions.h"
+#include <malloc.h>
+#include <string.h>
+
+//! size classes are powers of two from 0x40 up to 0x4000 bytes
+#define POOL_MIN_SHIFT   6
+#define POOL_MAX_SHIFT   14
+#define POOL_CLASS_COUNT (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+
+//! maximum number of idle buffers kept per size class
+#define POOL_CLASS_DEPTH 4
+
+typedef struct _pool_class_t {
+    void *buffers[POOL_CLASS_DEPTH];
+    uint32_t count;
+} pool_class_t;
+
+static pool_class_t poolClasses[POOL_CLASS_COUNT];
+static uint32_t poolMutex[(OS_MUTEX_SIZE + 3) >> 2];
+static int poolInitialized = 0;
+
+static IOSUHAX_BufferStats poolStats;
+
+static int pool_get_class(uint32_t size) {
+    int shift = POOL_MIN_SHIFT;
+    while ((1u << shift) < size) {
+        if (++shift > POOL_MAX_SHIFT)
+            return -1;
+    }
+    return shift - POOL_MIN_SHIFT;
+}
+
+void iosuhax_buffer_pool_init(void) {
+    if (poolInitialized)
+        return;
+
+    memset(poolClasses, 0, sizeof(poolClasses));
+    memset(&poolStats, 0, sizeof(poolStats));
+    OSInitMutex(poolMutex);
+    poolInitialized = 1;
+}
+
+void iosuhax_buffer_pool_clear(void) {
+    if (!poolInitialized)
+        return;
+
+    OSLockMutex(poolMutex);
+    for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+        for (uint32_t n = 0; n < poolClasses[i].count; n++) {
+            free(poolClasses[i].buffers[n]);
+        }
+        poolClasses[i].count = 0;
+    }
+    poolStats.cached = 0;
+    OSUnlockMutex(poolMutex);
+}
+
+void *iosuhax_buffer_alloc(uint32_t size) {
+    int cls = pool_get_class(size);
+    if (cls < 0) {
+        if (poolInitialized) {
+            OSLockMutex(poolMutex);
+            poolStats.oversized++;
+            OSUnlockMutex(poolMutex);
+        }
+        return memalign(IOSUHAX_BUFFER_POOL_ALIGN, ROUNDUP(size, IOSUHAX_BUFFER_POOL_ALIGN));
+    }
+
+    void *buffer = NULL;
+
+    if (poolInitialized) {
+        OSLockMutex(poolMutex);
+        pool_class_t *pool = &poolClasses[cls];
+        if (pool->count > 0) {
+            buffer = pool->buffers[--pool->count];
+            poolStats.cached--;
+            poolStats.hits++;
+        } else {
+            poolStats.misses++;
+        }
+        OSUnlockMutex(poolMutex);
+    }
+
+    //! always allocate the full class size so the buffer can be recycled for any request of this class
+    if (!buffer)
+        buffer = memalign(IOSUHAX_BUFFER_POOL_ALIGN, 1u << (cls + POOL_MIN_SHIFT));
+
+    return buffer;
+}
+
+void iosuhax_buffer_free(void *buffer, uint32_t size) {
+    if (!buffer)
+        return;
+
+    int cls = pool_get_class(size);
+    if (cls < 0 || !poolInitialized) {
+        free(buffer);
+        return;
+    }
+
+    OSLockMutex(poolMutex);
+    pool_class_t *pool = &poolClasses[cls];
+    if (pool->count < POOL_CLASS_DEPTH) {
+        pool->buffers[pool->count++] = buffer;
+        poolStats.cached++;
+        buffer = NULL;
+    }
+    OSUnlockMutex(poolMutex);
+
+    free(buffer);
+}
+
+void iosuhax_buffer_count_copy(uint32_t size) {
+    if (!poolInitialized || !size)
+        return;
+
+    OSLockMutex(poolMutex);
+    poolStats.copied += size;
+    OSUnlockMutex(poolMutex);
+}
+
+int IOSUHAX_GetBufferStats(IOSUHAX_BufferStats *stats) {
+    if (!stats)
+        return -1;
+
+    if (!poolInitialized) {
+        memset(stats, 0, sizeof(IOSUHAX_BufferStats));
+        return 0;
+    }
+
+    OSLockMutex(poolMutex);
+    memcpy(stats, &poolStats, sizeof(IOSUHAX_BufferStats));
+    OSUnlockMutex(poolMutex);
+    return 0;
+}
+
+void IOSUHAX_ResetBufferStats(void) {
+    if (!poolInitialized)
+        return;
+
+    OSLockMutex(poolMutex);
+    uint32_t cached = poolStats.cached;
+    memset(&poolStats, 0, sizeof(IOSUHAX_BufferStats));
+    poolStats.cached = cached;
+    OSUnlockMutex(poolMutex);
+}
@@ -0,0 +1,30 @@
+#ifndef __IOSUHAX_BUFFER_POOL_H_
+#define __IOSUHAX_BUFFER_POOL_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! All buffers handed out by the pool are aligned to this boundary, which
+//! satisfies both the 0x20 (io_buf) and 0x40 (data payload) requirements of IOSU.
+#define IOSUHAX_BUFFER_POOL_ALIGN 0x40
+
+void iosuhax_buffer_pool_init(void);
+
+void iosuhax_buffer_pool_clear(void);
+
+//! Returns a buffer of at least 'size' bytes. Must be released with the same size.
+void *iosuhax_buffer_alloc(uint32_t size);
+
+void iosuhax_buffer_free(void *buffer, uint32_t size);
+
+//! Accounts payload bytes that had to be copied through a staging buffer.
+void iosuhax_buffer_count_copy(uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __IOSUHAX_BUFFER_POOL_H_
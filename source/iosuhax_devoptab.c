@@ -22,7 +22,12 @@
  * distribution.
  ***************************************************************************/
 #include "iosuhax.h"
+#include "iosuhax_devoptab.h"
+#include "iosuhax_ipc.h"
+#include "iosuhax_page_cache.h"
+#include "iosuhax_stat_cache.h"
 #include "os_functions.h"
+#include <coreinit/thread.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <malloc.h>
@@ -34,22 +39,87 @@
 #include <sys/iosupport.h>
 #include <sys/statvfs.h>
 
+//! transfers of at least this size are split so the aligned bulk bypasses the IOSUHAX staging copy
+#define FS_DEV_DIRECT_IO_MIN 0x10000
+
+//! larger transfers are streamed in chunks of this size with two chunks in flight
+#define FS_DEV_STREAM_CHUNK 0x10000
+#define FS_DEV_STREAM_DEPTH 2
+
+//! the read-ahead window starts at this size and doubles with every sequential refill
+#define FS_DEV_READ_AHEAD_MIN 0x1000
+
+//! number of buckets of the device name table
+#define FS_DEV_NAME_BUCKETS 16
+
+//! size of the buffers devoptab paths are translated into, the limit of FSA paths
+#define FS_DEV_PATH_MAX 0x280
+
+//! number of directory entries fetched per refill of the dirnext buffer
+#define FS_DEV_DIR_ENTRIES IOSUHAX_READDIR_MULTI_MAX
+
+//! One FSA handle of a mount. Files stay on the channel they were opened on, requests on
+//! different channels run in parallel.
+typedef struct _fs_dev_channel_t {
+    int fsaFd;
+    void *pMutex;                // held while a file streams through ioQueue and ioStaging
+    IOSUHAX_AsyncQueue *ioQueue; // created on the first streamed transfer
+    char *ioStaging;             // FS_DEV_STREAM_DEPTH chunks for unaligned parts of the caller's buffer, only used with vectored async requests
+    uint32_t openFiles;
+} fs_dev_channel_t;
+
 typedef struct _fs_dev_private_t {
+    const char *name; // device name without the ':'
+    uint32_t nameLen;
+    uint32_t nameHash;
+    struct _fs_dev_private_t *nameNext;
+    uint32_t refs;    // calls using the device, see fs_dev_get_device_data, guarded by the name mutex
+    int removed;      // unlinked by fs_dev_remove_device, which waits for refs to drop to 0
     char *mount_path;
+    uint32_t mountPathLen;
     int fsaFd;
     int mounted;
-    void *pMutex;
+    void *pMutex;      // the caches and the counters, only held briefly
+    void *nsMutex;     // namespace lock, held by readers while they register and by a writer for its whole request
+    void *nsCond;      // signalled when the last reader leaves
+    uint32_t nsReaders;
+    int readOnly;      // nothing modifies the namespace, so it is not locked at all
+    fs_dev_channel_t channels[MOUNT_FS_FSA_HANDLES_MAX];
+    uint32_t channelCount;
+    uint32_t readAheadSize;
+    uint32_t writeBackSize;
+    uint32_t pageCacheSize;
+    iosuhax_page_cache_t *pageCache; // created on the first cached read
+    iosuhax_stat_cache_t *statCache; // NULL if stat results are not cached
+    int statCacheNegative;
+    uint32_t statGeneration; // bumped by every write to a file, stat results requested before are not cached
+    mount_fs_stats_t stats;
 } fs_dev_private_t;
 
 typedef struct _fs_dev_file_state_t {
     fs_dev_private_t *dev;
+    fs_dev_channel_t *channel;                 /* FSA handle the file was opened on */
+    void *pMutex;                              /* Serializes requests on this file */
     int fd;                                    /* File descriptor */
     int flags;                                 /* Opening flags */
     bool read;                                 /* True if allowed to read from file */
     bool write;                                /* True if allowed to write to file */
     bool append;                               /* True if allowed to append to file */
-    uint32_t pos;                              /* Current position within the file (in bytes) */
-    uint32_t len;                              /* Total length of the file (in bytes) */
+    uint32_t entryId;                          /* FSA entry id, identifies the file in the page cache, 0 while it is not known */
+    uint64_t pos;                              /* Current position within the file (in bytes) */
+    uint64_t len;                              /* Total length of the file (in bytes), see fs_dev_file_len */
+    bool lenValid;                             /* False until len and entryId are fetched for a file opened without OPENFILE_STAT */
+    uint64_t fsaPos;                           /* Position of the FSA file handle, lags behind pos while reads are buffered */
+    uint8_t *raBuffer;                         /* Read-ahead data, allocated with the read-ahead size of the mount */
+    uint64_t raStart;                          /* File offset of the first byte in raBuffer */
+    uint32_t raLen;                            /* Number of valid bytes in raBuffer */
+    uint32_t raWindow;                         /* Size of the next refill, grows while reads are sequential */
+    uint64_t raNext;                           /* Position after the previous read, used to detect sequential access */
+    uint8_t *wbBuffer;                         /* Write-back data, allocated with the write-back size of the mount */
+    uint64_t wbStart;                          /* File offset of the first byte in wbBuffer */
+    uint32_t wbLen;                            /* Number of bytes in wbBuffer not written to the file yet */
+    FSStat stat;                               /* Result of the last stat on the handle, size is tracked in len instead */
+    bool statValid;                            /* False once the file was written through this handle */
     struct _fs_dev_file_state_t *prevOpenFile; /* The previous entry in a double-linked FILO list of open files */
     struct _fs_dev_file_state_t *nextOpenFile; /* The next entry in a double-linked FILO list of open files */
 } fs_dev_file_state_t;
@@ -57,52 +127,114 @@ typedef struct _fs_dev_file_state_t {
 typedef struct _fs_dev_dir_entry_t {
     fs_dev_private_t *dev;
     int dirHandle;
+    FSDirectoryEntry *entries; /* FS_DEV_DIR_ENTRIES entries, dirnext is served from here */
+    uint32_t entryCnt;         /* Number of valid entries */
+    uint32_t entryIdx;         /* Next entry handed out by dirnext */
+    char *path;                /* FSA path of the directory with a trailing '/', only kept if the mount caches stat results */
+    uint32_t pathLen;
 } fs_dev_dir_entry_t;
 
-static fs_dev_private_t *fs_dev_get_device_data(const char *path) {
-    const devoptab_t *devoptab = NULL;
-    char name[128]             = {0};
-    int i;
+//! devices added by fs_dev_add_device, chained by nameNext
+static fs_dev_private_t *fs_dev_name_table[FS_DEV_NAME_BUCKETS];
 
-    // Get the device name from the path
-    strncpy(name, path, 127);
-    strtok(name, ":/");
+static uint32_t fs_dev_name_hash(const char *name, uint32_t *len) {
+    uint32_t hash = 0x811C9DC5;
+    uint32_t i    = 0;
+    while (name[i] && name[i] != ':' && name[i] != '/') {
+        hash = (hash ^ (uint8_t) name[i]) * 0x01000193;
+        i++;
+    }
+    *len = i;
+    return hash;
+}
 
-    // Search the devoptab table for the specified device name
-    // NOTE: We do this manually due to a 'bug' in GetDeviceOpTab
-    //       which ignores names with suffixes and causes names
-    //       like "ntfs" and "ntfs1" to be seen as equals
-    for (i = 3; i < STD_MAX; i++) {
-        devoptab = devoptab_list[i];
-        if (devoptab && devoptab->name) {
-            if (strcmp(name, devoptab->name) == 0) {
-                return (fs_dev_private_t *) devoptab->deviceData;
-            }
-        }
+#define FS_DEV_NAMES_UNINITIALIZED 0
+#define FS_DEV_NAMES_INITIALIZING  1
+#define FS_DEV_NAMES_READY         2
+
+//! guards fs_dev_name_table, the devoptab_list slots and the device refs, initialized by the first caller like the transport mutex
+static volatile uint32_t fs_dev_name_state = FS_DEV_NAMES_UNINITIALIZED;
+static uint32_t fs_dev_name_mutex[(OS_MUTEX_SIZE + 3) >> 2];
+static uint32_t fs_dev_name_cond[(OS_COND_SIZE + 3) >> 2]; // signalled when the last ref of a removed device is dropped
+
+static void fs_dev_name_lock(void) {
+    uint32_t expected = FS_DEV_NAMES_UNINITIALIZED;
+    if (__atomic_compare_exchange_n(&fs_dev_name_state, &expected, FS_DEV_NAMES_INITIALIZING, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        OSInitMutex(fs_dev_name_mutex);
+        OSInitCond(fs_dev_name_cond);
+        __atomic_store_n(&fs_dev_name_state, FS_DEV_NAMES_READY, __ATOMIC_RELEASE);
+    } else {
+        while (__atomic_load_n(&fs_dev_name_state, __ATOMIC_ACQUIRE) != FS_DEV_NAMES_READY)
+            OSYieldThread();
+    }
+
+    OSLockMutex(fs_dev_name_mutex);
+}
+
+static void fs_dev_name_unlock(void) {
+    OSUnlockMutex(fs_dev_name_mutex);
+}
+
+//! The name mutex has to be held.
+static fs_dev_private_t *fs_dev_find_device(const char *path) {
+    // Skip leading separators the same way strtok(path, ":/") would
+    while (*path == ':' || *path == '/')
+        path++;
+
+    // Hash the device name in place, it ends at the first ':' or '/'
+    uint32_t len;
+    uint32_t hash = fs_dev_name_hash(path, &len);
+
+    // The length has to match as well, names like "ntfs" and "ntfs1" must not be seen as equals
+    fs_dev_private_t *dev = fs_dev_name_table[hash % FS_DEV_NAME_BUCKETS];
+    while (dev) {
+        if (dev->nameHash == hash && dev->nameLen == len && memcmp(dev->name, path, len) == 0)
+            return dev;
+        dev = dev->nameNext;
     }
 
     return NULL;
 }
 
-static char *fs_dev_real_path(const char *path, fs_dev_private_t *dev) {
+//! Looks up the device of a path and takes a ref on it, fs_dev_remove_device does not free the device before
+//! the ref is dropped with fs_dev_put_device_data. Open files and directories do not hold a ref, they have to
+//! be closed before the device is unmounted.
+static fs_dev_private_t *fs_dev_get_device_data(const char *path) {
+    fs_dev_name_lock();
+    fs_dev_private_t *dev = fs_dev_find_device(path);
+    if (dev)
+        dev->refs++;
+    fs_dev_name_unlock();
+    return dev;
+}
+
+static void fs_dev_put_device_data(fs_dev_private_t *dev) {
+    fs_dev_name_lock();
+    if (--dev->refs == 0 && dev->removed)
+        OSSignalCond(fs_dev_name_cond);
+    fs_dev_name_unlock();
+}
+
+//! Writes the FSA path for a devoptab path to 'out', which has to hold FS_DEV_PATH_MAX bytes.
+//! Returns the length of the path or -1 if it does not fit.
+static int fs_dev_real_path(char *out, const char *path, fs_dev_private_t *dev) {
     // Sanity check
     if (!path)
-        return NULL;
+        return -1;
 
     // Move the path pointer to the start of the actual path
-    if (strchr(path, ':') != NULL) {
-        path = strchr(path, ':') + 1;
+    const char *colon = strchr(path, ':');
+    if (colon != NULL) {
+        path = colon + 1;
     }
 
-    int mount_len = strlen(dev->mount_path);
+    size_t path_len = strlen(path);
+    if (dev->mountPathLen + path_len >= FS_DEV_PATH_MAX)
+        return -1;
 
-    char *new_name = (char *) malloc(mount_len + strlen(path) + 1);
-    if (new_name) {
-        strcpy(new_name, dev->mount_path);
-        strcpy(new_name + mount_len, path);
-        return new_name;
-    }
-    return new_name;
+    memcpy(out, dev->mount_path, dev->mountPathLen);
+    memcpy(out + dev->mountPathLen, path, path_len + 1);
+    return dev->mountPathLen + path_len;
 }
 
 static int fs_dev_translate_error(FSStatus error) {
@@ -184,13 +316,456 @@ static time_t fs_dev_translate_time(FSTime timeValue) {
     return mktime(&posixTime);
 }
 
-static int fs_dev_open_r(struct _reent *r, void *fileStruct, const char *path, int flags, int mode) {
-    fs_dev_private_t *dev = fs_dev_get_device_data(path);
-    if (!dev) {
-        r->_errno = ENODEV;
-        return -1;
+//! Locks a mutex and counts the times it was held by another thread.
+static void fs_dev_lock(void *mutex, uint32_t *waits) {
+    if (!OSTryLockMutex(mutex)) {
+        __atomic_fetch_add(waits, 1, __ATOMIC_RELAXED);
+        OSLockMutex(mutex);
+    }
+}
+
+//! Namespace requests that only look at the volume share the lock, requests that change it take it exclusively
+//! so the caches never see a result that was overtaken by a change.
+static void fs_dev_ns_lock(fs_dev_private_t *dev, int exclusive) {
+    if (dev->readOnly)
+        return;
+
+    fs_dev_lock(dev->nsMutex, &dev->stats.namespace_lock_waits);
+    if (!exclusive) {
+        dev->nsReaders++;
+        OSUnlockMutex(dev->nsMutex);
+        return;
+    }
+
+    if (dev->nsReaders)
+        __atomic_fetch_add(&dev->stats.namespace_lock_waits, 1, __ATOMIC_RELAXED);
+    while (dev->nsReaders)
+        OSWaitCond(dev->nsCond, dev->nsMutex);
+}
+
+static void fs_dev_ns_unlock(fs_dev_private_t *dev, int exclusive) {
+    if (dev->readOnly)
+        return;
+
+    if (!exclusive) {
+        OSLockMutex(dev->nsMutex);
+        if (--dev->nsReaders == 0)
+            OSSignalCond(dev->nsCond);
+    }
+    OSUnlockMutex(dev->nsMutex);
+}
+
+//! GetStat through the stat cache of the mount, missing paths are remembered if the mount caches them
+static int fs_dev_get_stat(fs_dev_private_t *dev, const char *real_path, uint32_t real_len, FSStat *stats) {
+    uint32_t generation = 0;
+    if (dev->statCache) {
+        fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+        int cached = iosuhax_stat_cache_lookup(dev->statCache, real_path, real_len, stats);
+        generation = dev->statGeneration;
+        OSUnlockMutex(dev->pMutex);
+        if (cached > 0)
+            return 0;
+        if (cached < 0)
+            return FS_ERROR_NOT_FOUND;
+    }
+
+    int result = IOSUHAX_FSA_GetStat(dev->fsaFd, real_path, stats);
+
+    // a file written meanwhile may have been stat'ed before or after the write, don't keep either
+    if (dev->statCache) {
+        fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+        if (dev->statGeneration == generation) {
+            if (result == 0)
+                iosuhax_stat_cache_insert(dev->statCache, real_path, real_len, stats);
+            else if (dev->statCacheNegative && (result == FS_ERROR_NOT_FOUND || result == FS_STATUS_NOT_FOUND))
+                iosuhax_stat_cache_insert(dev->statCache, real_path, real_len, NULL);
+        }
+        OSUnlockMutex(dev->pMutex);
+    }
+
+    return result;
+}
+
+static size_t fs_dev_io_chunk_size(const void *ptr, size_t len) {
+    if (len < FS_DEV_DIRECT_IO_MIN)
+        return len;
+
+    // Transfer the unaligned head first, afterwards the buffer is aligned for the direct path
+    size_t misalign = ((uintptr_t) ptr) & 0x3F;
+    if (misalign)
+        return 0x40 - misalign;
+
+    return len & ~0x3F;
+}
+
+//! Moves the FSA file handle to the current position before data is transferred.
+static int fs_dev_sync_pos(fs_dev_file_state_t *file) {
+    if (file->fsaPos == file->pos)
+        return 0;
+
+    int result = IOSUHAX_FSA_SetFilePos64(file->channel->fsaFd, file->fd, file->pos);
+    if (result < 0)
+        return result;
+
+    file->fsaPos = file->pos;
+    return 0;
+}
+
+//! Copies what the read-ahead buffer holds at the current position, returns the number of bytes copied.
+static size_t fs_dev_read_ahead_copy(fs_dev_file_state_t *file, char *ptr, size_t len) {
+    if (file->pos < file->raStart || file->pos >= file->raStart + file->raLen)
+        return 0;
+
+    size_t size = (size_t) (file->raStart + file->raLen - file->pos);
+    if (size > len)
+        size = len;
+
+    memcpy(ptr, file->raBuffer + (file->pos - file->raStart), size);
+    file->pos += size;
+    return size;
+}
+
+//! Refills the read-ahead buffer at the current position, returns the number of bytes read.
+static int fs_dev_read_ahead_fill(fs_dev_file_state_t *file) {
+    fs_dev_private_t *dev = file->dev;
+
+    if (!file->raBuffer) {
+        file->raBuffer = (uint8_t *) memalign(0x40, dev->readAheadSize);
+        if (!file->raBuffer)
+            return -2;
+    }
+
+    // grow the window while the file is read sequentially, start over after a seek
+    uint32_t window = FS_DEV_READ_AHEAD_MIN;
+    if (file->pos == file->raNext && file->raWindow >= FS_DEV_READ_AHEAD_MIN)
+        window = file->raWindow << 1;
+    if (window > dev->readAheadSize)
+        window = dev->readAheadSize;
+    file->raWindow = window;
+
+    file->raLen = 0;
+
+    int result = fs_dev_sync_pos(file);
+    if (result < 0)
+        return result;
+
+    result = IOSUHAX_FSA_ReadFile(file->channel->fsaFd, file->raBuffer, 0x01, window, file->fd, 0);
+    if (result < 0)
+        return result;
+
+    file->raStart = file->pos;
+    file->raLen   = result;
+    file->fsaPos  = file->pos + result;
+    return result;
+}
+
+//! Drops what the caches hold about a file that is written, the device mutex has to be held. Writers call it
+//! once the data is written. Pages and stat results other threads fetch during the write are not kept either,
+//! the bumped generations make them fail to commit.
+static void fs_dev_invalidate_file(fs_dev_private_t *dev, uint32_t entryId) {
+    __atomic_fetch_add(&dev->statGeneration, 1, __ATOMIC_RELEASE);
+
+    // writers on a mount with caches fetch the entry id first, see fs_dev_write_r
+    if (entryId == 0)
+        return;
+
+    if (dev->pageCache)
+        iosuhax_page_cache_invalidate(dev->pageCache, entryId);
+    if (dev->statCache)
+        iosuhax_stat_cache_invalidate_entry(dev->statCache, entryId);
+}
+
+//! Writes the collected data to the file. The data is dropped even if writing fails, the error is
+//! reported to the call that triggered the flush.
+static int fs_dev_write_back_flush(fs_dev_file_state_t *file) {
+    if (file->wbLen == 0)
+        return 0;
+
+    fs_dev_private_t *dev = file->dev;
+    uint32_t size         = file->wbLen;
+    uint32_t done         = 0;
+    int result            = 0;
+    file->wbLen           = 0;
+
+    if (file->fsaPos != file->wbStart) {
+        result = IOSUHAX_FSA_SetFilePos64(file->channel->fsaFd, file->fd, file->wbStart);
+        if (result == 0)
+            file->fsaPos = file->wbStart;
+    }
+
+    while (result == 0 && done < size) {
+        int written = IOSUHAX_FSA_WriteFile(file->channel->fsaFd, file->wbBuffer + done, 0x01, size - done, file->fd, 0);
+        if (written < 0) {
+            result = written;
+        } else if (written == 0) {
+            result = FS_STATUS_STORAGE_FULL;
+        } else {
+            done += written;
+            file->fsaPos += written;
+        }
+    }
+
+    fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+    dev->stats.write_back_flushes++;
+    fs_dev_invalidate_file(dev, file->entryId);
+    OSUnlockMutex(dev->pMutex);
+
+    return result < 0 ? result : 0;
+}
+
+//! Returns the length of the file in 'len'. Files opened without OPENFILE_STAT get it, and their entry id,
+//! from a StatFile the first time it is needed. The file mutex has to be held.
+static int fs_dev_file_len(fs_dev_file_state_t *file, uint64_t *len) {
+    if (!file->lenValid) {
+        // the size reported by FSA has to include the buffered data
+        int result = fs_dev_write_back_flush(file);
+        if (result == 0)
+            result = IOSUHAX_FSA_StatFile(file->channel->fsaFd, file->fd, &file->stat);
+        if (result != 0)
+            return result;
+
+        // an IOSU without OPENFILE_STAT has no files beyond the 32 bit size of FSStat
+        file->entryId   = file->stat.entryId;
+        file->len       = file->stat.size;
+        file->lenValid  = true;
+        file->statValid = true;
+    }
+
+    *len = file->len;
+    return 0;
+}
+
+//! Reads from the current position through the page cache of the mount, returns the number of bytes read.
+//! The device mutex is taken for the cache only, a missing page is filled while it is reserved and committed
+//! afterwards. The commit drops it if the file was written meanwhile.
+static int fs_dev_read_cached(fs_dev_file_state_t *file, char *ptr, size_t len) {
+    fs_dev_private_t *dev = file->dev;
+
+    fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+
+    if (!dev->pageCache) {
+        dev->pageCache = iosuhax_page_cache_create(dev->pageCacheSize);
+        if (!dev->pageCache) {
+            OSUnlockMutex(dev->pMutex);
+            return -2;
+        }
+    }
+
+    size_t done = 0;
+
+    while (done < len) {
+        uint32_t index  = (uint32_t) (file->pos / IOSUHAX_PAGE_SIZE);
+        uint32_t offset = (uint32_t) (file->pos % IOSUHAX_PAGE_SIZE);
+
+        const uint8_t *data;
+        uint32_t pageLen;
+        iosuhax_page_t *reserved = NULL;
+
+        iosuhax_page_t *page = iosuhax_page_cache_lookup(dev->pageCache, file->entryId, index);
+        if (page) {
+            data    = page->data;
+            pageLen = page->len;
+        } else {
+            reserved = iosuhax_page_cache_reserve(dev->pageCache, file->entryId, index);
+            OSUnlockMutex(dev->pMutex);
+
+            // every page is being filled by other threads, the rest is read around the cache
+            if (!reserved) {
+                int result = fs_dev_sync_pos(file);
+                if (result == 0)
+                    result = IOSUHAX_FSA_ReadFile(file->channel->fsaFd, ptr + done, 0x01, len - done, file->fd, 0);
+                if (result < 0)
+                    return done ? (int) done : result;
+
+                done += result;
+                file->pos += result;
+                file->fsaPos = file->pos;
+                return done;
+            }
+
+            uint64_t start = (uint64_t) index * IOSUHAX_PAGE_SIZE;
+            int result     = 0;
+            if (file->fsaPos != start) {
+                result = IOSUHAX_FSA_SetFilePos64(file->channel->fsaFd, file->fd, start);
+                if (result == 0)
+                    file->fsaPos = start;
+            }
+            if (result == 0)
+                result = IOSUHAX_FSA_ReadFile(file->channel->fsaFd, reserved->data, 0x01, IOSUHAX_PAGE_SIZE, file->fd, 0);
+
+            fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+
+            if (result <= 0) {
+                iosuhax_page_cache_commit(dev->pageCache, reserved, 0);
+                if (result < 0 && done == 0) {
+                    OSUnlockMutex(dev->pMutex);
+                    return result;
+                }
+                break;
+            }
+
+            file->fsaPos = start + result;
+            data         = reserved->data;
+            pageLen      = result;
+        }
+
+        // the page can only be replaced once it is committed and the mutex is released
+        if (offset < pageLen) {
+            size_t size = pageLen - offset;
+            if (size > len - done)
+                size = len - done;
+
+            memcpy(ptr + done, data + offset, size);
+            done += size;
+            file->pos += size;
+        }
+
+        if (reserved)
+            iosuhax_page_cache_commit(dev->pageCache, reserved, pageLen);
+
+        // a partial page is the end of the file
+        if (pageLen < IOSUHAX_PAGE_SIZE)
+            break;
+    }
+
+    OSUnlockMutex(dev->pMutex);
+    return done;
+}
+
+typedef struct _fs_dev_stream_chunk_t {
+    char *data;    // caller's buffer
+    char *staging; // NULL if the caller's buffer is passed to IOSU directly
+    size_t size;
+    int completed; // set when the request's completion was taken from the queue
+    int result;
+} fs_dev_stream_chunk_t;
+
+static int fs_dev_stream_locked(fs_dev_file_state_t *file, fs_dev_channel_t *channel, char *ptr, size_t len, int isWrite) {
+    if (!channel->ioQueue) {
+        channel->ioQueue = IOSUHAX_CreateAsyncQueue(FS_DEV_STREAM_DEPTH);
+        if (!channel->ioQueue)
+            return -2;
+    }
+
+    // Until async file requests are sent vectored, the async layer copies every chunk through a pool buffer.
+    // Unaligned chunks are then handed over as they are instead of being copied twice.
+    int vectored = iosuhaxFileIoctlvConfirmed && iosuhaxFileIoctlvSupported;
+    if (vectored && !channel->ioStaging) {
+        channel->ioStaging = (char *) memalign(0x40, FS_DEV_STREAM_CHUNK * FS_DEV_STREAM_DEPTH);
+        if (!channel->ioStaging)
+            return -2;
+    }
+
+    // The chunks carry no file position, each one continues where the one before ended. The async queue sends
+    // them in order on one handle, which IOSU serves in order, see IOSUHAX_AsyncQueue.
+    // chunk n lives in slot n % FS_DEV_STREAM_DEPTH together with its part of the staging buffer
+    fs_dev_stream_chunk_t chunks[FS_DEV_STREAM_DEPTH];
+    uint32_t next     = 0;
+    uint32_t retired  = 0;
+    uint32_t inFlight = 0;
+    size_t issued     = 0;
+    size_t done       = 0;
+    int error         = 0;
+    int stop          = 0;
+
+    while (1) {
+        // completions may arrive in any order, results are taken in submission order so that a
+        // short or failed request ends the transfer at the right spot
+        while (retired != next && chunks[retired % FS_DEV_STREAM_DEPTH].completed) {
+            fs_dev_stream_chunk_t *chunk = &chunks[retired % FS_DEV_STREAM_DEPTH];
+            retired++;
+
+            // anything behind a failed or short request is not part of the result
+            if (stop)
+                continue;
+
+            if (chunk->result < 0) {
+                error = chunk->result;
+                stop  = 1;
+                continue;
+            }
+
+            if (!isWrite && chunk->staging)
+                memcpy(chunk->data, chunk->staging, chunk->result);
+
+            done += chunk->result;
+            if ((size_t) chunk->result < chunk->size)
+                stop = 1;
+        }
+
+        // a slot and its staging area are reused only after its previous request completed and was retired
+        while (!stop && next - retired < FS_DEV_STREAM_DEPTH && issued < len) {
+            size_t size = fs_dev_io_chunk_size(ptr + issued, len - issued);
+            if (size > FS_DEV_STREAM_CHUNK)
+                size = FS_DEV_STREAM_CHUNK;
+
+            uint32_t slot                = next % FS_DEV_STREAM_DEPTH;
+            fs_dev_stream_chunk_t *chunk = &chunks[slot];
+            chunk->data                  = ptr + issued;
+            chunk->size                  = size;
+            chunk->staging               = NULL;
+            chunk->completed             = 0;
+            if (vectored && ((((uintptr_t) chunk->data) & 0x3F) || (size & 0x3F)))
+                chunk->staging = channel->ioStaging + slot * FS_DEV_STREAM_CHUNK;
+
+            char *buf = chunk->staging ? chunk->staging : chunk->data;
+
+            int res;
+            if (isWrite) {
+                if (chunk->staging)
+                    memcpy(chunk->staging, chunk->data, size);
+                res = IOSUHAX_FSA_WriteFileAsync(channel->ioQueue, channel->fsaFd, buf, 0x01, size, file->fd, 0, chunk);
+            } else {
+                res = IOSUHAX_FSA_ReadFileAsync(channel->ioQueue, channel->fsaFd, buf, 0x01, size, file->fd, 0, chunk);
+            }
+
+            if (res < 0) {
+                error = res;
+                stop  = 1;
+                break;
+            }
+
+            issued += size;
+            inFlight++;
+            next++;
+        }
+
+        IOSUHAX_AsyncResult result;
+        if (inFlight == 0 || !IOSUHAX_WaitAsyncQueue(channel->ioQueue, &result))
+            break;
+        inFlight--;
+
+        fs_dev_stream_chunk_t *chunk = (fs_dev_stream_chunk_t *) result.cookie;
+        chunk->result                = result.result;
+        chunk->completed             = 1;
     }
 
+    // requests behind a failed or short one may have moved the FSA position
+    if (stop && issued > done)
+        IOSUHAX_FSA_SetFilePos64(channel->fsaFd, file->fd, file->pos + done);
+
+    file->pos += done;
+
+    if (done == 0 && error < 0)
+        return error;
+    return done;
+}
+
+//! Reads or writes len bytes at the current position with FS_DEV_STREAM_DEPTH requests in flight.
+//! IOSU starts the requests of a handle in submission order, each one continues where the one before ended.
+//! Peak memory stays at the staging buffer of the file's channel no matter how large the transfer is.
+//! Returns the number of bytes transferred or the first error. The channel is locked for the whole
+//! transfer since its queue and staging buffer are shared by all of its files.
+static int fs_dev_stream(fs_dev_file_state_t *file, char *ptr, size_t len, int isWrite) {
+    fs_dev_channel_t *channel = file->channel;
+
+    fs_dev_lock(channel->pMutex, &file->dev->stats.file_lock_waits);
+    int result = fs_dev_stream_locked(file, channel, ptr, len, isWrite);
+    OSUnlockMutex(channel->pMutex);
+    return result;
+}
+
+static int fs_dev_open(struct _reent *r, fs_dev_private_t *dev, void *fileStruct, const char *path, int flags, int mode) {
     fs_dev_file_state_t *file = (fs_dev_file_state_t *) fileStruct;
 
     file->dev = dev;
@@ -236,42 +811,118 @@ static int fs_dev_open_r(struct _reent *r, void *fileStruct, const char *path, i
     }
 
 
-    int fd = -1;
-
-    OSLockMutex(dev->pMutex);
+    if (dev->readOnly && file->write) {
+        r->_errno = EROFS;
+        return -1;
+    }
 
-    char *real_path = fs_dev_real_path(path, dev);
-    if (!path) {
+    file->pMutex = malloc(OS_MUTEX_SIZE);
+    if (!file->pMutex) {
         r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
         return -1;
     }
 
-    int result = IOSUHAX_FSA_OpenFile(dev->fsaFd, real_path, fsMode, &fd);
+    OSInitMutex(file->pMutex);
 
-    free(real_path);
+    int fd = -1;
 
-    if (result == 0) {
-        FSStat stats;
-        result = IOSUHAX_FSA_StatFile(dev->fsaFd, fd, &stats);
-        if (result != 0) {
-            IOSUHAX_FSA_CloseFile(dev->fsaFd, fd);
-            r->_errno = fs_dev_translate_error(result);
-            OSUnlockMutex(dev->pMutex);
-            return -1;
+    // new files go to the channel with the fewest open files, a stale count only makes the choice less even
+    fs_dev_channel_t *channel = &dev->channels[0];
+    for (uint32_t i = 1; i < dev->channelCount; i++) {
+        if (dev->channels[i].openFiles < channel->openFiles)
+            channel = &dev->channels[i];
+    }
+
+    // opening for writing may create the file
+    int exclusive = file->write;
+
+    fs_dev_ns_lock(dev, exclusive);
+
+    char real_path[FS_DEV_PATH_MAX];
+    int real_len = fs_dev_real_path(real_path, path, dev);
+    if (real_len < 0) {
+        fs_dev_ns_unlock(dev, exclusive);
+        free(file->pMutex);
+        r->_errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    // the length is needed for SEEK_END and reads, the stat is kept for fstat
+    FSStat stats;
+    uint64_t size  = 0;
+    bool lenValid  = true;
+    bool statValid = true;
+    int result;
+    if (iosuhaxOpenFileStatSupported) {
+        result = IOSUHAX_FSA_OpenFileStat(channel->fsaFd, real_path, fsMode, &fd, &stats, &size);
+    } else {
+        // without OPENFILE_STAT a stat costs a request of its own, it is put off until the length is needed.
+        // A truncated file is known to be empty, its entry id is only needed to invalidate the caches.
+        memset(&stats, 0, sizeof(FSStat));
+        result    = IOSUHAX_FSA_OpenFile(channel->fsaFd, real_path, fsMode, &fd);
+        lenValid  = (flags & O_TRUNC) != 0;
+        statValid = false;
+        if (result == 0 && lenValid && (dev->pageCacheSize || dev->statCache)) {
+            result = IOSUHAX_FSA_StatFile(channel->fsaFd, fd, &stats);
+            if (result != 0)
+                IOSUHAX_FSA_CloseFile(channel->fsaFd, fd);
+            statValid = true;
         }
-        file->fd  = fd;
-        file->pos = 0;
-        file->len = stats.size;
-        OSUnlockMutex(dev->pMutex);
-        return (int) file;
     }
 
-    r->_errno = fs_dev_translate_error(result);
+    fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+
+    // opening for writing may create or truncate the file
+    if (dev->statCache && file->write)
+        iosuhax_stat_cache_invalidate(dev->statCache, real_path, real_len);
+
+    // opening with "w" truncates the file
+    if (result == 0 && dev->pageCache && (flags & O_TRUNC) && stats.entryId)
+        iosuhax_page_cache_invalidate(dev->pageCache, stats.entryId);
+
     OSUnlockMutex(dev->pMutex);
-    return -1;
+
+    fs_dev_ns_unlock(dev, exclusive);
+
+    if (result != 0) {
+        free(file->pMutex);
+        r->_errno = fs_dev_translate_error(result);
+        return -1;
+    }
+
+    __atomic_fetch_add(&channel->openFiles, 1, __ATOMIC_RELAXED);
+
+    file->channel  = channel;
+    file->fd       = fd;
+    file->entryId  = stats.entryId;
+    file->pos      = 0;
+    file->len      = size;
+    file->lenValid = lenValid;
+    file->fsaPos   = 0;
+    file->raBuffer = NULL;
+    file->raStart  = 0;
+    file->raLen    = 0;
+    file->raWindow = 0;
+    file->raNext   = 0;
+    file->wbBuffer = NULL;
+    file->wbStart  = 0;
+    file->wbLen    = 0;
+    memcpy(&file->stat, &stats, sizeof(FSStat));
+    file->statValid = statValid;
+    return (int) file;
 }
 
+static int fs_dev_open_r(struct _reent *r, void *fileStruct, const char *path, int flags, int mode) {
+    fs_dev_private_t *dev = fs_dev_get_device_data(path);
+    if (!dev) {
+        r->_errno = ENODEV;
+        return -1;
+    }
+
+    int result = fs_dev_open(r, dev, fileStruct, path, flags, mode);
+    fs_dev_put_device_data(dev);
+    return result;
+}
 
 static int fs_dev_close_r(struct _reent *r, void *fd) {
     fs_dev_file_state_t *file = (fs_dev_file_state_t *) fd;
@@ -280,11 +931,28 @@ static int fs_dev_close_r(struct _reent *r, void *fd) {
         return -1;
     }
 
-    OSLockMutex(file->dev->pMutex);
+    fs_dev_lock(file->pMutex, &file->dev->stats.file_lock_waits);
+
+    int flushResult = fs_dev_write_back_flush(file);
+
+    int result = IOSUHAX_FSA_CloseFile(file->channel->fsaFd, file->fd);
+    if (flushResult < 0)
+        result = flushResult;
+
+    __atomic_fetch_sub(&file->channel->openFiles, 1, __ATOMIC_RELAXED);
 
-    int result = IOSUHAX_FSA_CloseFile(file->dev->fsaFd, file->fd);
+    if (file->raBuffer) {
+        free(file->raBuffer);
+        file->raBuffer = NULL;
+    }
+    if (file->wbBuffer) {
+        free(file->wbBuffer);
+        file->wbBuffer = NULL;
+    }
 
-    OSUnlockMutex(file->dev->pMutex);
+    OSUnlockMutex(file->pMutex);
+    free(file->pMutex);
+    file->pMutex = NULL;
 
     if (result < 0) {
         r->_errno = fs_dev_translate_error(result);
@@ -293,39 +961,50 @@ static int fs_dev_close_r(struct _reent *r, void *fd) {
     return 0;
 }
 
+//! Only moves file->pos, the FSA handle follows with the next transfer that needs it (fs_dev_sync_pos).
 static off_t fs_dev_seek_r(struct _reent *r, void *fd, off_t pos, int dir) {
     fs_dev_file_state_t *file = (fs_dev_file_state_t *) fd;
     if (!file->dev) {
         r->_errno = ENODEV;
-        return 0;
+        return -1;
     }
 
-    OSLockMutex(file->dev->pMutex);
+    fs_dev_lock(file->pMutex, &file->dev->stats.file_lock_waits);
 
+    off_t newPos;
     switch (dir) {
         case SEEK_SET:
-            file->pos = pos;
+            newPos = pos;
             break;
         case SEEK_CUR:
-            file->pos += pos;
+            newPos = (off_t) file->pos + pos;
             break;
-        case SEEK_END:
-            file->pos = file->len + pos;
+        case SEEK_END: {
+            uint64_t len;
+            int result = fs_dev_file_len(file, &len);
+            if (result != 0) {
+                r->_errno = fs_dev_translate_error(result);
+                OSUnlockMutex(file->pMutex);
+                return -1;
+            }
+            newPos = (off_t) len + pos;
             break;
+        }
         default:
-            r->_errno = EINVAL;
-            return -1;
+            newPos = -1;
+            break;
     }
 
-    int result = IOSUHAX_FSA_SetFilePos(file->dev->fsaFd, file->fd, file->pos);
-
-    OSUnlockMutex(file->dev->pMutex);
-
-    if (result == 0) {
-        return file->pos;
+    if (newPos < 0) {
+        r->_errno = EINVAL;
+        OSUnlockMutex(file->pMutex);
+        return -1;
     }
 
-    return result;
+    file->pos = newPos;
+
+    OSUnlockMutex(file->pMutex);
+    return newPos;
 }
 
 static ssize_t fs_dev_write_r(struct _reent *r, void *fd, const char *ptr, size_t len) {
@@ -340,14 +1019,86 @@ static ssize_t fs_dev_write_r(struct _reent *r, void *fd, const char *ptr, size_
         return 0;
     }
 
-    OSLockMutex(file->dev->pMutex);
+    fs_dev_lock(file->pMutex, &file->dev->stats.file_lock_waits);
 
     size_t done = 0;
 
+    fs_dev_private_t *dev = file->dev;
+
+    // the caches of the mount are invalidated by entry id
+    if (!file->lenValid && (dev->pageCacheSize || dev->statCache)) {
+        uint64_t fileLen;
+        int result = fs_dev_file_len(file, &fileLen);
+        if (result != 0) {
+            r->_errno = fs_dev_translate_error(result);
+            OSUnlockMutex(file->pMutex);
+            return 0;
+        }
+    }
+
+    // the written range may be part of the read-ahead data, and the modification time changes
+    file->raLen     = 0;
+    file->statValid = false;
+
+    // small writes are collected as long as they continue the buffered data
+    if (len < dev->writeBackSize) {
+        int result = 0;
+        if (file->wbLen && (file->pos != file->wbStart + file->wbLen || file->wbLen + len > dev->writeBackSize))
+            result = fs_dev_write_back_flush(file);
+
+        if (result == 0 && !file->wbBuffer) {
+            file->wbBuffer = (uint8_t *) memalign(0x40, dev->writeBackSize);
+            if (!file->wbBuffer)
+                result = -2;
+        }
+
+        if (result < 0) {
+            r->_errno = (result == -2) ? ENOMEM : fs_dev_translate_error(result);
+            OSUnlockMutex(file->pMutex);
+            return 0;
+        }
+
+        if (file->wbLen == 0)
+            file->wbStart = file->pos;
+
+        memcpy(file->wbBuffer + file->wbLen, ptr, len);
+        file->wbLen += len;
+        file->pos += len;
+        if (file->pos > file->len)
+            file->len = file->pos;
+
+        fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+        dev->stats.write_back_writes++;
+        OSUnlockMutex(dev->pMutex);
+
+        OSUnlockMutex(file->pMutex);
+        return len;
+    }
+
+    int result = fs_dev_write_back_flush(file);
+    if (result == 0)
+        result = fs_dev_sync_pos(file);
+
+    if (result < 0) {
+        r->_errno = fs_dev_translate_error(result);
+        OSUnlockMutex(file->pMutex);
+        return 0;
+    }
+
+    if (len > FS_DEV_STREAM_CHUNK) {
+        int result = fs_dev_stream(file, (char *) ptr, len, 1);
+        if (result < 0) {
+            r->_errno = fs_dev_translate_error(result);
+        } else {
+            done = result;
+        }
+        len = done; // a short or failed stream is not retried below
+    }
+
     while (done < len) {
-        size_t write_size = len - done;
+        size_t write_size = fs_dev_io_chunk_size(ptr + done, len - done);
 
-        int result = IOSUHAX_FSA_WriteFile(file->dev->fsaFd, ptr + done, 0x01, write_size, file->fd, 0);
+        int result = IOSUHAX_FSA_WriteFile(file->channel->fsaFd, ptr + done, 0x01, write_size, file->fd, 0);
         if (result < 0) {
             r->_errno = fs_dev_translate_error(result);
             break;
@@ -361,7 +1112,15 @@ static ssize_t fs_dev_write_r(struct _reent *r, void *fd, const char *ptr, size_
         }
     }
 
-    OSUnlockMutex(file->dev->pMutex);
+    if (file->pos > file->len)
+        file->len = file->pos;
+    file->fsaPos = file->pos;
+
+    fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+    fs_dev_invalidate_file(dev, file->entryId);
+    OSUnlockMutex(dev->pMutex);
+
+    OSUnlockMutex(file->pMutex);
     return done;
 }
 
@@ -377,14 +1136,98 @@ static ssize_t fs_dev_read_r(struct _reent *r, void *fd, char *ptr, size_t len)
         return 0;
     }
 
-    OSLockMutex(file->dev->pMutex);
+    fs_dev_lock(file->pMutex, &file->dev->stats.file_lock_waits);
+
+    fs_dev_private_t *dev = file->dev;
+
+    int flushResult = fs_dev_write_back_flush(file);
+    if (flushResult < 0) {
+        r->_errno = fs_dev_translate_error(flushResult);
+        OSUnlockMutex(file->pMutex);
+        return 0;
+    }
+
+    // pages are cached by entry id, a file opened without it fetches it once
+    uint64_t fileLen;
+    if (dev->pageCacheSize && len <= dev->pageCacheSize / 4 && !file->lenValid)
+        fs_dev_file_len(file, &fileLen);
+
+    // with a page cache, reads up to a quarter of its size go through it instead of the read-ahead buffer
+    if (dev->pageCacheSize && file->entryId && len <= dev->pageCacheSize / 4) {
+        int result = fs_dev_read_cached(file, ptr, len);
+        if (result < 0) {
+            r->_errno = (result == -2) ? ENOMEM : fs_dev_translate_error(result);
+            result    = 0;
+        }
+
+        OSUnlockMutex(file->pMutex);
+        return result;
+    }
+
+    size_t done = fs_dev_read_ahead_copy(file, ptr, len);
+    if (done == len) {
+        fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+        dev->stats.read_ahead_hits++;
+        OSUnlockMutex(dev->pMutex);
+        file->raNext = file->pos;
+        OSUnlockMutex(file->pMutex);
+        return done;
+    }
+
+    // small reads are served from a refilled read-ahead buffer, larger ones go to the caller's buffer directly
+    if (len - done < dev->readAheadSize) {
+        fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+        dev->stats.read_ahead_misses++;
+        OSUnlockMutex(dev->pMutex);
+
+        int result = fs_dev_read_ahead_fill(file);
+        if (result < 0) {
+            r->_errno = fs_dev_translate_error(result);
+        } else {
+            done += fs_dev_read_ahead_copy(file, ptr + done, len - done);
+        }
+
+        file->raNext = file->pos;
+        OSUnlockMutex(file->pMutex);
+        return done;
+    }
+
+    int result = fs_dev_sync_pos(file);
+    if (result < 0) {
+        r->_errno = fs_dev_translate_error(result);
+        OSUnlockMutex(file->pMutex);
+        return done;
+    }
+
+    size_t buffered = done;
+    ptr += buffered;
+    len -= buffered;
+    done = 0;
+
+    // only stream what is known to exist, a short read in the middle of the pipeline just costs a seek
+    uint64_t remaining = 0;
+    if (len > FS_DEV_STREAM_CHUNK && fs_dev_file_len(file, &fileLen) == 0 && file->pos < fileLen)
+        remaining = fileLen - file->pos;
+    size_t expected = (remaining < len) ? (size_t) remaining : len;
+
+    if (expected > FS_DEV_STREAM_CHUNK) {
+        int result = fs_dev_stream(file, ptr, expected, 0);
+        if (result < 0) {
+            r->_errno = fs_dev_translate_error(result);
+            file->fsaPos = file->pos;
+            OSUnlockMutex(file->pMutex);
+            return buffered;
+        }
 
-    size_t done = 0;
+        done = result;
+        if (done < expected)
+            len = done;
+    }
 
     while (done < len) {
-        size_t read_size = len - done;
+        size_t read_size = fs_dev_io_chunk_size(ptr + done, len - done);
 
-        int result = IOSUHAX_FSA_ReadFile(file->dev->fsaFd, ptr + done, 0x01, read_size, file->fd, 0);
+        int result = IOSUHAX_FSA_ReadFile(file->channel->fsaFd, ptr + done, 0x01, read_size, file->fd, 0);
         if (result < 0) {
             r->_errno = fs_dev_translate_error(result);
             done      = 0;
@@ -398,8 +1241,11 @@ static ssize_t fs_dev_read_r(struct _reent *r, void *fd, char *ptr, size_t len)
         }
     }
 
-    OSUnlockMutex(file->dev->pMutex);
-    return done;
+    file->fsaPos = file->pos;
+    file->raNext = file->pos;
+
+    OSUnlockMutex(file->pMutex);
+    return buffered + done;
 }
 
 
@@ -410,19 +1256,37 @@ static int fs_dev_fstat_r(struct _reent *r, void *fd, struct stat *st) {
         return -1;
     }
 
-    OSLockMutex(file->dev->pMutex);
+    fs_dev_lock(file->pMutex, &file->dev->stats.file_lock_waits);
 
     // Zero out the stat buffer
     memset(st, 0, sizeof(struct stat));
 
-    FSStat stats;
-    int result = IOSUHAX_FSA_StatFile(file->dev->fsaFd, (int) fd, &stats);
-    if (result != 0) {
-        r->_errno = fs_dev_translate_error(result);
-        OSUnlockMutex(file->dev->pMutex);
+    // fetching the length of a file opened without OPENFILE_STAT stats it as well
+    uint64_t fileLen;
+    int lenResult = fs_dev_file_len(file, &fileLen);
+    if (lenResult != 0) {
+        r->_errno = fs_dev_translate_error(lenResult);
+        OSUnlockMutex(file->pMutex);
         return -1;
     }
 
+    // files that were not written since the last stat are answered from the file state
+    if (!file->statValid) {
+        // the modification time reported by FSA has to include the buffered data
+        int result = fs_dev_write_back_flush(file);
+        if (result == 0)
+            result = IOSUHAX_FSA_StatFile(file->channel->fsaFd, file->fd, &file->stat);
+        if (result != 0) {
+            r->_errno = fs_dev_translate_error(result);
+            OSUnlockMutex(file->pMutex);
+            return -1;
+        }
+
+        file->statValid = true;
+    }
+
+    FSStat stats = file->stat;
+
     // Convert fields to posix stat
     st->st_dev     = (dev_t) file->dev;
     st->st_ino     = stats.entryId;
@@ -431,49 +1295,64 @@ static int fs_dev_fstat_r(struct _reent *r, void *fd, struct stat *st) {
     st->st_uid     = stats.owner;
     st->st_gid     = stats.group;
     st->st_rdev    = st->st_dev;
-    st->st_size    = stats.size;
+    st->st_size    = fileLen;
     st->st_blksize = 512;
     st->st_blocks  = (st->st_size + st->st_blksize - 1) / st->st_blksize;
     st->st_atime   = fs_dev_translate_time(stats.modified);
     st->st_ctime   = fs_dev_translate_time(stats.created);
     st->st_mtime   = fs_dev_translate_time(stats.modified);
-    OSUnlockMutex(file->dev->pMutex);
+    OSUnlockMutex(file->pMutex);
     return 0;
 }
 
-static int fs_dev_stat_r(struct _reent *r, const char *path, struct stat *st) {
-    fs_dev_private_t *dev = fs_dev_get_device_data(path);
-    if (!dev) {
+static int fs_dev_fsync_r(struct _reent *r, void *fd) {
+    fs_dev_file_state_t *file = (fs_dev_file_state_t *) fd;
+    if (!file->dev) {
         r->_errno = ENODEV;
         return -1;
     }
 
-    OSLockMutex(dev->pMutex);
+    fs_dev_lock(file->pMutex, &file->dev->stats.file_lock_waits);
+
+    // FSA has no per-file flush, handing the data to FSA is all that can be done here
+    int result = fs_dev_write_back_flush(file);
+
+    OSUnlockMutex(file->pMutex);
+
+    if (result < 0) {
+        r->_errno = fs_dev_translate_error(result);
+        return -1;
+    }
+    return 0;
+}
+
+static int fs_dev_stat(struct _reent *r, fs_dev_private_t *dev, const char *path, struct stat *st) {
+    fs_dev_ns_lock(dev, 0);
 
     // Zero out the stat buffer
     memset(st, 0, sizeof(struct stat));
 
-    char *real_path = fs_dev_real_path(path, dev);
-    if (!real_path) {
-        r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
+    char real_path[FS_DEV_PATH_MAX];
+    int real_len = fs_dev_real_path(real_path, path, dev);
+    if (real_len < 0) {
+        r->_errno = ENAMETOOLONG;
+        fs_dev_ns_unlock(dev, 0);
         return -1;
     }
 
     FSStat stats;
-    int result = IOSUHAX_FSA_GetStat(dev->fsaFd, real_path, &stats);
+    int result = fs_dev_get_stat(dev, real_path, real_len, &stats);
 
     if (result < 0) {
-        free(real_path);
         r->_errno = fs_dev_translate_error(result);
-        OSUnlockMutex(dev->pMutex);
+        fs_dev_ns_unlock(dev, 0);
         return -1;
     }
 
     // Convert fields to posix stat
     st->st_dev     = (dev_t) dev;
     st->st_ino     = stats.entryId;
-    st->st_mode    = fs_dev_translate_stat_mode(stats, (strlen(dev->mount_path) + 1 == strlen(real_path)));
+    st->st_mode    = fs_dev_translate_stat_mode(stats, (dev->mountPathLen + 1 == (uint32_t) real_len));
     st->st_nlink   = 1;
     st->st_uid     = stats.owner;
     st->st_gid     = stats.group;
@@ -485,44 +1364,48 @@ static int fs_dev_stat_r(struct _reent *r, const char *path, struct stat *st) {
     st->st_ctime   = fs_dev_translate_time(stats.created);
     st->st_mtime   = fs_dev_translate_time(stats.modified);
 
-    free(real_path);
-
-    OSUnlockMutex(dev->pMutex);
+    fs_dev_ns_unlock(dev, 0);
     return 0;
 }
 
-static int fs_dev_lstat_r(struct _reent *r, const char *path, struct stat *st) {
+static int fs_dev_stat_r(struct _reent *r, const char *path, struct stat *st) {
     fs_dev_private_t *dev = fs_dev_get_device_data(path);
     if (!dev) {
         r->_errno = ENODEV;
         return -1;
     }
 
-    OSLockMutex(dev->pMutex);
+    int result = fs_dev_stat(r, dev, path, st);
+    fs_dev_put_device_data(dev);
+    return result;
+}
+
+static int fs_dev_lstat(struct _reent *r, fs_dev_private_t *dev, const char *path, struct stat *st) {
+    fs_dev_ns_lock(dev, 0);
 
     // Zero out the stat buffer
     memset(st, 0, sizeof(struct stat));
 
-    char *real_path = fs_dev_real_path(path, dev);
-    if (!real_path) {
-        r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
+    char real_path[FS_DEV_PATH_MAX];
+    int real_len = fs_dev_real_path(real_path, path, dev);
+    if (real_len < 0) {
+        r->_errno = ENAMETOOLONG;
+        fs_dev_ns_unlock(dev, 0);
         return -1;
     }
 
     FSStat stats;
-    int result = IOSUHAX_FSA_GetStat(dev->fsaFd, real_path, &stats);
+    int result = fs_dev_get_stat(dev, real_path, real_len, &stats);
     if (result < 0) {
-        free(real_path);
         r->_errno = fs_dev_translate_error(result);
-        OSUnlockMutex(dev->pMutex);
+        fs_dev_ns_unlock(dev, 0);
         return -1;
     }
 
     // Convert fields to posix stat
     st->st_dev     = (dev_t) dev;
     st->st_ino     = stats.entryId;
-    st->st_mode    = fs_dev_translate_stat_mode(stats, (strlen(dev->mount_path) + 1 == strlen(real_path)));
+    st->st_mode    = fs_dev_translate_stat_mode(stats, (dev->mountPathLen + 1 == (uint32_t) real_len));
     st->st_nlink   = 1;
     st->st_uid     = stats.owner;
     st->st_gid     = stats.group;
@@ -534,39 +1417,58 @@ static int fs_dev_lstat_r(struct _reent *r, const char *path, struct stat *st) {
     st->st_ctime   = fs_dev_translate_time(stats.created);
     st->st_mtime   = fs_dev_translate_time(stats.modified);
 
-    free(real_path);
-
-    OSUnlockMutex(dev->pMutex);
+    fs_dev_ns_unlock(dev, 0);
     return 0;
 }
 
+static int fs_dev_lstat_r(struct _reent *r, const char *path, struct stat *st) {
+    fs_dev_private_t *dev = fs_dev_get_device_data(path);
+    if (!dev) {
+        r->_errno = ENODEV;
+        return -1;
+    }
+
+    int result = fs_dev_lstat(r, dev, path, st);
+    fs_dev_put_device_data(dev);
+    return result;
+}
+
 static int fs_dev_link_r(struct _reent *r, const char *existing, const char *newLink) {
     r->_errno = ENOTSUP;
     return -1;
 }
 
-static int fs_dev_unlink_r(struct _reent *r, const char *name) {
-    fs_dev_private_t *dev = fs_dev_get_device_data(name);
-    if (!dev) {
-        r->_errno = ENODEV;
+static int fs_dev_unlink(struct _reent *r, fs_dev_private_t *dev, const char *name) {
+    if (dev->readOnly) {
+        r->_errno = EROFS;
         return -1;
     }
 
-    OSLockMutex(dev->pMutex);
+    fs_dev_ns_lock(dev, 1);
 
-    char *real_path = fs_dev_real_path(name, dev);
-    if (!real_path) {
-        r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
+    char real_path[FS_DEV_PATH_MAX];
+    int real_len = fs_dev_real_path(real_path, name, dev);
+    if (real_len < 0) {
+        r->_errno = ENAMETOOLONG;
+        fs_dev_ns_unlock(dev, 1);
         return -1;
     }
 
-    int result = IOSUHAX_FSA_Remove(dev->fsaFd, real_path);
+    // cached pages of the file must not show up for a new file that reuses its entry id
+    FSStat stats;
+    int cached = dev->pageCache && IOSUHAX_FSA_GetStat(dev->fsaFd, real_path, &stats) == 0;
 
-    free(real_path);
+    int result = IOSUHAX_FSA_Remove(dev->fsaFd, real_path);
 
+    fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+    if (cached && result == 0)
+        iosuhax_page_cache_invalidate(dev->pageCache, stats.entryId);
+    if (dev->statCache)
+        iosuhax_stat_cache_invalidate(dev->statCache, real_path, real_len);
     OSUnlockMutex(dev->pMutex);
 
+    fs_dev_ns_unlock(dev, 1);
+
     if (result < 0) {
         r->_errno = fs_dev_translate_error(result);
         return -1;
@@ -575,27 +1477,32 @@ static int fs_dev_unlink_r(struct _reent *r, const char *name) {
     return result;
 }
 
-static int fs_dev_chdir_r(struct _reent *r, const char *name) {
+static int fs_dev_unlink_r(struct _reent *r, const char *name) {
     fs_dev_private_t *dev = fs_dev_get_device_data(name);
     if (!dev) {
         r->_errno = ENODEV;
         return -1;
     }
 
-    OSLockMutex(dev->pMutex);
+    int result = fs_dev_unlink(r, dev, name);
+    fs_dev_put_device_data(dev);
+    return result;
+}
 
-    char *real_path = fs_dev_real_path(name, dev);
-    if (!real_path) {
-        r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
+static int fs_dev_chdir(struct _reent *r, fs_dev_private_t *dev, const char *name) {
+    fs_dev_ns_lock(dev, 0);
+
+    char real_path[FS_DEV_PATH_MAX];
+    int real_len = fs_dev_real_path(real_path, name, dev);
+    if (real_len < 0) {
+        r->_errno = ENAMETOOLONG;
+        fs_dev_ns_unlock(dev, 0);
         return -1;
     }
 
     int result = IOSUHAX_FSA_ChangeDir(dev->fsaFd, real_path);
 
-    free(real_path);
-
-    OSUnlockMutex(dev->pMutex);
+    fs_dev_ns_unlock(dev, 0);
 
     if (result < 0) {
         r->_errno = fs_dev_translate_error(result);
@@ -605,36 +1512,38 @@ static int fs_dev_chdir_r(struct _reent *r, const char *name) {
     return 0;
 }
 
-static int fs_dev_rename_r(struct _reent *r, const char *oldName, const char *newName) {
-    fs_dev_private_t *dev = fs_dev_get_device_data(oldName);
+static int fs_dev_chdir_r(struct _reent *r, const char *name) {
+    fs_dev_private_t *dev = fs_dev_get_device_data(name);
     if (!dev) {
         r->_errno = ENODEV;
         return -1;
     }
 
-    OSLockMutex(dev->pMutex);
+    int result = fs_dev_chdir(r, dev, name);
+    fs_dev_put_device_data(dev);
+    return result;
+}
 
-    char *real_oldpath = fs_dev_real_path(oldName, dev);
-    if (!real_oldpath) {
-        r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
+static int fs_dev_rename(struct _reent *r, fs_dev_private_t *dev, const char *oldName, const char *newName) {
+    if (dev->readOnly) {
+        r->_errno = EROFS;
         return -1;
     }
-    char *real_newpath = fs_dev_real_path(newName, dev);
-    if (!real_newpath) {
-        r->_errno = ENOMEM;
-        free(real_oldpath);
-        OSUnlockMutex(dev->pMutex);
+
+    fs_dev_ns_lock(dev, 1);
+
+    char real_oldpath[FS_DEV_PATH_MAX];
+    char real_newpath[FS_DEV_PATH_MAX];
+    if (fs_dev_real_path(real_oldpath, oldName, dev) < 0 || fs_dev_real_path(real_newpath, newName, dev) < 0) {
+        r->_errno = ENAMETOOLONG;
+        fs_dev_ns_unlock(dev, 1);
         return -1;
     }
 
     //! TODO
     int result = FS_ERROR_UNSUPPORTED_COMMAND;
 
-    free(real_oldpath);
-    free(real_newpath);
-
-    OSUnlockMutex(dev->pMutex);
+    fs_dev_ns_unlock(dev, 1);
 
     if (result < 0) {
         r->_errno = fs_dev_translate_error(result);
@@ -644,26 +1553,43 @@ static int fs_dev_rename_r(struct _reent *r, const char *oldName, const char *ne
     return 0;
 }
 
-static int fs_dev_mkdir_r(struct _reent *r, const char *path, int mode) {
-    fs_dev_private_t *dev = fs_dev_get_device_data(path);
+static int fs_dev_rename_r(struct _reent *r, const char *oldName, const char *newName) {
+    fs_dev_private_t *dev = fs_dev_get_device_data(oldName);
     if (!dev) {
         r->_errno = ENODEV;
         return -1;
     }
 
-    OSLockMutex(dev->pMutex);
+    int result = fs_dev_rename(r, dev, oldName, newName);
+    fs_dev_put_device_data(dev);
+    return result;
+}
 
-    char *real_path = fs_dev_real_path(path, dev);
-    if (!real_path) {
-        r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
+static int fs_dev_mkdir(struct _reent *r, fs_dev_private_t *dev, const char *path, int mode) {
+    if (dev->readOnly) {
+        r->_errno = EROFS;
+        return -1;
+    }
+
+    fs_dev_ns_lock(dev, 1);
+
+    char real_path[FS_DEV_PATH_MAX];
+    int real_len = fs_dev_real_path(real_path, path, dev);
+    if (real_len < 0) {
+        r->_errno = ENAMETOOLONG;
+        fs_dev_ns_unlock(dev, 1);
         return -1;
     }
 
     int result = IOSUHAX_FSA_MakeDir(dev->fsaFd, real_path, fs_dev_translate_permission_mode(mode));
-    free(real_path);
 
-    OSUnlockMutex(dev->pMutex);
+    if (dev->statCache) {
+        fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+        iosuhax_stat_cache_invalidate(dev->statCache, real_path, real_len);
+        OSUnlockMutex(dev->pMutex);
+    }
+
+    fs_dev_ns_unlock(dev, 1);
 
     if (result < 0) {
         r->_errno = fs_dev_translate_error(result);
@@ -673,26 +1599,43 @@ static int fs_dev_mkdir_r(struct _reent *r, const char *path, int mode) {
     return 0;
 }
 
-static int fs_dev_chmod_r(struct _reent *r, const char *path, mode_t mode) {
+static int fs_dev_mkdir_r(struct _reent *r, const char *path, int mode) {
     fs_dev_private_t *dev = fs_dev_get_device_data(path);
     if (!dev) {
         r->_errno = ENODEV;
         return -1;
     }
 
-    OSLockMutex(dev->pMutex);
+    int result = fs_dev_mkdir(r, dev, path, mode);
+    fs_dev_put_device_data(dev);
+    return result;
+}
 
-    char *real_path = fs_dev_real_path(path, dev);
-    if (!real_path) {
-        r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
+static int fs_dev_chmod(struct _reent *r, fs_dev_private_t *dev, const char *path, mode_t mode) {
+    if (dev->readOnly) {
+        r->_errno = EROFS;
+        return -1;
+    }
+
+    fs_dev_ns_lock(dev, 1);
+
+    char real_path[FS_DEV_PATH_MAX];
+    int real_len = fs_dev_real_path(real_path, path, dev);
+    if (real_len < 0) {
+        r->_errno = ENAMETOOLONG;
+        fs_dev_ns_unlock(dev, 1);
         return -1;
     }
 
     int result = IOSUHAX_FSA_ChangeMode(dev->fsaFd, real_path, fs_dev_translate_permission_mode(mode));
-    free(real_path);
 
-    OSUnlockMutex(dev->pMutex);
+    if (dev->statCache) {
+        fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+        iosuhax_stat_cache_invalidate(dev->statCache, real_path, real_len);
+        OSUnlockMutex(dev->pMutex);
+    }
+
+    fs_dev_ns_unlock(dev, 1);
 
     if (result < 0) {
         r->_errno = fs_dev_translate_error(result);
@@ -702,22 +1645,29 @@ static int fs_dev_chmod_r(struct _reent *r, const char *path, mode_t mode) {
     return 0;
 }
 
-static int fs_dev_statvfs_r(struct _reent *r, const char *path, struct statvfs *buf) {
+static int fs_dev_chmod_r(struct _reent *r, const char *path, mode_t mode) {
     fs_dev_private_t *dev = fs_dev_get_device_data(path);
     if (!dev) {
         r->_errno = ENODEV;
         return -1;
     }
 
-    OSLockMutex(dev->pMutex);
+    int result = fs_dev_chmod(r, dev, path, mode);
+    fs_dev_put_device_data(dev);
+    return result;
+}
+
+static int fs_dev_statvfs(struct _reent *r, fs_dev_private_t *dev, const char *path, struct statvfs *buf) {
+    fs_dev_ns_lock(dev, 0);
 
     // Zero out the stat buffer
     memset(buf, 0, sizeof(struct statvfs));
 
-    char *real_path = fs_dev_real_path(path, dev);
-    if (!real_path) {
-        r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
+    char real_path[FS_DEV_PATH_MAX];
+    int real_len = fs_dev_real_path(real_path, path, dev);
+    if (real_len < 0) {
+        r->_errno = ENAMETOOLONG;
+        fs_dev_ns_unlock(dev, 0);
         return -1;
     }
 
@@ -725,11 +1675,9 @@ static int fs_dev_statvfs_r(struct _reent *r, const char *path, struct statvfs *
 
     int result = IOSUHAX_FSA_GetDeviceInfo(dev->fsaFd, real_path, 0x00, (uint32_t *) &size);
 
-    free(real_path);
-
     if (result < 0) {
         r->_errno = fs_dev_translate_error(result);
-        OSUnlockMutex(dev->pMutex);
+        fs_dev_ns_unlock(dev, 0);
         return -1;
     }
 
@@ -760,26 +1708,43 @@ static int fs_dev_statvfs_r(struct _reent *r, const char *path, struct statvfs *
     // Maximum length of filenames
     buf->f_namemax = 255;
 
-    OSUnlockMutex(dev->pMutex);
+    fs_dev_ns_unlock(dev, 0);
 
     return 0;
 }
 
-static DIR_ITER *fs_dev_diropen_r(struct _reent *r, DIR_ITER *dirState, const char *path) {
+static int fs_dev_statvfs_r(struct _reent *r, const char *path, struct statvfs *buf) {
     fs_dev_private_t *dev = fs_dev_get_device_data(path);
     if (!dev) {
         r->_errno = ENODEV;
-        return NULL;
+        return -1;
     }
 
+    int result = fs_dev_statvfs(r, dev, path, buf);
+    fs_dev_put_device_data(dev);
+    return result;
+}
+
+static DIR_ITER *fs_dev_diropen(struct _reent *r, fs_dev_private_t *dev, DIR_ITER *dirState, const char *path) {
     fs_dev_dir_entry_t *dirIter = (fs_dev_dir_entry_t *) dirState->dirStruct;
 
-    OSLockMutex(dev->pMutex);
+    fs_dev_ns_lock(dev, 0);
+
+    char real_path[FS_DEV_PATH_MAX];
+    int real_len = fs_dev_real_path(real_path, path, dev);
+    if (real_len < 0) {
+        r->_errno = ENAMETOOLONG;
+        fs_dev_ns_unlock(dev, 0);
+        return NULL;
+    }
+
+    // The directory path is kept behind the entries so dirnext can put the entries into the stat cache
+    uint32_t pathSize = dev->statCache ? real_len + 2 : 0;
 
-    char *real_path = fs_dev_real_path(path, dev);
-    if (!real_path) {
+    FSDirectoryEntry *entries = (FSDirectoryEntry *) malloc(sizeof(FSDirectoryEntry) * FS_DEV_DIR_ENTRIES + pathSize);
+    if (!entries) {
         r->_errno = ENOMEM;
-        OSUnlockMutex(dev->pMutex);
+        fs_dev_ns_unlock(dev, 0);
         return NULL;
     }
 
@@ -787,21 +1752,46 @@ static DIR_ITER *fs_dev_diropen_r(struct _reent *r, DIR_ITER *dirState, const ch
 
     int result = IOSUHAX_FSA_OpenDir(dev->fsaFd, real_path, &dirHandle);
 
-    free(real_path);
-
-    OSUnlockMutex(dev->pMutex);
+    fs_dev_ns_unlock(dev, 0);
 
     if (result < 0) {
+        free(entries);
         r->_errno = fs_dev_translate_error(result);
         return NULL;
     }
 
     dirIter->dev       = dev;
     dirIter->dirHandle = dirHandle;
+    dirIter->entries   = entries;
+    dirIter->entryCnt  = 0;
+    dirIter->entryIdx  = 0;
+    dirIter->path      = NULL;
+    dirIter->pathLen   = 0;
+
+    if (pathSize) {
+        dirIter->path = (char *) (entries + FS_DEV_DIR_ENTRIES);
+        memcpy(dirIter->path, real_path, real_len);
+        if (real_len == 0 || real_path[real_len - 1] != '/')
+            dirIter->path[real_len++] = '/';
+        dirIter->path[real_len] = '\0';
+        dirIter->pathLen        = real_len;
+    }
 
     return dirState;
 }
 
+static DIR_ITER *fs_dev_diropen_r(struct _reent *r, DIR_ITER *dirState, const char *path) {
+    fs_dev_private_t *dev = fs_dev_get_device_data(path);
+    if (!dev) {
+        r->_errno = ENODEV;
+        return NULL;
+    }
+
+    DIR_ITER *result = fs_dev_diropen(r, dev, dirState, path);
+    fs_dev_put_device_data(dev);
+    return result;
+}
+
 static int fs_dev_dirclose_r(struct _reent *r, DIR_ITER *dirState) {
     fs_dev_dir_entry_t *dirIter = (fs_dev_dir_entry_t *) dirState->dirStruct;
     if (!dirIter->dev) {
@@ -809,11 +1799,16 @@ static int fs_dev_dirclose_r(struct _reent *r, DIR_ITER *dirState) {
         return -1;
     }
 
-    OSLockMutex(dirIter->dev->pMutex);
+    fs_dev_ns_lock(dirIter->dev, 0);
 
     int result = IOSUHAX_FSA_CloseDir(dirIter->dev->fsaFd, dirIter->dirHandle);
 
-    OSUnlockMutex(dirIter->dev->pMutex);
+    fs_dev_ns_unlock(dirIter->dev, 0);
+
+    // the directory path lives in the same block
+    free(dirIter->entries);
+    dirIter->entries = NULL;
+    dirIter->path    = NULL;
 
     if (result < 0) {
         r->_errno = fs_dev_translate_error(result);
@@ -829,11 +1824,15 @@ static int fs_dev_dirreset_r(struct _reent *r, DIR_ITER *dirState) {
         return -1;
     }
 
-    OSLockMutex(dirIter->dev->pMutex);
+    fs_dev_ns_lock(dirIter->dev, 0);
 
     int result = IOSUHAX_FSA_RewindDir(dirIter->dev->fsaFd, dirIter->dirHandle);
 
-    OSUnlockMutex(dirIter->dev->pMutex);
+    // Drop the buffered entries, they belong to the old position
+    dirIter->entryCnt = 0;
+    dirIter->entryIdx = 0;
+
+    fs_dev_ns_unlock(dirIter->dev, 0);
 
     if (result < 0) {
         r->_errno = fs_dev_translate_error(result);
@@ -849,18 +1848,44 @@ static int fs_dev_dirnext_r(struct _reent *r, DIR_ITER *dirState, char *filename
         return -1;
     }
 
-    OSLockMutex(dirIter->dev->pMutex);
+    fs_dev_ns_lock(dirIter->dev, 0);
 
-    FSDirectoryEntry *dir_entry = malloc(sizeof(FSDirectoryEntry));
+    // Refill the buffer once every entry in it was handed out
+    if (dirIter->entryIdx >= dirIter->entryCnt) {
+        uint32_t generation = __atomic_load_n(&dirIter->dev->statGeneration, __ATOMIC_ACQUIRE);
 
-    int result = IOSUHAX_FSA_ReadDir(dirIter->dev->fsaFd, dirIter->dirHandle, dir_entry);
-    if (result < 0) {
-        free(dir_entry);
-        r->_errno = fs_dev_translate_error(result);
-        OSUnlockMutex(dirIter->dev->pMutex);
-        return -1;
+        int result = IOSUHAX_FSA_ReadDirMulti(dirIter->dev->fsaFd, dirIter->dirHandle, dirIter->entries, FS_DEV_DIR_ENTRIES);
+        if (result <= 0) {
+            r->_errno = (result < 0) ? fs_dev_translate_error(result) : ENOENT;
+            fs_dev_ns_unlock(dirIter->dev, 0);
+            return -1;
+        }
+        dirIter->entryCnt = result;
+        dirIter->entryIdx = 0;
+
+        // stat calls for the entries usually follow right away, they are cached while the lock
+        // still keeps namespace changes out so a later change invalidates them
+        fs_dev_private_t *dev = dirIter->dev;
+        if (dev->statCache && dirIter->path) {
+            char entry_path[FS_DEV_PATH_MAX];
+            memcpy(entry_path, dirIter->path, dirIter->pathLen);
+
+            // sizes of files written during the read may be outdated
+            fs_dev_lock(dev->pMutex, &dev->stats.cache_lock_waits);
+            for (int i = 0; i < result && dev->statGeneration == generation; i++) {
+                uint32_t name_len = strlen(dirIter->entries[i].name);
+                if (dirIter->pathLen + name_len >= FS_DEV_PATH_MAX)
+                    continue;
+
+                memcpy(entry_path + dirIter->pathLen, dirIter->entries[i].name, name_len);
+                iosuhax_stat_cache_insert(dev->statCache, entry_path, dirIter->pathLen + name_len, &dirIter->entries[i].info);
+            }
+            OSUnlockMutex(dev->pMutex);
+        }
     }
 
+    FSDirectoryEntry *dir_entry = &dirIter->entries[dirIter->entryIdx++];
+
     // Fetch the current entry
     strcpy(filename, dir_entry->name);
 
@@ -883,8 +1908,7 @@ static int fs_dev_dirnext_r(struct _reent *r, DIR_ITER *dirState, char *filename
         st->st_mtime   = fs_dev_translate_time(dir_entry->info.modified);
     }
 
-    free(dir_entry);
-    OSUnlockMutex(dirIter->dev->pMutex);
+    fs_dev_ns_unlock(dirIter->dev, 0);
     return 0;
 }
 
@@ -910,7 +1934,7 @@ static const devoptab_t devops_fs = {
         .dirclose_r   = fs_dev_dirclose_r,
         .statvfs_r    = fs_dev_statvfs_r,
         .ftruncate_r  = NULL, // fs_dev_ftruncate_r,
-        .fsync_r      = NULL, // fs_dev_fsync_r,
+        .fsync_r      = fs_dev_fsync_r,
         .deviceData   = NULL,
         .chmod_r      = fs_dev_chmod_r,
         .fchmod_r     = NULL, // fs_dev_fchmod_r,
@@ -919,7 +1943,23 @@ static const devoptab_t devops_fs = {
         .utimes_r     = NULL,
 };
 
-static int fs_dev_add_device(const char *name, const char *mount_path, int fsaFd, int isMounted) {
+//! closes the handles opened for the mount and frees the streaming resources of all channels
+static void fs_dev_free_channels(fs_dev_private_t *priv) {
+    for (uint32_t i = 0; i < priv->channelCount; i++) {
+        fs_dev_channel_t *channel = &priv->channels[i];
+        if (channel->ioQueue)
+            IOSUHAX_DestroyAsyncQueue(channel->ioQueue);
+        if (channel->ioStaging)
+            free(channel->ioStaging);
+
+        if (i > 0)
+            IOSUHAX_FSA_Close(channel->fsaFd);
+        free(channel->pMutex);
+    }
+    priv->channelCount = 0;
+}
+
+static int fs_dev_add_device(const char *name, const char *mount_path, int fsaFd, int isMounted, const mount_fs_options_t *options) {
     devoptab_t *dev = NULL;
     char *devname   = NULL;
     char *devpath   = NULL;
@@ -954,19 +1994,79 @@ static int fs_dev_add_device(const char *name, const char *mount_path, int fsaFd
     strcpy(devpath, mount_path);
 
     // setup private data
-    priv->mount_path = devpath;
-    priv->fsaFd      = fsaFd;
-    priv->mounted    = isMounted;
-    priv->pMutex     = malloc(OS_MUTEX_SIZE);
-
-    if (!priv->pMutex) {
+    priv->name              = devname;
+    priv->nameHash          = fs_dev_name_hash(devname, &priv->nameLen);
+    priv->nameNext          = NULL;
+    priv->refs              = 0;
+    priv->removed           = 0;
+    priv->mount_path        = devpath;
+    priv->mountPathLen      = strlen(devpath);
+    priv->fsaFd             = fsaFd;
+    priv->mounted           = isMounted;
+    priv->channelCount      = 0;
+    priv->readAheadSize     = options->read_ahead_size & ~0x3F;
+    priv->writeBackSize     = options->write_back_size & ~0x3F;
+    priv->pageCacheSize     = options->page_cache_size;
+    priv->pageCache         = NULL;
+    priv->statCache         = iosuhax_stat_cache_create(options->stat_cache_size, options->stat_cache_ttl);
+    priv->statCacheNegative = options->stat_cache_negative;
+    priv->statGeneration    = 0;
+    priv->nsReaders         = 0;
+    priv->readOnly          = options->read_only;
+    memset(&priv->stats, 0, sizeof(priv->stats));
+
+    // the namespace mutex and condition share the allocation of the device mutex
+    priv->pMutex = malloc(OS_MUTEX_SIZE * 2 + OS_COND_SIZE);
+
+    if (!priv->pMutex || (options->stat_cache_size && !priv->statCache)) {
+        iosuhax_stat_cache_destroy(priv->statCache);
+        free(priv->pMutex);
         free(dev);
         free(priv);
         errno = ENOMEM;
         return -1;
     }
 
+    priv->nsMutex = (char *) priv->pMutex + OS_MUTEX_SIZE;
+    priv->nsCond  = (char *) priv->nsMutex + OS_MUTEX_SIZE;
     OSInitMutex(priv->pMutex);
+    OSInitMutex(priv->nsMutex);
+    OSInitCond(priv->nsCond);
+
+    // channel 0 is the caller's handle, the others are opened for the mount and fall away if that fails
+    uint32_t channelCount = options->fsa_handle_count;
+    if (channelCount == 0)
+        channelCount = 1;
+    if (channelCount > MOUNT_FS_FSA_HANDLES_MAX)
+        channelCount = MOUNT_FS_FSA_HANDLES_MAX;
+
+    memset(priv->channels, 0, sizeof(priv->channels));
+
+    while (priv->channelCount < channelCount) {
+        fs_dev_channel_t *channel = &priv->channels[priv->channelCount];
+        channel->pMutex           = malloc(OS_MUTEX_SIZE);
+        if (!channel->pMutex)
+            break;
+
+        channel->fsaFd = priv->channelCount ? IOSUHAX_FSA_Open() : fsaFd;
+        if (channel->fsaFd < 0) {
+            free(channel->pMutex);
+            channel->pMutex = NULL;
+            break;
+        }
+
+        OSInitMutex(channel->pMutex);
+        priv->channelCount++;
+    }
+
+    if (priv->channelCount == 0) {
+        iosuhax_stat_cache_destroy(priv->statCache);
+        free(priv->pMutex);
+        free(dev);
+        free(priv);
+        errno = ENOMEM;
+        return -1;
+    }
 
     // Setup the devoptab
     memcpy(dev, &devops_fs, sizeof(devoptab_t));
@@ -974,14 +2074,25 @@ static int fs_dev_add_device(const char *name, const char *mount_path, int fsaFd
     dev->deviceData = priv;
 
     // Add the device to the devoptab table (if there is a free slot)
+    fs_dev_name_lock();
     for (i = 3; i < STD_MAX; i++) {
         if (devoptab_list[i] == devoptab_list[0]) {
             devoptab_list[i] = dev;
+
+            // publish the device for path lookups once it is fully set up
+            uint32_t bucket           = priv->nameHash % FS_DEV_NAME_BUCKETS;
+            priv->nameNext            = fs_dev_name_table[bucket];
+            fs_dev_name_table[bucket] = priv;
+            fs_dev_name_unlock();
             return 0;
         }
     }
+    fs_dev_name_unlock();
 
     // failure, free all memory
+    fs_dev_free_channels(priv);
+    iosuhax_stat_cache_destroy(priv->statCache);
+    free(priv->pMutex);
     free(priv);
     free(dev);
 
@@ -991,45 +2102,75 @@ static int fs_dev_add_device(const char *name, const char *mount_path, int fsaFd
 }
 
 static int fs_dev_remove_device(const char *path) {
-    const devoptab_t *devoptab = NULL;
-    char name[128]             = {0};
-    int i;
-
-    // Get the device name from the path
-    strncpy(name, path, 127);
-    strtok(name, ":/");
-
-    // Find and remove the specified device from the devoptab table
-    // NOTE: We do this manually due to a 'bug' in RemoveDevice
-    //       which ignores names with suffixes and causes names
-    //       like "ntfs" and "ntfs1" to be seen as equals
-    for (i = 3; i < STD_MAX; i++) {
-        devoptab = devoptab_list[i];
-        if (devoptab && devoptab->name) {
-            if (strcmp(name, devoptab->name) == 0) {
-                devoptab_list[i] = devoptab_list[0];
-
-                if (devoptab->deviceData) {
-                    fs_dev_private_t *priv = (fs_dev_private_t *) devoptab->deviceData;
-
-                    if (priv->mounted)
-                        IOSUHAX_FSA_Unmount(priv->fsaFd, priv->mount_path, 2);
-
-                    if (priv->pMutex)
-                        free(priv->pMutex);
-                    free(devoptab->deviceData);
-                }
+    fs_dev_name_lock();
+    fs_dev_private_t *priv = fs_dev_find_device(path);
+    if (!priv) {
+        fs_dev_name_unlock();
+        return -1;
+    }
 
-                free((devoptab_t *) devoptab);
-                return 0;
-            }
+    // Find the device in the devoptab table
+    int slot = -1;
+    for (int i = 3; i < STD_MAX; i++) {
+        const devoptab_t *devoptab = devoptab_list[i];
+        if (devoptab && devoptab->deviceData == priv) {
+            slot = i;
+            break;
         }
     }
+    if (slot < 0) {
+        fs_dev_name_unlock();
+        return -1;
+    }
 
-    return -1;
+    // Unlink the device from the name table and the devoptab table before anything is freed
+    fs_dev_private_t **link = &fs_dev_name_table[priv->nameHash % FS_DEV_NAME_BUCKETS];
+    while (*link && *link != priv)
+        link = &(*link)->nameNext;
+    if (*link)
+        *link = priv->nameNext;
+
+    const devoptab_t *devoptab = devoptab_list[slot];
+    devoptab_list[slot]        = devoptab_list[0];
+
+    // calls that found the device before it was unlinked still use it
+    priv->removed = 1;
+    while (priv->refs)
+        OSWaitCond(fs_dev_name_cond, fs_dev_name_mutex);
+    fs_dev_name_unlock();
+
+    if (priv->mounted)
+        IOSUHAX_FSA_Unmount(priv->fsaFd, priv->mount_path, 2);
+
+    fs_dev_free_channels(priv);
+    if (priv->pageCache)
+        iosuhax_page_cache_destroy(priv->pageCache);
+    if (priv->statCache)
+        iosuhax_stat_cache_destroy(priv->statCache);
+    if (priv->pMutex)
+        free(priv->pMutex);
+    free(priv);
+
+    free((devoptab_t *) devoptab);
+    return 0;
 }
 
 int mount_fs(const char *virt_name, int fsaFd, const char *dev_path, const char *mount_path) {
+    return mount_fs_ex(virt_name, fsaFd, dev_path, mount_path, NULL);
+}
+
+int mount_fs_ex(const char *virt_name, int fsaFd, const char *dev_path, const char *mount_path, const mount_fs_options_t *options) {
+    const mount_fs_options_t defaults = {
+            .read_ahead_size  = 0,
+            .write_back_size  = 0,
+            .page_cache_size  = 0,
+            .stat_cache_size  = 0,
+            .fsa_handle_count = 1,
+            .read_only        = 0,
+    };
+    if (!options)
+        options = &defaults;
+
     int isMounted = 0;
 
     if (dev_path) {
@@ -1041,9 +2182,112 @@ int mount_fs(const char *virt_name, int fsaFd, const char *dev_path, const char
         }
     }
 
-    return fs_dev_add_device(virt_name, mount_path, fsaFd, isMounted);
+    return fs_dev_add_device(virt_name, mount_path, fsaFd, isMounted, options);
 }
 
 int unmount_fs(const char *virt_name) {
     return fs_dev_remove_device(virt_name);
 }
+
+//! returns NULL if fd is not a file opened through one of the mount_fs devices
+static fs_dev_file_state_t *fs_dev_get_file(int fd) {
+    __handle *handle = __get_handle(fd);
+    if (!handle || handle->device < 0 || handle->device >= STD_MAX)
+        return NULL;
+
+    const devoptab_t *devoptab = devoptab_list[handle->device];
+    if (!devoptab || devoptab->open_r != fs_dev_open_r)
+        return NULL;
+
+    return (fs_dev_file_state_t *) handle->fileStruct;
+}
+
+//! Turns the result of read_r/write_r into the pread/pwrite one. A transfer that failed before the first byte
+//! returns -1 with errno set, otherwise the errno of the caller is kept.
+static ssize_t fs_dev_pio_result(struct _reent *r, ssize_t result, int savedErrno) {
+    if (result == 0 && r->_errno != 0) {
+        errno = r->_errno;
+        return -1;
+    }
+
+    r->_errno = savedErrno;
+    return result;
+}
+
+ssize_t mount_fs_pread(int fd, void *buf, size_t len, off_t offset) {
+    fs_dev_file_state_t *file = fs_dev_get_file(fd);
+    if (!file || offset < 0) {
+        errno = file ? EINVAL : EBADF;
+        return -1;
+    }
+
+    // read_r reports errors as 0 bytes with the error in _errno, it is cleared to tell them from the end of the file
+    struct _reent *r = _REENT;
+    int savedErrno   = r->_errno;
+    r->_errno        = 0;
+
+    // the file mutex is recursive, so read_r runs with the position swapped in
+    fs_dev_lock(file->pMutex, &file->dev->stats.file_lock_waits);
+    uint64_t pos   = file->pos;
+    file->pos      = offset;
+    ssize_t result = fs_dev_read_r(r, file, (char *) buf, len);
+    file->pos      = pos;
+    OSUnlockMutex(file->pMutex);
+
+    return fs_dev_pio_result(r, result, savedErrno);
+}
+
+ssize_t mount_fs_pwrite(int fd, const void *buf, size_t len, off_t offset) {
+    fs_dev_file_state_t *file = fs_dev_get_file(fd);
+    if (!file || offset < 0) {
+        errno = file ? EINVAL : EBADF;
+        return -1;
+    }
+
+    struct _reent *r = _REENT;
+    int savedErrno   = r->_errno;
+    r->_errno        = 0;
+
+    fs_dev_lock(file->pMutex, &file->dev->stats.file_lock_waits);
+    uint64_t pos   = file->pos;
+    file->pos      = offset;
+    ssize_t result = fs_dev_write_r(r, file, (const char *) buf, len);
+    file->pos      = pos;
+    OSUnlockMutex(file->pMutex);
+
+    return fs_dev_pio_result(r, result, savedErrno);
+}
+
+int mount_fs_get_stats(const char *virt_name, mount_fs_stats_t *stats) {
+    if (!stats)
+        return -1;
+
+    fs_dev_private_t *dev = fs_dev_get_device_data(virt_name);
+    if (!dev)
+        return -1;
+
+    OSLockMutex(dev->pMutex);
+    memcpy(stats, &dev->stats, sizeof(mount_fs_stats_t));
+    if (dev->pageCache)
+        iosuhax_page_cache_get_stats(dev->pageCache, &stats->page_cache_hits, &stats->page_cache_misses, &stats->page_cache_evictions);
+    if (dev->statCache)
+        iosuhax_stat_cache_get_stats(dev->statCache, &stats->stat_cache_hits, &stats->stat_cache_negative_hits, &stats->stat_cache_misses);
+    OSUnlockMutex(dev->pMutex);
+    fs_dev_put_device_data(dev);
+    return 0;
+}
+
+void mount_fs_reset_stats(const char *virt_name) {
+    fs_dev_private_t *dev = fs_dev_get_device_data(virt_name);
+    if (!dev)
+        return;
+
+    OSLockMutex(dev->pMutex);
+    memset(&dev->stats, 0, sizeof(mount_fs_stats_t));
+    if (dev->pageCache)
+        iosuhax_page_cache_reset_stats(dev->pageCache);
+    if (dev->statCache)
+        iosuhax_stat_cache_reset_stats(dev->statCache);
+    OSUnlockMutex(dev->pMutex);
+    fs_dev_put_device_data(dev);
+}
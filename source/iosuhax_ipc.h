@@ -0,0 +1,138 @@
+#ifndef __IOSUHAX_IPC_H_
+#define __IOSUHAX_IPC_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOSUHAX_MAGIC_WORD      0x4E696365
+
+#define IOCTL_MEM_WRITE         0x00
+#define IOCTL_MEM_READ          0x01
+#define IOCTL_SVC               0x02
+#define IOCTL_MEMCPY            0x04
+#define IOCTL_REPEATED_WRITE    0x05
+#define IOCTL_KERN_READ32       0x06
+#define IOCTL_KERN_WRITE32      0x07
+#define IOCTL_READ_OTP          0x08
+
+#define IOCTL_FSA_OPEN          0x40
+#define IOCTL_FSA_CLOSE         0x41
+#define IOCTL_FSA_MOUNT         0x42
+#define IOCTL_FSA_UNMOUNT       0x43
+#define IOCTL_FSA_GETDEVICEINFO 0x44
+#define IOCTL_FSA_OPENDIR       0x45
+#define IOCTL_FSA_READDIR       0x46
+#define IOCTL_FSA_CLOSEDIR      0x47
+#define IOCTL_FSA_MAKEDIR       0x48
+#define IOCTL_FSA_OPENFILE      0x49
+#define IOCTL_FSA_READFILE      0x4A
+#define IOCTL_FSA_WRITEFILE     0x4B
+#define IOCTL_FSA_STATFILE      0x4C
+#define IOCTL_FSA_CLOSEFILE     0x4D
+#define IOCTL_FSA_SETFILEPOS    0x4E
+#define IOCTL_FSA_GETSTAT       0x4F
+#define IOCTL_FSA_REMOVE        0x50
+#define IOCTL_FSA_REWINDDIR     0x51
+#define IOCTL_FSA_CHDIR         0x52
+#define IOCTL_FSA_RENAME        0x53
+#define IOCTL_FSA_RAW_OPEN      0x54
+#define IOCTL_FSA_RAW_READ      0x55
+#define IOCTL_FSA_RAW_WRITE     0x56
+#define IOCTL_FSA_RAW_CLOSE     0x57
+#define IOCTL_FSA_CHANGEMODE    0x58
+#define IOCTL_FSA_FLUSHVOLUME   0x59
+#define IOCTL_CHECK_IF_IOSUHAX  0x5B
+#define IOCTL_FSA_BATCH         0x60 // packed request list, see iosuhax_batch.c
+#define IOCTL_FSA_READDIR_MULTI 0x61
+#define IOCTL_FSA_OPENFILE_STAT 0x62
+#define IOCTL_FSA_SETFILEPOS64  0x63
+#define IOCTL_FSA_GETFILEPOS64  0x64
+
+/*
+ * Request layouts, everything implementing the other side (IOSU or a host stand-in) has to match these.
+ * All words are 32 bit big endian, both the PPC and IOSU run big endian so nothing is swapped.
+ * Strings are NUL terminated and referenced by their byte offset from the start of the input buffer.
+ * Every FSA reply starts with the FSA result word, outputs follow it.
+ *
+ *   code           input words                                   output
+ *   MEM_WRITE      address, data...                              -
+ *   MEM_READ       address                                       data
+ *   MEMCPY         dst, src, size                                -
+ *   KERN_READ32    address                                       count words
+ *   KERN_WRITE32   address, value                                -
+ *   SVC            svc_id, args...                               result
+ *   READ_OTP       -                                             0x400 bytes
+ *   FSA_OPEN       -                                             fsaFd
+ *   FSA_CLOSE      fsaFd                                         result
+ *   FSA_MOUNT      fsaFd, dev_off, vol_off, flags, arg_off,      result
+ *                  arg_len, strings
+ *   FSA_UNMOUNT    fsaFd, path_off, flags, path                  result
+ *   FSA_FLUSHVOLUME/OPENDIR/CHDIR/GETSTAT/REMOVE/RAW_OPEN
+ *                  fsaFd, path_off, path                         result, handle or FSStat where returned
+ *   FSA_MAKEDIR/CHANGEMODE/GETDEVICEINFO
+ *                  fsaFd, path_off, flags/mode/type, path        result, 0x64 bytes for GETDEVICEINFO
+ *   FSA_OPENFILE   fsaFd, path_off, mode_off, path, mode         result, handle
+ *   FSA_OPENFILE_STAT
+ *                  same as OPENFILE                              result, handle, FSStat, size_hi, size_lo
+ *                                                                (closed again if the stat fails)
+ *   FSA_READDIR    fsaFd, handle                                 result, FSDirectoryEntry
+ *   FSA_READDIR_MULTI
+ *                  fsaFd, handle, max_cnt                        entry count or FSA error, count FSDirectoryEntry
+ *   FSA_REWINDDIR/CLOSEDIR/STATFILE/CLOSEFILE/RAW_CLOSE
+ *                  fsaFd, handle                                 result, FSStat for STATFILE
+ *   FSA_SETFILEPOS fsaFd, handle, position                       result
+ *   FSA_SETFILEPOS64
+ *                  fsaFd, handle, position_hi, position_lo       result
+ *   FSA_GETFILEPOS64
+ *                  fsaFd, handle                                 result, position_hi, position_lo
+ *   FSA_READFILE   fsaFd, size, cnt, handle, flags               result, data at offset 0x40
+ *   FSA_WRITEFILE  fsaFd, size, cnt, handle, flags,              result
+ *                  data at offset 0x40
+ *   FSA_RAW_READ   fsaFd, block_size, block_cnt, offset_hi,      result, data at offset 0x40
+ *                  offset_lo, device_handle
+ *   FSA_RAW_WRITE  same as RAW_READ, data at offset 0x40         result
+ *
+ * The vectored (ioctlv) form of READFILE/WRITEFILE/RAW_READ/RAW_WRITE carries the same input words
+ * in the first vector and the data in a vector of its own, the result word is a separate vector.
+ */
+
+#define ALIGN(align)      __attribute__((aligned(align)))
+#define ALIGN_0x20        ALIGN(0x20)
+#define ALIGN_0x40        ALIGN(0x40)
+#define ROUNDUP(x, align) (((x) + ((align) -1)) & ~((align) -1))
+
+//! buffers passed directly to IOSU as an ioctlv vector must be on a 0x40 boundary and a multiple of 0x40 in size
+#define IS_VECTOR_ALIGNED(ptr, size) (((((uintptr_t) (ptr)) | (size)) & 0x3F) == 0)
+
+//! IOS answers a request the resource manager does not handle with IOS_ERROR_INVALID (-4) or IOS_ERROR_NOEXISTS (-6).
+//! Only these disable a feature probe, any other negative result belongs to the request and is returned as is.
+#define IOSUHAX_IOCTL_UNSUPPORTED(res) ((res) == -4 || (res) == -6)
+
+//! cleared once IOSU rejects the vectored requests, all further calls use the staging copy
+extern int iosuhaxRawIoctlvSupported;
+extern int iosuhaxFileIoctlvSupported;
+
+//! cleared once IOSU rejects IOCTL_FSA_OPENFILE_STAT, IOSUHAX_FSA_OpenFileStat then opens and stats separately
+//! and the devoptab stops asking for the stat when it opens a file
+extern int iosuhaxOpenFileStatSupported;
+
+//! set once IOSU completed a vectored file request. Async file requests are only sent vectored after
+//! that, a rejected one could not be repeated at the file position it was meant for.
+extern int iosuhaxFileIoctlvConfirmed;
+
+//! handle of /dev/iosuhax, negative if IOSUHAX_Open() was not called or failed
+int iosuhax_get_handle(void);
+
+//! Brackets every request on a handle from iosuhax_get_handle, so IOSUHAX_Close does not close it underneath.
+//! enter returns -1 if the handle was closed meanwhile. Async requests leave in their completion callback.
+int iosuhax_transport_enter(int handle);
+void iosuhax_transport_leave(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __IOSUHAX_IPC_H_
@@ -0,0 +1,257 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax_page_cache.h"
+#include <malloc.h>
+#include <string.h>
+
+struct _iosuhax_page_cache_t {
+    iosuhax_page_t *pages;
+    uint8_t *data;
+    uint32_t pageCount;
+    iosuhax_page_t **buckets;
+    uint32_t bucketMask;
+    uint32_t *generations; // invalidation count per entry id slot
+    uint32_t generationShift;
+    iosuhax_page_t *lruHead; // most recently used
+    iosuhax_page_t *lruTail; // replaced next
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+};
+
+static uint32_t page_cache_bucket(iosuhax_page_cache_t *cache, uint32_t entryId, uint32_t index) {
+    return ((entryId * 0x9E3779B1) ^ index) & cache->bucketMask;
+}
+
+static uint32_t *page_cache_generation(iosuhax_page_cache_t *cache, uint32_t entryId) {
+    return &cache->generations[(entryId * 0x9E3779B1) >> cache->generationShift];
+}
+
+static void page_cache_lru_unlink(iosuhax_page_cache_t *cache, iosuhax_page_t *page) {
+    if (page->lruPrev)
+        page->lruPrev->lruNext = page->lruNext;
+    else
+        cache->lruHead = page->lruNext;
+
+    if (page->lruNext)
+        page->lruNext->lruPrev = page->lruPrev;
+    else
+        cache->lruTail = page->lruPrev;
+
+    page->lruPrev = NULL;
+    page->lruNext = NULL;
+}
+
+static void page_cache_lru_push_front(iosuhax_page_cache_t *cache, iosuhax_page_t *page) {
+    page->lruPrev = NULL;
+    page->lruNext = cache->lruHead;
+    if (cache->lruHead)
+        cache->lruHead->lruPrev = page;
+    else
+        cache->lruTail = page;
+    cache->lruHead = page;
+}
+
+static void page_cache_lru_push_back(iosuhax_page_cache_t *cache, iosuhax_page_t *page) {
+    page->lruNext = NULL;
+    page->lruPrev = cache->lruTail;
+    if (cache->lruTail)
+        cache->lruTail->lruNext = page;
+    else
+        cache->lruHead = page;
+    cache->lruTail = page;
+}
+
+static void page_cache_hash_remove(iosuhax_page_cache_t *cache, iosuhax_page_t *page) {
+    iosuhax_page_t **link = &cache->buckets[page_cache_bucket(cache, page->entryId, page->index)];
+    while (*link) {
+        if (*link == page) {
+            *link = page->hashNext;
+            break;
+        }
+        link = &(*link)->hashNext;
+    }
+    page->hashNext = NULL;
+}
+
+//! takes a committed page out of the hash and makes it the next one to be replaced
+static void page_cache_drop(iosuhax_page_cache_t *cache, iosuhax_page_t *page) {
+    page_cache_hash_remove(cache, page);
+    page->len = 0;
+
+    // free pages are reused first
+    page_cache_lru_unlink(cache, page);
+    page_cache_lru_push_back(cache, page);
+}
+
+iosuhax_page_cache_t *iosuhax_page_cache_create(uint32_t budget) {
+    uint32_t pageCount = budget / IOSUHAX_PAGE_SIZE;
+    if (pageCount == 0)
+        return NULL;
+
+    uint32_t bucketCount = 1;
+    while (bucketCount < pageCount)
+        bucketCount <<= 1;
+
+    // at least as many generation slots as buckets, so files rarely share one
+    uint32_t generationBits = 6;
+    while ((1u << generationBits) < bucketCount)
+        generationBits++;
+
+    iosuhax_page_cache_t *cache = (iosuhax_page_cache_t *) malloc(sizeof(iosuhax_page_cache_t));
+    if (!cache)
+        return NULL;
+
+    memset(cache, 0, sizeof(iosuhax_page_cache_t));
+
+    // page data is aligned so pages can be filled without a staging copy
+    cache->pages   = (iosuhax_page_t *) malloc(sizeof(iosuhax_page_t) * pageCount);
+    cache->buckets = (iosuhax_page_t **) malloc(sizeof(iosuhax_page_t *) * bucketCount);
+    cache->data    = (uint8_t *) memalign(0x40, pageCount * IOSUHAX_PAGE_SIZE);
+
+    cache->generations = (uint32_t *) malloc(sizeof(uint32_t) << generationBits);
+    if (!cache->pages || !cache->buckets || !cache->data || !cache->generations) {
+        iosuhax_page_cache_destroy(cache);
+        return NULL;
+    }
+
+    memset(cache->pages, 0, sizeof(iosuhax_page_t) * pageCount);
+    memset(cache->buckets, 0, sizeof(iosuhax_page_t *) * bucketCount);
+    memset(cache->generations, 0, sizeof(uint32_t) << generationBits);
+    cache->pageCount       = pageCount;
+    cache->bucketMask      = bucketCount - 1;
+    cache->generationShift = 32 - generationBits;
+
+    for (uint32_t i = 0; i < pageCount; i++) {
+        cache->pages[i].data = cache->data + i * IOSUHAX_PAGE_SIZE;
+        page_cache_lru_push_back(cache, &cache->pages[i]);
+    }
+
+    return cache;
+}
+
+void iosuhax_page_cache_destroy(iosuhax_page_cache_t *cache) {
+    if (!cache)
+        return;
+
+    if (cache->data)
+        free(cache->data);
+    if (cache->buckets)
+        free(cache->buckets);
+    if (cache->generations)
+        free(cache->generations);
+    if (cache->pages)
+        free(cache->pages);
+    free(cache);
+}
+
+iosuhax_page_t *iosuhax_page_cache_lookup(iosuhax_page_cache_t *cache, uint32_t entryId, uint32_t index) {
+    uint32_t generation  = *page_cache_generation(cache, entryId);
+    iosuhax_page_t *page = cache->buckets[page_cache_bucket(cache, entryId, index)];
+    while (page) {
+        if (page->entryId == entryId && page->index == index) {
+            if (page->generation != generation) {
+                page_cache_drop(cache, page);
+                break;
+            }
+
+            cache->hits++;
+            page_cache_lru_unlink(cache, page);
+            page_cache_lru_push_front(cache, page);
+            return page;
+        }
+        page = page->hashNext;
+    }
+
+    cache->misses++;
+    return NULL;
+}
+
+iosuhax_page_t *iosuhax_page_cache_reserve(iosuhax_page_cache_t *cache, uint32_t entryId, uint32_t index) {
+    iosuhax_page_t *page = cache->lruTail;
+    if (!page)
+        return NULL;
+
+    if (page->len) {
+        cache->evictions++;
+        page_cache_hash_remove(cache, page);
+    }
+
+    page_cache_lru_unlink(cache, page);
+    page->entryId    = entryId;
+    page->index      = index;
+    page->len        = 0;
+    page->generation = *page_cache_generation(cache, entryId);
+    return page;
+}
+
+int iosuhax_page_cache_commit(iosuhax_page_cache_t *cache, iosuhax_page_t *page, uint32_t len) {
+    uint32_t generation = *page_cache_generation(cache, page->entryId);
+    uint32_t bucket     = page_cache_bucket(cache, page->entryId, page->index);
+
+    // the data may predate a change of the file, or another reservation of the same page was faster
+    if (len && page->generation == generation) {
+        iosuhax_page_t *other = cache->buckets[bucket];
+        while (other) {
+            if (other->entryId == page->entryId && other->index == page->index) {
+                if (other->generation == generation) {
+                    len = 0;
+                } else {
+                    page_cache_drop(cache, other);
+                }
+                break;
+            }
+            other = other->hashNext;
+        }
+    } else {
+        len = 0;
+    }
+
+    page->len = len;
+    if (len == 0) {
+        page_cache_lru_push_back(cache, page);
+        return 0;
+    }
+
+    page->hashNext         = cache->buckets[bucket];
+    cache->buckets[bucket] = page;
+    page_cache_lru_push_front(cache, page);
+    return 1;
+}
+
+void iosuhax_page_cache_invalidate(iosuhax_page_cache_t *cache, uint32_t entryId) {
+    (*page_cache_generation(cache, entryId))++;
+}
+
+void iosuhax_page_cache_get_stats(iosuhax_page_cache_t *cache, uint32_t *hits, uint32_t *misses, uint32_t *evictions) {
+    *hits      = cache->hits;
+    *misses    = cache->misses;
+    *evictions = cache->evictions;
+}
+
+void iosuhax_page_cache_reset_stats(iosuhax_page_cache_t *cache) {
+    cache->hits      = 0;
+    cache->misses    = 0;
+    cache->evictions = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef __IOSUHAX_PAGE_CACHE_H_
+#define __IOSUHAX_PAGE_CACHE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Fixed size file pages identified by FSA entry id and page index, the least recently used page is
+//! replaced first. The cache does no locking, the owner has to serialize all calls, but a page may be
+//! filled without holding the owner's lock between reserve and commit.
+#define IOSUHAX_PAGE_SIZE 0x4000
+
+typedef struct _iosuhax_page_t {
+    uint32_t entryId;
+    uint32_t index;
+    uint32_t len;        // valid bytes, less than IOSUHAX_PAGE_SIZE for the last page of a file
+    uint32_t generation; // generation of the entry id when the page was reserved
+    uint8_t *data;
+    struct _iosuhax_page_t *hashNext;
+    struct _iosuhax_page_t *lruPrev;
+    struct _iosuhax_page_t *lruNext;
+} iosuhax_page_t;
+
+typedef struct _iosuhax_page_cache_t iosuhax_page_cache_t;
+
+//! the whole budget is allocated up front, returns NULL if it is smaller than one page
+iosuhax_page_cache_t *iosuhax_page_cache_create(uint32_t budget);
+
+void iosuhax_page_cache_destroy(iosuhax_page_cache_t *cache);
+
+//! returns NULL if the page is not cached or was invalidated
+iosuhax_page_t *iosuhax_page_cache_lookup(iosuhax_page_cache_t *cache, uint32_t entryId, uint32_t index);
+
+//! Takes the least recently used page for new data. It is not found by lookups until it is committed.
+//! Returns NULL if every page is reserved.
+iosuhax_page_t *iosuhax_page_cache_reserve(iosuhax_page_cache_t *cache, uint32_t entryId, uint32_t index);
+
+//! Makes a reserved page visible, returns 0 if it was given back unused instead. That happens for len == 0,
+//! if the file was invalidated since the reserve or if another reservation already committed the page.
+int iosuhax_page_cache_commit(iosuhax_page_cache_t *cache, iosuhax_page_t *page, uint32_t len);
+
+//! Drops all pages of a file, also pages reserved before and committed after. Runs in constant time,
+//! stale pages are given back by the lookups that find them. Files whose entry ids share a generation
+//! slot are dropped as well.
+void iosuhax_page_cache_invalidate(iosuhax_page_cache_t *cache, uint32_t entryId);
+
+void iosuhax_page_cache_get_stats(iosuhax_page_cache_t *cache, uint32_t *hits, uint32_t *misses, uint32_t *evictions);
+
+void iosuhax_page_cache_reset_stats(iosuhax_page_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __IOSUHAX_PAGE_CACHE_H_
@@ -0,0 +1,299 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax_stat_cache.h"
+#include <coreinit/time.h>
+#include <malloc.h>
+#include <string.h>
+
+typedef struct _stat_cache_entry_t {
+    uint32_t hash;
+    uint32_t pathLen; // 0 for unused entries
+    int negative;     // the path does not exist, stat is not valid
+    OSTime stamp;     // time of the insert, for the TTL
+    FSStat stat;
+    struct _stat_cache_entry_t *hashNext;
+    struct _stat_cache_entry_t *idNext; // chain of cache->idBuckets, only entries with a stat are on one
+    struct _stat_cache_entry_t *lruPrev;
+    struct _stat_cache_entry_t *lruNext;
+    char path[IOSUHAX_STAT_CACHE_PATH_MAX];
+} stat_cache_entry_t;
+
+struct _iosuhax_stat_cache_t {
+    stat_cache_entry_t *entries;
+    uint32_t entryCount;
+    stat_cache_entry_t **buckets;
+    stat_cache_entry_t **idBuckets; // by stat.entryId, for writes through an open handle
+    uint32_t bucketMask;            // of both bucket arrays
+    stat_cache_entry_t *lruHead; // most recently used
+    stat_cache_entry_t *lruTail; // replaced next
+    OSTime ttl;                  // 0 = entries do not expire
+    uint32_t hits;
+    uint32_t negativeHits;
+    uint32_t misses;
+};
+
+static uint32_t stat_cache_hash(const char *path, uint32_t path_len) {
+    uint32_t hash = 0x811C9DC5;
+    for (uint32_t i = 0; i < path_len; i++)
+        hash = (hash ^ (uint8_t) path[i]) * 0x01000193;
+    return hash;
+}
+
+static uint32_t stat_cache_id_bucket(iosuhax_stat_cache_t *cache, uint32_t entryId) {
+    uint32_t hash = entryId * 0x9E3779B1;
+    return (hash ^ (hash >> 16)) & cache->bucketMask;
+}
+
+static void stat_cache_id_link(iosuhax_stat_cache_t *cache, stat_cache_entry_t *entry) {
+    uint32_t bucket          = stat_cache_id_bucket(cache, entry->stat.entryId);
+    entry->idNext            = cache->idBuckets[bucket];
+    cache->idBuckets[bucket] = entry;
+}
+
+static void stat_cache_id_unlink(iosuhax_stat_cache_t *cache, stat_cache_entry_t *entry) {
+    if (!entry->pathLen || entry->negative)
+        return;
+
+    stat_cache_entry_t **link = &cache->idBuckets[stat_cache_id_bucket(cache, entry->stat.entryId)];
+    while (*link) {
+        if (*link == entry) {
+            *link = entry->idNext;
+            break;
+        }
+        link = &(*link)->idNext;
+    }
+    entry->idNext = NULL;
+}
+
+static void stat_cache_lru_unlink(iosuhax_stat_cache_t *cache, stat_cache_entry_t *entry) {
+    if (entry->lruPrev)
+        entry->lruPrev->lruNext = entry->lruNext;
+    else
+        cache->lruHead = entry->lruNext;
+
+    if (entry->lruNext)
+        entry->lruNext->lruPrev = entry->lruPrev;
+    else
+        cache->lruTail = entry->lruPrev;
+
+    entry->lruPrev = NULL;
+    entry->lruNext = NULL;
+}
+
+static void stat_cache_lru_push_front(iosuhax_stat_cache_t *cache, stat_cache_entry_t *entry) {
+    entry->lruPrev = NULL;
+    entry->lruNext = cache->lruHead;
+    if (cache->lruHead)
+        cache->lruHead->lruPrev = entry;
+    else
+        cache->lruTail = entry;
+    cache->lruHead = entry;
+}
+
+static void stat_cache_lru_push_back(iosuhax_stat_cache_t *cache, stat_cache_entry_t *entry) {
+    entry->lruNext = NULL;
+    entry->lruPrev = cache->lruTail;
+    if (cache->lruTail)
+        cache->lruTail->lruNext = entry;
+    else
+        cache->lruHead = entry;
+    cache->lruTail = entry;
+}
+
+//! unlinks the entry from its buckets and queues it for reuse
+static void stat_cache_drop(iosuhax_stat_cache_t *cache, stat_cache_entry_t *entry) {
+    stat_cache_id_unlink(cache, entry);
+
+    stat_cache_entry_t **link = &cache->buckets[entry->hash & cache->bucketMask];
+    while (*link) {
+        if (*link == entry) {
+            *link = entry->hashNext;
+            break;
+        }
+        link = &(*link)->hashNext;
+    }
+    entry->hashNext = NULL;
+    entry->pathLen  = 0;
+
+    stat_cache_lru_unlink(cache, entry);
+    stat_cache_lru_push_back(cache, entry);
+}
+
+static stat_cache_entry_t *stat_cache_find(iosuhax_stat_cache_t *cache, const char *path, uint32_t path_len, uint32_t hash) {
+    stat_cache_entry_t *entry = cache->buckets[hash & cache->bucketMask];
+    while (entry) {
+        if (entry->hash == hash && entry->pathLen == path_len && memcmp(entry->path, path, path_len) == 0)
+            return entry;
+        entry = entry->hashNext;
+    }
+    return NULL;
+}
+
+iosuhax_stat_cache_t *iosuhax_stat_cache_create(uint32_t entry_cnt, uint32_t ttl_ms) {
+    if (entry_cnt == 0)
+        return NULL;
+
+    uint32_t bucketCount = 1;
+    while (bucketCount < entry_cnt)
+        bucketCount <<= 1;
+
+    iosuhax_stat_cache_t *cache = (iosuhax_stat_cache_t *) malloc(sizeof(iosuhax_stat_cache_t));
+    if (!cache)
+        return NULL;
+
+    memset(cache, 0, sizeof(iosuhax_stat_cache_t));
+
+    cache->entries = (stat_cache_entry_t *) malloc(sizeof(stat_cache_entry_t) * entry_cnt);
+    cache->buckets   = (stat_cache_entry_t **) malloc(sizeof(stat_cache_entry_t *) * bucketCount);
+    cache->idBuckets = (stat_cache_entry_t **) malloc(sizeof(stat_cache_entry_t *) * bucketCount);
+    if (!cache->entries || !cache->buckets || !cache->idBuckets) {
+        iosuhax_stat_cache_destroy(cache);
+        return NULL;
+    }
+
+    memset(cache->entries, 0, sizeof(stat_cache_entry_t) * entry_cnt);
+    memset(cache->buckets, 0, sizeof(stat_cache_entry_t *) * bucketCount);
+    memset(cache->idBuckets, 0, sizeof(stat_cache_entry_t *) * bucketCount);
+    cache->entryCount = entry_cnt;
+    cache->bucketMask = bucketCount - 1;
+    cache->ttl        = ttl_ms ? OSMillisecondsToTicks((OSTime) ttl_ms) : 0;
+
+    for (uint32_t i = 0; i < entry_cnt; i++)
+        stat_cache_lru_push_back(cache, &cache->entries[i]);
+
+    return cache;
+}
+
+void iosuhax_stat_cache_destroy(iosuhax_stat_cache_t *cache) {
+    if (!cache)
+        return;
+
+    if (cache->buckets)
+        free(cache->buckets);
+    if (cache->idBuckets)
+        free(cache->idBuckets);
+    if (cache->entries)
+        free(cache->entries);
+    free(cache);
+}
+
+int iosuhax_stat_cache_lookup(iosuhax_stat_cache_t *cache, const char *path, uint32_t path_len, FSStat *out_stat) {
+    stat_cache_entry_t *entry = NULL;
+    if (path_len <= IOSUHAX_STAT_CACHE_PATH_MAX)
+        entry = stat_cache_find(cache, path, path_len, stat_cache_hash(path, path_len));
+
+    if (entry && cache->ttl && OSGetSystemTime() - entry->stamp > cache->ttl) {
+        stat_cache_drop(cache, entry);
+        entry = NULL;
+    }
+
+    if (!entry) {
+        cache->misses++;
+        return 0;
+    }
+
+    stat_cache_lru_unlink(cache, entry);
+    stat_cache_lru_push_front(cache, entry);
+
+    if (entry->negative) {
+        cache->negativeHits++;
+        return -1;
+    }
+
+    cache->hits++;
+    memcpy(out_stat, &entry->stat, sizeof(FSStat));
+    return 1;
+}
+
+void iosuhax_stat_cache_insert(iosuhax_stat_cache_t *cache, const char *path, uint32_t path_len, const FSStat *stat) {
+    if (path_len == 0 || path_len > IOSUHAX_STAT_CACHE_PATH_MAX)
+        return;
+
+    uint32_t hash             = stat_cache_hash(path, path_len);
+    stat_cache_entry_t *entry = stat_cache_find(cache, path, path_len, hash);
+    if (entry) {
+        stat_cache_id_unlink(cache, entry);
+        stat_cache_lru_unlink(cache, entry);
+    } else {
+        entry = cache->lruTail;
+        if (entry->pathLen)
+            stat_cache_drop(cache, entry);
+
+        stat_cache_lru_unlink(cache, entry);
+        entry->hash    = hash;
+        entry->pathLen = path_len;
+        memcpy(entry->path, path, path_len);
+
+        uint32_t bucket        = hash & cache->bucketMask;
+        entry->hashNext        = cache->buckets[bucket];
+        cache->buckets[bucket] = entry;
+    }
+
+    entry->negative = (stat == NULL);
+    entry->stamp    = OSGetSystemTime();
+    if (stat) {
+        memcpy(&entry->stat, stat, sizeof(FSStat));
+        stat_cache_id_link(cache, entry);
+    }
+
+    stat_cache_lru_push_front(cache, entry);
+}
+
+void iosuhax_stat_cache_invalidate(iosuhax_stat_cache_t *cache, const char *path, uint32_t path_len) {
+    if (path_len > IOSUHAX_STAT_CACHE_PATH_MAX)
+        return;
+
+    stat_cache_entry_t *entry = stat_cache_find(cache, path, path_len, stat_cache_hash(path, path_len));
+    if (entry)
+        stat_cache_drop(cache, entry);
+}
+
+void iosuhax_stat_cache_invalidate_entry(iosuhax_stat_cache_t *cache, uint32_t entryId) {
+    stat_cache_entry_t *entry = cache->idBuckets[stat_cache_id_bucket(cache, entryId)];
+    while (entry) {
+        stat_cache_entry_t *next = entry->idNext;
+        if (entry->stat.entryId == entryId)
+            stat_cache_drop(cache, entry);
+        entry = next;
+    }
+}
+
+void iosuhax_stat_cache_clear(iosuhax_stat_cache_t *cache) {
+    for (uint32_t i = 0; i < cache->entryCount; i++) {
+        if (cache->entries[i].pathLen)
+            stat_cache_drop(cache, &cache->entries[i]);
+    }
+}
+
+void iosuhax_stat_cache_get_stats(iosuhax_stat_cache_t *cache, uint32_t *hits, uint32_t *negative_hits, uint32_t *misses) {
+    *hits          = cache->hits;
+    *negative_hits = cache->negativeHits;
+    *misses        = cache->misses;
+}
+
+void iosuhax_stat_cache_reset_stats(iosuhax_stat_cache_t *cache) {
+    cache->hits         = 0;
+    cache->negativeHits = 0;
+    cache->misses       = 0;
+}
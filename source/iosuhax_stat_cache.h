@@ -0,0 +1,43 @@
+#ifndef __IOSUHAX_STAT_CACHE_H_
+#define __IOSUHAX_STAT_CACHE_H_
+
+#include <coreinit/filesystem.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! FSStat results by path, including paths known not to exist. The least recently used entry is
+//! replaced first. The cache does no locking, the owner has to serialize all calls.
+#define IOSUHAX_STAT_CACHE_PATH_MAX 0x100 // longer paths are not cached
+
+typedef struct _iosuhax_stat_cache_t iosuhax_stat_cache_t;
+
+//! ttl_ms == 0 keeps entries until they are invalidated or replaced, returns NULL if entry_cnt is 0
+iosuhax_stat_cache_t *iosuhax_stat_cache_create(uint32_t entry_cnt, uint32_t ttl_ms);
+
+void iosuhax_stat_cache_destroy(iosuhax_stat_cache_t *cache);
+
+//! returns 1 and fills out_stat if the path is cached, -1 if it is cached as missing, 0 if it is not cached
+int iosuhax_stat_cache_lookup(iosuhax_stat_cache_t *cache, const char *path, uint32_t path_len, FSStat *out_stat);
+
+//! stat == NULL records the path as missing
+void iosuhax_stat_cache_insert(iosuhax_stat_cache_t *cache, const char *path, uint32_t path_len, const FSStat *stat);
+
+void iosuhax_stat_cache_invalidate(iosuhax_stat_cache_t *cache, const char *path, uint32_t path_len);
+
+//! drops every entry that refers to the given file, for writes through an open handle
+void iosuhax_stat_cache_invalidate_entry(iosuhax_stat_cache_t *cache, uint32_t entryId);
+
+void iosuhax_stat_cache_clear(iosuhax_stat_cache_t *cache);
+
+void iosuhax_stat_cache_get_stats(iosuhax_stat_cache_t *cache, uint32_t *hits, uint32_t *negative_hits, uint32_t *misses);
+
+void iosuhax_stat_cache_reset_stats(iosuhax_stat_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __IOSUHAX_STAT_CACHE_H_
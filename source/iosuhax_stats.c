@@ -0,0 +1,121 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax_stats.h"
+#include "iosuhax.h"
+#include <string.h>
+
+#ifdef IOSUHAX_ENABLE_STATS
+
+//! 64 bit counter made of two words, the PPC has no 64 bit atomics
+typedef struct _stats_counter64_t {
+    volatile uint32_t hi;
+    volatile uint32_t lo;
+} stats_counter64_t;
+
+typedef struct _stats_entry_t {
+    volatile uint32_t calls;
+    volatile uint32_t errors;
+    volatile uint32_t allocs;
+    stats_counter64_t bytes_in;
+    stats_counter64_t bytes_out;
+    volatile uint32_t latency[IOSUHAX_STATS_LATENCY_BUCKETS];
+} stats_entry_t;
+
+static stats_entry_t statsEntries[IOSUHAX_STATS_REQUEST_COUNT];
+
+static void stats_add64(stats_counter64_t *counter, uint32_t value) {
+    uint32_t old = __atomic_fetch_add(&counter->lo, value, __ATOMIC_RELAXED);
+    if (old + value < old)
+        __atomic_fetch_add(&counter->hi, 1, __ATOMIC_RELAXED);
+}
+
+static uint64_t stats_load64(stats_counter64_t *counter) {
+    uint32_t hi, lo;
+    do {
+        hi = __atomic_load_n(&counter->hi, __ATOMIC_RELAXED);
+        lo = __atomic_load_n(&counter->lo, __ATOMIC_RELAXED);
+    } while (hi != __atomic_load_n(&counter->hi, __ATOMIC_RELAXED));
+    return ((uint64_t) hi << 32) | lo;
+}
+
+void iosuhax_stats_record(uint32_t request, int failed, uint32_t bytes_in, uint32_t bytes_out, OSTime ticks) {
+    if (request >= IOSUHAX_STATS_REQUEST_COUNT)
+        return;
+
+    stats_entry_t *entry = &statsEntries[request];
+
+    __atomic_fetch_add(&entry->calls, 1, __ATOMIC_RELAXED);
+    if (failed)
+        __atomic_fetch_add(&entry->errors, 1, __ATOMIC_RELAXED);
+
+    stats_add64(&entry->bytes_in, bytes_in);
+    stats_add64(&entry->bytes_out, bytes_out);
+
+    // bucket n holds latencies from 2^n up to 2^(n+1) microseconds
+    uint64_t us   = ticks > 0 ? OSTicksToMicroseconds(ticks) : 0;
+    uint32_t slot = 0;
+    while ((us >>= 1) != 0 && slot < IOSUHAX_STATS_LATENCY_BUCKETS - 1)
+        slot++;
+
+    __atomic_fetch_add(&entry->latency[slot], 1, __ATOMIC_RELAXED);
+}
+
+void iosuhax_stats_count_alloc(uint32_t request) {
+    if (request < IOSUHAX_STATS_REQUEST_COUNT)
+        __atomic_fetch_add(&statsEntries[request].allocs, 1, __ATOMIC_RELAXED);
+}
+
+int IOSUHAX_GetStats(uint32_t request, IOSUHAX_IoctlStats *stats) {
+    if (request >= IOSUHAX_STATS_REQUEST_COUNT || !stats)
+        return -1;
+
+    stats_entry_t *entry = &statsEntries[request];
+
+    stats->calls     = __atomic_load_n(&entry->calls, __ATOMIC_RELAXED);
+    stats->errors    = __atomic_load_n(&entry->errors, __ATOMIC_RELAXED);
+    stats->allocs    = __atomic_load_n(&entry->allocs, __ATOMIC_RELAXED);
+    stats->bytes_in  = stats_load64(&entry->bytes_in);
+    stats->bytes_out = stats_load64(&entry->bytes_out);
+    for (int i = 0; i < IOSUHAX_STATS_LATENCY_BUCKETS; i++) {
+        stats->latency[i] = __atomic_load_n(&entry->latency[i], __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+void IOSUHAX_ResetStats(void) {
+    // requests running concurrently may be partly counted in the old and the new period
+    memset((void *) statsEntries, 0, sizeof(statsEntries));
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#else
+
+int IOSUHAX_GetStats(uint32_t request, IOSUHAX_IoctlStats *stats) {
+    return -1;
+}
+
+void IOSUHAX_ResetStats(void) {
+}
+
+#endif
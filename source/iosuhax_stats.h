@@ -0,0 +1,106 @@
+#ifndef __IOSUHAX_STATS_H_
+#define __IOSUHAX_STATS_H_
+
+#include "iosuhax_buffer_pool.h"
+#include "iosuhax_ipc.h"
+#include "os_functions.h"
+#include <stdint.h>
+
+#if defined(IOSUHAX_ENABLE_STATS) || defined(IOSUHAX_ENABLE_TRACE)
+#include <coreinit/time.h>
+#define IOSUHAX_INSTRUMENTED
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! All requests to /dev/iosuhax go through these wrappers. Unless the library is built with
+//! IOSUHAX_ENABLE_STATS or IOSUHAX_ENABLE_TRACE they are plain calls to IOS_Ioctl/IOS_Ioctlv and the buffer pool.
+
+#ifdef IOSUHAX_ENABLE_STATS
+void iosuhax_stats_record(uint32_t request, int failed, uint32_t bytes_in, uint32_t bytes_out, OSTime ticks);
+
+void iosuhax_stats_count_alloc(uint32_t request);
+
+//! the first output word (or vector) of every FSA request is the FSA result
+static inline int iosuhax_stats_failed(uint32_t request, int res, const void *result) {
+    return res < 0 || (request >= 0x40 && result && *(const int *) result < 0);
+}
+#endif
+
+#ifdef IOSUHAX_ENABLE_TRACE
+//! set between IOSUHAX_TraceStart and IOSUHAX_TraceStop
+extern volatile uint32_t iosuhaxTraceActive;
+
+void iosuhax_trace_record(uint32_t request, int res, const ios_vec_t *vecs, uint32_t vec_in, uint32_t vec_out, OSTime start, OSTime end);
+#endif
+
+#ifdef IOSUHAX_INSTRUMENTED
+static inline void iosuhax_instrument(uint32_t request, int res, const ios_vec_t *vecs, uint32_t vec_in, uint32_t vec_out, OSTime start, OSTime end) {
+#ifdef IOSUHAX_ENABLE_STATS
+    uint32_t bytes_in = 0, bytes_out = 0;
+    for (uint32_t i = 0; i < vec_in + vec_out; i++) {
+        if (i < vec_in)
+            bytes_in += vecs[i].len;
+        else
+            bytes_out += vecs[i].len;
+    }
+    const void *result = (vec_out && vecs[vec_in].len >= 4) ? vecs[vec_in].vaddr : 0;
+    iosuhax_stats_record(request, iosuhax_stats_failed(request, res, result), bytes_in, bytes_out, end - start);
+#endif
+#ifdef IOSUHAX_ENABLE_TRACE
+    if (__atomic_load_n(&iosuhaxTraceActive, __ATOMIC_RELAXED))
+        iosuhax_trace_record(request, res, vecs, vec_in, vec_out, start, end);
+#endif
+}
+#endif
+
+static inline int iosuhax_ioctl(int handle, uint32_t request, void *in, uint32_t in_size, void *out, uint32_t out_size) {
+    if (iosuhax_transport_enter(handle) < 0)
+        return -1;
+
+#ifdef IOSUHAX_INSTRUMENTED
+    OSTime start = OSGetSystemTime();
+    int res      = IOS_Ioctl(handle, request, in, in_size, out, out_size);
+    OSTime end   = OSGetSystemTime();
+
+    ios_vec_t vecs[2] = {{0, in_size, in}, {0, out_size, out}};
+    iosuhax_instrument(request, res, vecs, 1, 1, start, end);
+#else
+    int res = IOS_Ioctl(handle, request, in, in_size, out, out_size);
+#endif
+
+    iosuhax_transport_leave();
+    return res;
+}
+
+static inline int iosuhax_ioctlv(int handle, uint32_t request, uint32_t vec_in, uint32_t vec_out, ios_vec_t *vecs) {
+    if (iosuhax_transport_enter(handle) < 0)
+        return -1;
+
+#ifdef IOSUHAX_INSTRUMENTED
+    OSTime start = OSGetSystemTime();
+    int res      = IOS_Ioctlv(handle, request, vec_in, vec_out, vecs);
+    iosuhax_instrument(request, res, vecs, vec_in, vec_out, start, OSGetSystemTime());
+#else
+    int res = IOS_Ioctlv(handle, request, vec_in, vec_out, vecs);
+#endif
+
+    iosuhax_transport_leave();
+    return res;
+}
+
+//! staging buffer for one request, counted in the allocations of that request
+static inline void *iosuhax_request_alloc(uint32_t request, uint32_t size) {
+#ifdef IOSUHAX_ENABLE_STATS
+    iosuhax_stats_count_alloc(request);
+#endif
+    return iosuhax_buffer_alloc(size);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __IOSUHAX_STATS_H_
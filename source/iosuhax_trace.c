@@ -0,0 +1,144 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax.h"
+#include "iosuhax_stats.h"
+#include <coreinit/thread.h>
+#include <stdbool.h>
+
+#ifdef IOSUHAX_ENABLE_TRACE
+
+#define FNV_OFFSET_BASIS 0x811C9DC5
+#define FNV_PRIME        0x01000193
+
+volatile uint32_t iosuhaxTraceActive = 0;
+
+static IOSUHAX_TraceRecord *traceRecords;
+static uint32_t traceCapacity;
+static uint32_t traceFlags;
+static OSTime traceStart;
+static volatile uint32_t traceNext;
+//! records being written, IOSUHAX_TraceStop waits for them before the buffer goes back to the caller
+static volatile uint32_t traceWriters;
+
+static uint32_t trace_hash(uint32_t hash, const ios_vec_t *vec) {
+    const uint8_t *data = (const uint8_t *) vec->vaddr;
+    if (!data)
+        return hash;
+
+    for (uint32_t i = 0; i < vec->len; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static void trace_write(uint32_t request, int res, const ios_vec_t *vecs, uint32_t vec_in, uint32_t vec_out, OSTime start, OSTime end) {
+    // slots are claimed up front so concurrent requests never share a record
+    uint32_t slot = __atomic_fetch_add(&traceNext, 1, __ATOMIC_RELAXED);
+    if (slot >= traceCapacity)
+        return;
+
+    IOSUHAX_TraceRecord *record = &traceRecords[slot];
+    record->request             = request;
+    record->in_size             = 0;
+    record->out_size            = 0;
+    record->result              = res;
+    record->start_us            = (uint32_t) OSTicksToMicroseconds(start - traceStart);
+    record->time_us             = (uint32_t) OSTicksToMicroseconds(end - start);
+    record->in_hash             = 0;
+    record->out_hash            = 0;
+
+    bool hash         = (traceFlags & IOSUHAX_TRACE_HASH_PAYLOAD) != 0;
+    uint32_t in_hash  = FNV_OFFSET_BASIS;
+    uint32_t out_hash = FNV_OFFSET_BASIS;
+
+    for (uint32_t i = 0; i < vec_in + vec_out; i++) {
+        if (i < vec_in) {
+            record->in_size += vecs[i].len;
+            if (hash)
+                in_hash = trace_hash(in_hash, &vecs[i]);
+        } else {
+            record->out_size += vecs[i].len;
+            if (hash && res >= 0)
+                out_hash = trace_hash(out_hash, &vecs[i]);
+        }
+    }
+
+    if (hash) {
+        record->in_hash  = in_hash;
+        record->out_hash = out_hash;
+    }
+}
+
+void iosuhax_trace_record(uint32_t request, int res, const ios_vec_t *vecs, uint32_t vec_in, uint32_t vec_out, OSTime start, OSTime end) {
+    // announce the writer before checking the flag again, either IOSUHAX_TraceStop sees it or the writer sees the cleared flag
+    __atomic_fetch_add(&traceWriters, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&iosuhaxTraceActive, __ATOMIC_SEQ_CST))
+        trace_write(request, res, vecs, vec_in, vec_out, start, end);
+    __atomic_fetch_sub(&traceWriters, 1, __ATOMIC_RELEASE);
+}
+
+int IOSUHAX_TraceStart(IOSUHAX_TraceRecord *buffer, uint32_t max_records, uint32_t flags) {
+    if (!buffer || max_records == 0 || __atomic_load_n(&iosuhaxTraceActive, __ATOMIC_ACQUIRE))
+        return -1;
+
+    traceRecords  = buffer;
+    traceCapacity = max_records;
+    traceFlags    = flags;
+    traceStart    = OSGetSystemTime();
+    __atomic_store_n(&traceNext, 0, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&iosuhaxTraceActive, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int IOSUHAX_TraceStop(uint32_t *dropped) {
+    if (!__atomic_load_n(&iosuhaxTraceActive, __ATOMIC_ACQUIRE))
+        return -1;
+
+    __atomic_store_n(&iosuhaxTraceActive, 0, __ATOMIC_SEQ_CST);
+
+    // requests that saw the flag still set are finishing their record
+    while (__atomic_load_n(&traceWriters, __ATOMIC_ACQUIRE) != 0)
+        OSYieldThread();
+
+    uint32_t count = __atomic_load_n(&traceNext, __ATOMIC_RELAXED);
+    if (dropped)
+        *dropped = count > traceCapacity ? count - traceCapacity : 0;
+
+    return count > traceCapacity ? traceCapacity : count;
+}
+
+#else
+
+int IOSUHAX_TraceStart(IOSUHAX_TraceRecord *buffer, uint32_t max_records, uint32_t flags) {
+    return -1;
+}
+
+int IOSUHAX_TraceStop(uint32_t *dropped) {
+    if (dropped)
+        *dropped = 0;
+    return -1;
+}
+
+#endif
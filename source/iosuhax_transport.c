@@ -0,0 +1,175 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax.h"
+#include "iosuhax_buffer_pool.h"
+#include "iosuhax_ipc.h"
+#include "os_functions.h"
+#include <coreinit/core.h>
+#include <coreinit/thread.h>
+#include <stdbool.h>
+
+#define TRANSPORT_UNINITIALIZED 0
+#define TRANSPORT_INITIALIZING  1
+#define TRANSPORT_READY         2
+
+typedef struct _transport_context_t {
+    int handle;
+} transport_context_t;
+
+static transport_context_t transportContexts[IOSUHAX_MAX_HANDLES];
+
+//! number of usable contexts, only published after all of them are opened
+static volatile uint32_t transportContextCount = 0;
+
+//! requests between iosuhax_transport_enter and iosuhax_transport_leave, IOSUHAX_Close waits for them to finish
+static volatile uint32_t transportUsers = 0;
+
+static volatile uint32_t transportState = TRANSPORT_UNINITIALIZED;
+static uint32_t transportMutex[(OS_MUTEX_SIZE + 3) >> 2];
+
+//! The transport mutex can't be initialized statically, the first caller does it while the others wait.
+static void transport_init_once(void) {
+    uint32_t expected = TRANSPORT_UNINITIALIZED;
+    if (__atomic_compare_exchange_n(&transportState, &expected, TRANSPORT_INITIALIZING, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        OSInitMutex(transportMutex);
+        iosuhax_buffer_pool_init();
+        __atomic_store_n(&transportState, TRANSPORT_READY, __ATOMIC_RELEASE);
+        return;
+    }
+
+    while (__atomic_load_n(&transportState, __ATOMIC_ACQUIRE) != TRANSPORT_READY)
+        OSYieldThread();
+}
+
+int iosuhax_get_handle(void) {
+    uint32_t count = __atomic_load_n(&transportContextCount, __ATOMIC_ACQUIRE);
+    if (count == 0)
+        return -1;
+
+    // each core gets its own handle so requests from different cores don't share one
+    return transportContexts[OSGetCoreId() % count].handle;
+}
+
+int iosuhax_transport_enter(int handle) {
+    // counted before the handles are checked, IOSUHAX_Close clears them before it looks at the count
+    __atomic_fetch_add(&transportUsers, 1, __ATOMIC_SEQ_CST);
+
+    uint32_t count = __atomic_load_n(&transportContextCount, __ATOMIC_SEQ_CST);
+    for (uint32_t i = 0; i < count; i++) {
+        if (transportContexts[i].handle == handle)
+            return 0;
+    }
+
+    // closed since the caller fetched it
+    __atomic_fetch_sub(&transportUsers, 1, __ATOMIC_RELEASE);
+    return -1;
+}
+
+void iosuhax_transport_leave(void) {
+    __atomic_fetch_sub(&transportUsers, 1, __ATOMIC_RELEASE);
+}
+
+int IOSUHAX_OpenEx(const char *dev, uint32_t handle_cnt) {
+    transport_init_once();
+
+    if (handle_cnt == 0)
+        handle_cnt = 1;
+    if (handle_cnt > IOSUHAX_MAX_HANDLES)
+        handle_cnt = IOSUHAX_MAX_HANDLES;
+
+    OSLockMutex(transportMutex);
+
+    if (transportContextCount > 0) {
+        int handle = transportContexts[0].handle;
+        OSUnlockMutex(transportMutex);
+        return handle;
+    }
+
+    char *path = (char *) (dev ? dev : "/dev/iosuhax");
+
+    int handle = IOS_Open(path, 0);
+    if (handle >= 0 && dev) //make sure device is actually iosuhax
+    {
+        ALIGN_0x20 int res[0x20 >> 2];
+        *res = 0;
+
+        IOS_Ioctl(handle, IOCTL_CHECK_IF_IOSUHAX, (void *) 0, 0, res, 4);
+        if (*res != IOSUHAX_MAGIC_WORD) {
+            IOS_Close(handle);
+            handle = -1;
+        }
+    }
+
+    if (handle < 0) {
+        OSUnlockMutex(transportMutex);
+        return handle;
+    }
+
+    transportContexts[0].handle = handle;
+
+    uint32_t count = 1;
+    while (count < handle_cnt) {
+        int extra = IOS_Open(path, 0);
+        if (extra < 0)
+            break;
+
+        transportContexts[count++].handle = extra;
+    }
+
+    __atomic_store_n(&transportContextCount, count, __ATOMIC_RELEASE);
+
+    OSUnlockMutex(transportMutex);
+    return handle;
+}
+
+int IOSUHAX_Open(const char *dev) {
+    return IOSUHAX_OpenEx(dev, 1);
+}
+
+int IOSUHAX_Close(void) {
+    transport_init_once();
+
+    OSLockMutex(transportMutex);
+
+    uint32_t count = transportContextCount;
+    if (count == 0) {
+        OSUnlockMutex(transportMutex);
+        return 0;
+    }
+
+    // stop handing out handles, then wait for the requests that already use one, async ones included
+    __atomic_store_n(&transportContextCount, 0, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&transportUsers, __ATOMIC_SEQ_CST))
+        OSYieldThread();
+
+    int res = IOS_Close(transportContexts[0].handle);
+    for (uint32_t i = 1; i < count; i++) {
+        IOS_Close(transportContexts[i].handle);
+    }
+
+    iosuhax_buffer_pool_clear();
+
+    OSUnlockMutex(transportMutex);
+    return res;
+}
@@ -5,7 +5,17 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 #define OS_MUTEX_SIZE 44
+#define OS_COND_SIZE  28
+
+//! layout of IOSVec as used by IOS_Ioctlv
+typedef struct _ios_vec_t {
+    void *paddr;
+    uint32_t len;
+    void *vaddr;
+} ios_vec_t;
 
 //!----------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 //! Mutex functions
@@ -16,11 +26,27 @@ extern void OSLockMutex(void *mutex);
 
 extern void OSUnlockMutex(void *mutex);
 
+extern int OSTryLockMutex(void *mutex);
+
+extern void OSInitCond(void *cond);
+
+extern void OSWaitCond(void *cond, void *mutex);
+
+extern void OSSignalCond(void *cond);
+
 //!----------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 //! IOS function
 //!----------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 extern int IOS_Ioctl(int fd, unsigned int request, void *input_buffer, unsigned int input_buffer_len, void *output_buffer, unsigned int output_buffer_len);
 
+typedef void (*ios_async_callback_t)(int error, void *context);
+
+extern int IOS_IoctlAsync(int fd, unsigned int request, void *input_buffer, unsigned int input_buffer_len, void *output_buffer, unsigned int output_buffer_len, ios_async_callback_t callback, void *context);
+
+extern int IOS_Ioctlv(int fd, unsigned int request, unsigned int vector_count_in, unsigned int vector_count_out, ios_vec_t *vector);
+
+extern int IOS_IoctlvAsync(int fd, unsigned int request, unsigned int vector_count_in, unsigned int vector_count_out, ios_vec_t *vector, ios_async_callback_t callback, void *context);
+
 extern int IOS_Open(char *path, unsigned int mode);
 
 extern int IOS_Close(int fd);
@@ -0,0 +1,1304 @@
+/***************************************************************************
+ * Copyright (C) 2016
+ * by Dimok
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any
+ * purpose, including commercial applications, and to alter it and
+ * redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you
+ * must not claim that you wrote the original software. If you use
+ * this software in a product, an acknowledgment in the product
+ * documentation would be appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and
+ * must not be misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ***************************************************************************/
+#include "iosuhax.h"
+#include "iosuhax_devoptab.h"
+#include "iosuhax_disc_interface.h"
+#include "iosuhax_host.h"
+#include "iosuhax_ipc.h"
+#include "os_functions.h"
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+//! Microbenchmarks for the public entry points, run against the host IOSU emulator.
+//!
+//! Every measurement prints one CSV line:
+//!   case,variant,size,path_len,align,threads,ops,seconds,ops_per_sec,mib_per_sec,avg_us,note
+//! 'size' is the payload per call, 'align' the offset of the caller buffer from a 0x40 boundary,
+//! 'avg_us' the wall time per call and thread. 'note' carries case specific counters.
+
+#define BENCH_VOLUME       "/vol/bench"
+#define BENCH_DEVICE       "/dev/sdcard01"
+#define BENCH_FILE_SIZE    (8 * 1024 * 1024)
+#define BENCH_IMAGE_SIZE   (64 * 1024 * 1024)
+#define BENCH_LARGE_SIZE   (5ull * 1024 * 1024 * 1024)
+#define BENCH_LARGE_BASE   (1ull << 32)
+#define BENCH_STAT_FILES   64
+#define BENCH_PATH_MAX     0x27F
+#define BENCH_LIST_MAX     16
+#define BENCH_THREADS_MAX  16
+#define BENCH_BUFFER_SLACK 0x40
+
+typedef struct {
+    uint32_t values[BENCH_LIST_MAX];
+    uint32_t count;
+} bench_list_t;
+
+typedef struct _bench_ctx_t {
+    int fsaFd;
+    int fileHandle;
+    int dirHandle;
+    int rawHandle;
+    uint32_t size;
+    uint32_t align;
+    uint32_t pathLen;
+    uint32_t counter;
+    uint8_t *buffer; // BENCH_BUFFER_SLACK + largest size, 0x40 aligned
+    uint8_t *data;   // buffer + align
+    char path[BENCH_PATH_MAX + 1];
+    void *arg;
+} bench_ctx_t;
+
+//! one call of the measured operation, returns a negative value on failure
+typedef int (*bench_op_t)(bench_ctx_t *ctx);
+
+static const char *benchDir;
+static uint32_t benchDurationMs = 200;
+static bench_list_t benchSizes   = {{512, 4096, 65536, 1048576}, 4};
+static bench_list_t benchPaths   = {{32, 64, 255}, 3};
+static bench_list_t benchAligns  = {{0, 4}, 2};
+static bench_list_t benchThreads = {{1, 2, 3, 4}, 4};
+static int benchFsaFd;
+static uint32_t benchMaxSize;
+static uint32_t benchLatency = 20;
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int bench_parse_list(const char *arg, bench_list_t *list) {
+    list->count = 0;
+    while (*arg && list->count < BENCH_LIST_MAX) {
+        char *end;
+        list->values[list->count++] = strtoul(arg, &end, 0);
+        if (end == arg)
+            return -1;
+        arg = (*end == ',') ? end + 1 : end;
+    }
+    return list->count ? 0 : -1;
+}
+
+static void bench_print(const char *name, const char *variant, const bench_ctx_t *ctx, uint32_t threads, uint64_t ops, uint64_t bytes, uint64_t ns, const char *note) {
+    double seconds = ns / 1e9;
+    printf("%s,%s,%u,%u,%u,%u,%llu,%.6f,%.1f,%.2f,%.3f,%s\n", name, variant, ctx->size, ctx->pathLen, ctx->align, threads, (unsigned long long) ops, seconds,
+           seconds > 0 ? ops / seconds : 0.0, seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0, ops ? ns / 1000.0 * threads / ops : 0.0, note ? note : "");
+    fflush(stdout);
+}
+
+//! Runs 'op' for the configured duration, returns the number of calls or 0 if one failed.
+static uint64_t bench_loop(bench_op_t op, bench_ctx_t *ctx, uint64_t *ns) {
+    uint64_t ops   = 0;
+    uint64_t start = bench_now_ns();
+    uint64_t end   = start + (uint64_t) benchDurationMs * 1000000ull;
+    uint64_t now;
+
+    *ns = 0;
+    do {
+        // check the clock every few calls, short calls would otherwise measure clock_gettime
+        for (int i = 0; i < 16; i++) {
+            if (op(ctx) < 0)
+                return 0;
+            ops++;
+        }
+        now = bench_now_ns();
+    } while (now < end);
+
+    *ns = now - start;
+    return ops;
+}
+
+static void bench_run(const char *name, const char *variant, bench_op_t op, bench_ctx_t *ctx, uint32_t bytesPerOp, const char *note) {
+    uint64_t ns;
+    uint64_t ops = bench_loop(op, ctx, &ns);
+    if (ops == 0) {
+        bench_print(name, variant, ctx, 1, 0, 0, 0, "failed");
+        return;
+    }
+    bench_print(name, variant, ctx, 1, ops, ops * bytesPerOp, ns, note);
+}
+
+//! the buffer of an earlier init is kept, a new context has to start zeroed
+static bench_ctx_t *bench_ctx_init(bench_ctx_t *ctx, uint32_t size, uint32_t align) {
+    uint8_t *buffer = ctx->buffer;
+    memset(ctx, 0, sizeof(bench_ctx_t));
+    ctx->fsaFd  = benchFsaFd;
+    ctx->size   = size;
+    ctx->align  = align;
+    ctx->buffer = buffer ? buffer : (uint8_t *) aligned_alloc(0x40, BENCH_BUFFER_SLACK + benchMaxSize);
+    ctx->data = ctx->buffer + align;
+    return ctx;
+}
+
+static void bench_ctx_free(bench_ctx_t *ctx) {
+    free(ctx->buffer);
+    ctx->buffer = NULL;
+}
+
+//! builds a path below the bench volume of exactly 'len' characters (at least the volume prefix and a name)
+static void bench_make_path(char *out, uint32_t len, uint32_t index) {
+    int n = snprintf(out, BENCH_PATH_MAX + 1, BENCH_VOLUME "/f%04u_", index);
+    while ((uint32_t) n < len && n < BENCH_PATH_MAX)
+        out[n++] = 'p';
+    out[n] = 0;
+}
+
+static int bench_create_host_file(const char *relPath, uint64_t size) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", benchDir, relPath);
+    int fd = open(path, O_WRONLY | O_CREAT, 0666);
+    if (fd < 0)
+        return -1;
+    int res = ftruncate(fd, size);
+    close(fd);
+    return res;
+}
+
+//! creates the files GETSTAT and OPENFILE use for every path length
+static int bench_create_path_files(void) {
+    char path[BENCH_PATH_MAX + 1];
+    for (uint32_t p = 0; p < benchPaths.count; p++) {
+        for (uint32_t i = 0; i < BENCH_STAT_FILES; i++) {
+            bench_make_path(path, benchPaths.values[p], i);
+            if (bench_create_host_file(path + strlen(BENCH_VOLUME) + 1, 16) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! api: every function of include/iosuhax.h once per call
+//!----------------------------------------------------------------------------------------------------
+static int op_memwrite(bench_ctx_t *ctx) {
+    return IOSUHAX_memwrite(0x10000000, ctx->data, ctx->size);
+}
+
+static int op_memread(bench_ctx_t *ctx) {
+    return IOSUHAX_memread(0x10000000, ctx->data, ctx->size);
+}
+
+static int op_memcpy(bench_ctx_t *ctx) {
+    return IOSUHAX_memcpy(0x10000000, 0x10000000 + ctx->size, ctx->size);
+}
+
+static int op_kern_write32(bench_ctx_t *ctx) {
+    return IOSUHAX_kern_write32(0x10000000, ctx->counter++);
+}
+
+static int op_kern_read32(bench_ctx_t *ctx) {
+    return IOSUHAX_kern_read32(0x10000000, (uint32_t *) ctx->data, ctx->size / 4);
+}
+
+static int op_read_otp(bench_ctx_t *ctx) {
+    return IOSUHAX_read_otp(ctx->data, 0x400);
+}
+
+static int op_read_seeprom(bench_ctx_t *ctx) {
+    return IOSUHAX_read_seeprom(ctx->data, 0, 0x200);
+}
+
+static int op_svc(bench_ctx_t *ctx) {
+    uint32_t args[2] = {0, 0};
+    IOSUHAX_SVC(0x22, args, 2);
+    return 0;
+}
+
+static int op_fsa_open_close(bench_ctx_t *ctx) {
+    int fd = IOSUHAX_FSA_Open();
+    return fd < 0 ? fd : IOSUHAX_FSA_Close(fd);
+}
+
+static int op_mount_unmount(bench_ctx_t *ctx) {
+    int res = IOSUHAX_FSA_Mount(ctx->fsaFd, BENCH_DEVICE, "/vol/bench_mount", 2, NULL, 0);
+    return res < 0 ? res : IOSUHAX_FSA_Unmount(ctx->fsaFd, "/vol/bench_mount", 2);
+}
+
+static int op_flush_volume(bench_ctx_t *ctx) {
+    return IOSUHAX_FSA_FlushVolume(ctx->fsaFd, BENCH_VOLUME);
+}
+
+static int op_get_device_info(bench_ctx_t *ctx) {
+    return IOSUHAX_FSA_GetDeviceInfo(ctx->fsaFd, BENCH_DEVICE, 0, (uint32_t *) ctx->data);
+}
+
+static int op_makedir_remove(bench_ctx_t *ctx) {
+    int res = IOSUHAX_FSA_MakeDir(ctx->fsaFd, BENCH_VOLUME "/newdir", 0x660);
+    return res < 0 ? res : IOSUHAX_FSA_Remove(ctx->fsaFd, BENCH_VOLUME "/newdir");
+}
+
+static int op_opendir_closedir(bench_ctx_t *ctx) {
+    int handle;
+    int res = IOSUHAX_FSA_OpenDir(ctx->fsaFd, BENCH_VOLUME "/dir", &handle);
+    return res < 0 ? res : IOSUHAX_FSA_CloseDir(ctx->fsaFd, handle);
+}
+
+static int op_readdir(bench_ctx_t *ctx) {
+    int res = IOSUHAX_FSA_ReadDir(ctx->fsaFd, ctx->dirHandle, (FSDirectoryEntry *) ctx->data);
+    return res < 0 ? IOSUHAX_FSA_RewindDir(ctx->fsaFd, ctx->dirHandle) : res;
+}
+
+static int op_readdir_multi(bench_ctx_t *ctx) {
+    int res = IOSUHAX_FSA_ReadDirMulti(ctx->fsaFd, ctx->dirHandle, (FSDirectoryEntry *) ctx->data, IOSUHAX_READDIR_MULTI_MAX);
+    return (res <= 0) ? IOSUHAX_FSA_RewindDir(ctx->fsaFd, ctx->dirHandle) : res;
+}
+
+static int op_rewinddir(bench_ctx_t *ctx) {
+    return IOSUHAX_FSA_RewindDir(ctx->fsaFd, ctx->dirHandle);
+}
+
+static int op_chdir(bench_ctx_t *ctx) {
+    return IOSUHAX_FSA_ChangeDir(ctx->fsaFd, BENCH_VOLUME "/dir");
+}
+
+static int op_openfile_closefile(bench_ctx_t *ctx) {
+    int handle;
+    int res = IOSUHAX_FSA_OpenFile(ctx->fsaFd, ctx->path, "r", &handle);
+    return res < 0 ? res : IOSUHAX_FSA_CloseFile(ctx->fsaFd, handle);
+}
+
+static int op_openfilestat_closefile(bench_ctx_t *ctx) {
+    int handle;
+    FSStat stat;
+    uint64_t size;
+    int res = IOSUHAX_FSA_OpenFileStat(ctx->fsaFd, ctx->path, "r", &handle, &stat, &size);
+    return res < 0 ? res : IOSUHAX_FSA_CloseFile(ctx->fsaFd, handle);
+}
+
+static int op_readfile(bench_ctx_t *ctx) {
+    int res = IOSUHAX_FSA_ReadFile(ctx->fsaFd, ctx->data, 1, ctx->size, ctx->fileHandle, 0);
+    if (res >= 0 && (uint32_t) res < ctx->size)
+        return IOSUHAX_FSA_SetFilePos(ctx->fsaFd, ctx->fileHandle, 0);
+    return res;
+}
+
+static int op_writefile(bench_ctx_t *ctx) {
+    if ((ctx->counter += ctx->size) > BENCH_FILE_SIZE) {
+        ctx->counter = ctx->size;
+        IOSUHAX_FSA_SetFilePos(ctx->fsaFd, ctx->fileHandle, 0);
+    }
+    return IOSUHAX_FSA_WriteFile(ctx->fsaFd, ctx->data, 1, ctx->size, ctx->fileHandle, 0);
+}
+
+static int op_statfile(bench_ctx_t *ctx) {
+    return IOSUHAX_FSA_StatFile(ctx->fsaFd, ctx->fileHandle, (FSStat *) ctx->data);
+}
+
+static int op_setfilepos(bench_ctx_t *ctx) {
+    return IOSUHAX_FSA_SetFilePos(ctx->fsaFd, ctx->fileHandle, ctx->counter++ & 0xFFFF);
+}
+
+static int op_setfilepos64(bench_ctx_t *ctx) {
+    return IOSUHAX_FSA_SetFilePos64(ctx->fsaFd, ctx->fileHandle, ctx->counter++ & 0xFFFF);
+}
+
+static int op_getfilepos64(bench_ctx_t *ctx) {
+    uint64_t pos;
+    return IOSUHAX_FSA_GetFilePos64(ctx->fsaFd, ctx->fileHandle, &pos);
+}
+
+static int op_getstat(bench_ctx_t *ctx) {
+    return IOSUHAX_FSA_GetStat(ctx->fsaFd, ctx->path, (FSStat *) ctx->data);
+}
+
+static int op_changemode(bench_ctx_t *ctx) {
+    return IOSUHAX_FSA_ChangeMode(ctx->fsaFd, ctx->path, 0x666);
+}
+
+static int op_rawopen_rawclose(bench_ctx_t *ctx) {
+    int handle;
+    int res = IOSUHAX_FSA_RawOpen(ctx->fsaFd, BENCH_DEVICE, &handle);
+    return res < 0 ? res : IOSUHAX_FSA_RawClose(ctx->fsaFd, handle);
+}
+
+static int op_rawread(bench_ctx_t *ctx) {
+    uint32_t blocks = ctx->size / 0x200;
+    if ((ctx->counter + blocks) * 0x200ull > BENCH_IMAGE_SIZE)
+        ctx->counter = 0;
+    int res = IOSUHAX_FSA_RawRead(ctx->fsaFd, ctx->data, 0x200, blocks, ctx->counter, ctx->rawHandle);
+    ctx->counter += blocks;
+    return res;
+}
+
+static int op_rawwrite(bench_ctx_t *ctx) {
+    uint32_t blocks = ctx->size / 0x200;
+    if ((ctx->counter + blocks) * 0x200ull > BENCH_IMAGE_SIZE)
+        ctx->counter = 0;
+    int res = IOSUHAX_FSA_RawWrite(ctx->fsaFd, ctx->data, 0x200, blocks, ctx->counter, ctx->rawHandle);
+    ctx->counter += blocks;
+    return res;
+}
+
+static int op_readfile_async(bench_ctx_t *ctx) {
+    IOSUHAX_AsyncQueue *queue = (IOSUHAX_AsyncQueue *) ctx->arg;
+    IOSUHAX_AsyncResult result;
+    int res = IOSUHAX_FSA_ReadFileAsync(queue, ctx->fsaFd, ctx->data, 1, ctx->size, ctx->fileHandle, 0, NULL);
+    if (res < 0 || IOSUHAX_WaitAsyncQueue(queue, &result) != 1)
+        return -1;
+    if (result.result >= 0 && (uint32_t) result.result < ctx->size)
+        return IOSUHAX_FSA_SetFilePos(ctx->fsaFd, ctx->fileHandle, 0);
+    return result.result;
+}
+
+typedef struct {
+    const char *name;
+    bench_op_t op;
+    int sized;   // size, alignment and throughput apply
+    int pathed;  // runs for every path length
+} bench_api_entry_t;
+
+static void bench_case_api(void) {
+    static const bench_api_entry_t entries[] = {
+            {"memwrite", op_memwrite, 1, 0},
+            {"memread", op_memread, 1, 0},
+            {"memcpy", op_memcpy, 1, 0},
+            {"kern_write32", op_kern_write32, 0, 0},
+            {"kern_read32", op_kern_read32, 1, 0},
+            {"read_otp", op_read_otp, 0, 0},
+            {"read_seeprom", op_read_seeprom, 0, 0},
+            {"svc", op_svc, 0, 0},
+            {"fsa_open_close", op_fsa_open_close, 0, 0},
+            {"mount_unmount", op_mount_unmount, 0, 0},
+            {"flush_volume", op_flush_volume, 0, 0},
+            {"get_device_info", op_get_device_info, 0, 0},
+            {"makedir_remove", op_makedir_remove, 0, 0},
+            {"opendir_closedir", op_opendir_closedir, 0, 0},
+            {"readdir", op_readdir, 0, 0},
+            {"readdir_multi", op_readdir_multi, 0, 0},
+            {"rewinddir", op_rewinddir, 0, 0},
+            {"chdir", op_chdir, 0, 0},
+            {"openfile_closefile", op_openfile_closefile, 0, 1},
+            {"openfilestat_closefile", op_openfilestat_closefile, 0, 1},
+            {"readfile", op_readfile, 1, 0},
+            {"writefile", op_writefile, 1, 0},
+            {"statfile", op_statfile, 0, 0},
+            {"setfilepos", op_setfilepos, 0, 0},
+            {"setfilepos64", op_setfilepos64, 0, 0},
+            {"getfilepos64", op_getfilepos64, 0, 0},
+            {"getstat", op_getstat, 0, 1},
+            {"changemode", op_changemode, 0, 1},
+            {"rawopen_rawclose", op_rawopen_rawclose, 0, 0},
+            {"rawread", op_rawread, 1, 0},
+            {"rawwrite", op_rawwrite, 1, 0},
+            {"readfile_async", op_readfile_async, 1, 0},
+    };
+    // IOSUHAX_ODM_GetDiscKey talks to /dev/odm, which the emulator does not provide
+
+    bench_ctx_t ctx = {0};
+    IOSUHAX_AsyncQueue *queue = IOSUHAX_CreateAsyncQueue(4);
+
+    for (uint32_t e = 0; e < sizeof(entries) / sizeof(entries[0]); e++) {
+        const bench_api_entry_t *entry = &entries[e];
+        uint32_t sizeCnt  = entry->sized ? benchSizes.count : 1;
+        uint32_t alignCnt = entry->sized ? benchAligns.count : 1;
+        uint32_t pathCnt  = entry->pathed ? benchPaths.count : 1;
+
+        for (uint32_t s = 0; s < sizeCnt; s++) {
+            for (uint32_t a = 0; a < alignCnt; a++) {
+                for (uint32_t p = 0; p < pathCnt; p++) {
+                    bench_ctx_init(&ctx, entry->sized ? benchSizes.values[s] : 0, entry->sized ? benchAligns.values[a] : 0);
+                    ctx.pathLen = entry->pathed ? benchPaths.values[p] : 0;
+                    ctx.arg     = queue;
+                    bench_make_path(ctx.path, ctx.pathLen, 0);
+
+                    if (IOSUHAX_FSA_OpenFile(ctx.fsaFd, BENCH_VOLUME "/file.bin", "r+", &ctx.fileHandle) < 0 ||
+                        IOSUHAX_FSA_OpenDir(ctx.fsaFd, BENCH_VOLUME "/dir", &ctx.dirHandle) < 0 ||
+                        IOSUHAX_FSA_RawOpen(ctx.fsaFd, BENCH_DEVICE, &ctx.rawHandle) < 0) {
+                        bench_print("api", entry->name, &ctx, 1, 0, 0, 0, "setup failed");
+                        continue;
+                    }
+
+                    bench_run("api", entry->name, entry->op, &ctx, ctx.size, NULL);
+
+                    IOSUHAX_FSA_RawClose(ctx.fsaFd, ctx.rawHandle);
+                    IOSUHAX_FSA_CloseDir(ctx.fsaFd, ctx.dirHandle);
+                    IOSUHAX_FSA_CloseFile(ctx.fsaFd, ctx.fileHandle);
+                }
+            }
+        }
+    }
+
+    IOSUHAX_FSA_ChangeDir(benchFsaFd, "/");
+    IOSUHAX_DestroyAsyncQueue(queue);
+    bench_ctx_free(&ctx);
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! pool: staging buffer reuse of the small metadata wrappers
+//!----------------------------------------------------------------------------------------------------
+static void bench_case_pool(void) {
+    static const bench_api_entry_t entries[] = {
+            {"getstat", op_getstat, 0, 1},
+            {"statfile", op_statfile, 0, 0},
+            {"setfilepos", op_setfilepos, 0, 0},
+            {"readdir", op_readdir, 0, 0},
+            {"readfile", op_readfile, 1, 0},
+    };
+
+    bench_ctx_t ctx = {0};
+    for (uint32_t e = 0; e < sizeof(entries) / sizeof(entries[0]); e++) {
+        bench_ctx_init(&ctx, entries[e].sized ? 4096 : 0, 4);
+        ctx.pathLen = 64;
+        bench_make_path(ctx.path, ctx.pathLen, 0);
+        IOSUHAX_FSA_OpenFile(ctx.fsaFd, BENCH_VOLUME "/file.bin", "r", &ctx.fileHandle);
+        IOSUHAX_FSA_OpenDir(ctx.fsaFd, BENCH_VOLUME "/dir", &ctx.dirHandle);
+
+        IOSUHAX_ResetBufferStats();
+        uint64_t ns;
+        uint64_t ops = bench_loop(entries[e].op, &ctx, &ns);
+
+        IOSUHAX_BufferStats stats;
+        char note[128];
+        IOSUHAX_GetBufferStats(&stats);
+        uint32_t total = stats.hits + stats.misses + stats.oversized;
+        snprintf(note, sizeof(note), "hit_rate=%.4f misses=%u oversized=%u copied=%llu", total ? (double) stats.hits / total : 0.0, stats.misses, stats.oversized,
+                 (unsigned long long) stats.copied);
+        bench_print("pool", entries[e].name, &ctx, 1, ops, ops * ctx.size, ns, ops ? note : "failed");
+
+        IOSUHAX_FSA_CloseDir(ctx.fsaFd, ctx.dirHandle);
+        IOSUHAX_FSA_CloseFile(ctx.fsaFd, ctx.fileHandle);
+    }
+    bench_ctx_free(&ctx);
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! raw: zero-copy vectored transfers (aligned buffer) against the staging copy (unaligned buffer)
+//!----------------------------------------------------------------------------------------------------
+static void bench_case_raw(void) {
+    bench_ctx_t ctx = {0};
+    for (uint32_t s = 0; s < benchSizes.count; s++) {
+        for (uint32_t a = 0; a < benchAligns.count; a++) {
+            for (int write = 0; write < 2; write++) {
+                bench_ctx_init(&ctx, benchSizes.values[s], benchAligns.values[a]);
+                if (ctx.size < 0x200 || IOSUHAX_FSA_RawOpen(ctx.fsaFd, BENCH_DEVICE, &ctx.rawHandle) < 0)
+                    continue;
+
+                IOSUHAX_ResetBufferStats();
+                uint64_t ns;
+                uint64_t ops = bench_loop(write ? op_rawwrite : op_rawread, &ctx, &ns);
+
+                IOSUHAX_BufferStats stats;
+                char note[64];
+                IOSUHAX_GetBufferStats(&stats);
+                snprintf(note, sizeof(note), "copied_per_op=%llu", ops ? (unsigned long long) (stats.copied / ops) : 0ull);
+
+                const char *variant = write ? (ctx.align & 0x3F ? "write_staging" : "write_zero_copy") : (ctx.align & 0x3F ? "read_staging" : "read_zero_copy");
+                bench_print("raw", variant, &ctx, 1, ops, ops * ctx.size, ns, ops ? note : "failed");
+                IOSUHAX_FSA_RawClose(ctx.fsaFd, ctx.rawHandle);
+            }
+        }
+    }
+    bench_ctx_free(&ctx);
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! batch: GetStat of BENCH_STAT_FILES files one request each against batches of several sizes
+//!----------------------------------------------------------------------------------------------------
+static const uint32_t benchBatchSizes[] = {1, 4, 16, 64};
+
+static int op_getstat_files(bench_ctx_t *ctx) {
+    char path[BENCH_PATH_MAX + 1];
+    FSStat stat;
+    for (uint32_t i = 0; i < BENCH_STAT_FILES; i++) {
+        bench_make_path(path, ctx->pathLen, i);
+        int res = IOSUHAX_FSA_GetStat(ctx->fsaFd, path, &stat);
+        if (res < 0)
+            return res;
+    }
+    return 0;
+}
+
+static int op_getstat_batches(bench_ctx_t *ctx) {
+    uint32_t batchSize = ctx->counter;
+    for (uint32_t i = 0; i < BENCH_STAT_FILES; i += batchSize) {
+        IOSUHAX_Batch *batch = (IOSUHAX_Batch *) ctx->arg;
+        int results[BENCH_STAT_FILES];
+        FSStat stat[BENCH_STAT_FILES];
+        char path[BENCH_PATH_MAX + 1];
+
+        IOSUHAX_ResetBatch(batch);
+        for (uint32_t j = 0; j < batchSize && i + j < BENCH_STAT_FILES; j++) {
+            bench_make_path(path, ctx->pathLen, i + j);
+            if (IOSUHAX_Batch_GetStat(batch, path, &stat[j]) < 0)
+                return -1;
+        }
+        if (IOSUHAX_Batch_Submit(batch, results) <= 0 || results[0] < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void bench_case_batch(void) {
+    bench_ctx_t ctx = {0};
+    for (uint32_t p = 0; p < benchPaths.count; p++) {
+        bench_ctx_init(&ctx, 0, 0);
+        ctx.pathLen = benchPaths.values[p];
+
+        uint64_t ns;
+        uint64_t ops = bench_loop(op_getstat_files, &ctx, &ns);
+        bench_print("batch", "sequential", &ctx, 1, ops * BENCH_STAT_FILES, 0, ns, ops ? NULL : "failed");
+
+        for (uint32_t b = 0; b < sizeof(benchBatchSizes) / sizeof(benchBatchSizes[0]); b++) {
+            IOSUHAX_Batch *batch = IOSUHAX_CreateBatch(ctx.fsaFd, benchBatchSizes[b]);
+            char variant[32];
+            snprintf(variant, sizeof(variant), "batch_%u", benchBatchSizes[b]);
+
+            ctx.counter = benchBatchSizes[b];
+            ctx.arg     = batch;
+            ops         = batch ? bench_loop(op_getstat_batches, &ctx, &ns) : 0;
+            bench_print("batch", variant, &ctx, 1, ops * BENCH_STAT_FILES, 0, ns, ops ? NULL : "failed");
+            IOSUHAX_DestroyBatch(batch);
+        }
+    }
+    bench_ctx_free(&ctx);
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! threads: parallel requests over 1 to IOSUHAX_MAX_HANDLES /dev/iosuhax handles
+//!----------------------------------------------------------------------------------------------------
+typedef struct {
+    bench_ctx_t ctx;
+    bench_op_t op;
+    pthread_barrier_t *barrier;
+    uint64_t ops;
+    uint64_t ns;
+} bench_thread_t;
+
+static void *bench_thread_main(void *arg) {
+    bench_thread_t *thread = (bench_thread_t *) arg;
+    pthread_barrier_wait(thread->barrier);
+    thread->ops = bench_loop(thread->op, &thread->ctx, &thread->ns);
+    return NULL;
+}
+
+//! runs 'op' on 'count' threads at once, setup/cleanup run on the calling thread for every context
+static void bench_run_threads(const char *name, const char *variant, uint32_t count, bench_op_t op, uint32_t size, uint32_t bytesPerOp, int (*setup)(bench_ctx_t *, uint32_t),
+                              void (*cleanup)(bench_ctx_t *)) {
+    bench_thread_t threads[BENCH_THREADS_MAX];
+    pthread_t ids[BENCH_THREADS_MAX];
+    pthread_barrier_t barrier;
+
+    if (count > BENCH_THREADS_MAX)
+        count = BENCH_THREADS_MAX;
+    pthread_barrier_init(&barrier, NULL, count);
+
+    int failed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        bench_ctx_t *ctx = &threads[i].ctx;
+        ctx->buffer      = NULL;
+        bench_ctx_init(ctx, size, 0);
+        ctx->pathLen       = 64;
+        threads[i].op      = op;
+        threads[i].barrier = &barrier;
+        bench_make_path(ctx->path, ctx->pathLen, i % BENCH_STAT_FILES);
+        if (setup && setup(ctx, i) < 0)
+            failed = 1;
+    }
+
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < count && !failed; i++)
+        pthread_create(&ids[i], NULL, bench_thread_main, &threads[i]);
+
+    uint64_t ops = 0;
+    for (uint32_t i = 0; i < count && !failed; i++) {
+        pthread_join(ids[i], NULL);
+        if (threads[i].ops == 0)
+            failed = 1;
+        ops += threads[i].ops;
+    }
+    uint64_t ns = bench_now_ns() - start;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (cleanup)
+            cleanup(&threads[i].ctx);
+        bench_ctx_free(&threads[i].ctx);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    bench_print(name, variant, &threads[0].ctx, count, failed ? 0 : ops, failed ? 0 : ops * bytesPerOp, ns, failed ? "failed" : NULL);
+}
+
+//! FSA serves one request per client at a time, every thread gets its own client
+static int bench_thread_open_client(bench_ctx_t *ctx, uint32_t index) {
+    ctx->fsaFd = IOSUHAX_FSA_Open();
+    return ctx->fsaFd;
+}
+
+static void bench_thread_close_client(bench_ctx_t *ctx) {
+    if (ctx->fsaFd >= 0)
+        IOSUHAX_FSA_Close(ctx->fsaFd);
+}
+
+static int bench_thread_open_file(bench_ctx_t *ctx, uint32_t index) {
+    if (bench_thread_open_client(ctx, index) < 0)
+        return -1;
+    return IOSUHAX_FSA_OpenFile(ctx->fsaFd, BENCH_VOLUME "/file.bin", "r", &ctx->fileHandle);
+}
+
+static void bench_thread_close_file(bench_ctx_t *ctx) {
+    IOSUHAX_FSA_CloseFile(ctx->fsaFd, ctx->fileHandle);
+    bench_thread_close_client(ctx);
+}
+
+static void bench_case_threads(void) {
+    for (uint32_t handles = 1; handles <= IOSUHAX_MAX_HANDLES; handles++) {
+        // the transport is reopened with the handle count under test
+        IOSUHAX_Close();
+        if (IOSUHAX_OpenEx(NULL, handles) < 0)
+            return;
+
+        for (uint32_t t = 0; t < benchThreads.count; t++) {
+            char variant[32];
+            snprintf(variant, sizeof(variant), "getstat_handles_%u", handles);
+            bench_run_threads("threads", variant, benchThreads.values[t], op_getstat, 0, 0, bench_thread_open_client, bench_thread_close_client);
+
+            snprintf(variant, sizeof(variant), "readfile_handles_%u", handles);
+            bench_run_threads("threads", variant, benchThreads.values[t], op_readfile, 4096, 4096, bench_thread_open_file, bench_thread_close_file);
+        }
+    }
+
+    IOSUHAX_Close();
+    IOSUHAX_OpenEx(NULL, IOSUHAX_MAX_HANDLES);
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! devoptab: the newlib calls through a mount_fs device
+//!----------------------------------------------------------------------------------------------------
+static int op_dev_open_close(bench_ctx_t *ctx) {
+    int fd = iosuhax_host_open("bench:/file.bin", O_RDONLY, 0);
+    return fd < 0 ? fd : iosuhax_host_close(fd);
+}
+
+static int op_dev_stat(bench_ctx_t *ctx) {
+    struct stat st;
+    return iosuhax_host_stat("bench:/file.bin", &st);
+}
+
+static int op_dev_fstat(bench_ctx_t *ctx) {
+    struct stat st;
+    return iosuhax_host_fstat(ctx->fileHandle, &st);
+}
+
+static int op_dev_read(bench_ctx_t *ctx) {
+    ssize_t res = iosuhax_host_read(ctx->fileHandle, ctx->data, ctx->size);
+    if (res >= 0 && (uint32_t) res < ctx->size)
+        return iosuhax_host_lseek(ctx->fileHandle, 0, SEEK_SET);
+    return res < 0 ? -1 : 0;
+}
+
+static int op_dev_write(bench_ctx_t *ctx) {
+    if ((ctx->counter += ctx->size) > BENCH_FILE_SIZE) {
+        ctx->counter = ctx->size;
+        iosuhax_host_lseek(ctx->fileHandle, 0, SEEK_SET);
+    }
+    return iosuhax_host_write(ctx->fileHandle, ctx->data, ctx->size) < 0 ? -1 : 0;
+}
+
+static int op_dev_pread(bench_ctx_t *ctx) {
+    if ((ctx->counter += ctx->size) > BENCH_FILE_SIZE)
+        ctx->counter = ctx->size;
+    return mount_fs_pread(ctx->fileHandle, ctx->data, ctx->size, ctx->counter - ctx->size) < 0 ? -1 : 0;
+}
+
+static int op_dev_seek(bench_ctx_t *ctx) {
+    return iosuhax_host_lseek(ctx->fileHandle, ctx->counter++ & 0xFFFF, SEEK_SET) < 0 ? -1 : 0;
+}
+
+static int op_dev_dirnext(bench_ctx_t *ctx) {
+    char name[NAME_MAX + 1];
+    struct stat st;
+    DIR_ITER *dir = iosuhax_host_diropen("bench:/dir");
+    if (!dir)
+        return -1;
+    while (iosuhax_host_dirnext(dir, name, &st) == 0) {
+    }
+    return iosuhax_host_dirclose(dir);
+}
+
+static void bench_case_devoptab(void) {
+    static const bench_api_entry_t entries[] = {
+            {"open_close", op_dev_open_close, 0, 0},
+            {"stat", op_dev_stat, 0, 0},
+            {"fstat", op_dev_fstat, 0, 0},
+            {"seek", op_dev_seek, 0, 0},
+            {"dir_list", op_dev_dirnext, 0, 0},
+            {"read", op_dev_read, 1, 0},
+            {"pread", op_dev_pread, 1, 0},
+            {"write", op_dev_write, 1, 0},
+    };
+
+    if (mount_fs("bench", benchFsaFd, NULL, BENCH_VOLUME) != 0) {
+        fprintf(stderr, "mount_fs failed\n");
+        return;
+    }
+
+    bench_ctx_t ctx = {0};
+    for (uint32_t e = 0; e < sizeof(entries) / sizeof(entries[0]); e++) {
+        const bench_api_entry_t *entry = &entries[e];
+        uint32_t sizeCnt  = entry->sized ? benchSizes.count : 1;
+        uint32_t alignCnt = entry->sized ? benchAligns.count : 1;
+
+        for (uint32_t s = 0; s < sizeCnt; s++) {
+            for (uint32_t a = 0; a < alignCnt; a++) {
+                bench_ctx_init(&ctx, entry->sized ? benchSizes.values[s] : 0, entry->sized ? benchAligns.values[a] : 0);
+                ctx.fileHandle = iosuhax_host_open("bench:/file.bin", O_RDWR, 0);
+                if (ctx.fileHandle < 0) {
+                    bench_print("devoptab", entry->name, &ctx, 1, 0, 0, 0, "setup failed");
+                    continue;
+                }
+                bench_run("devoptab", entry->name, entry->op, &ctx, ctx.size, NULL);
+                iosuhax_host_close(ctx.fileHandle);
+            }
+        }
+    }
+    bench_ctx_free(&ctx);
+    unmount_fs("bench");
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! mount_threads: devoptab reads and writes from several threads over 1 to MOUNT_FS_FSA_HANDLES_MAX FSA handles
+//!----------------------------------------------------------------------------------------------------
+static int bench_thread_dev_open_read(bench_ctx_t *ctx, uint32_t index) {
+    ctx->fileHandle = iosuhax_host_open("mt:/file.bin", O_RDONLY, 0);
+    return ctx->fileHandle;
+}
+
+static int bench_thread_dev_open_write(bench_ctx_t *ctx, uint32_t index) {
+    char path[32];
+    snprintf(path, sizeof(path), "mt:/thread%02u.bin", index);
+    ctx->fileHandle = iosuhax_host_open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    return ctx->fileHandle;
+}
+
+static void bench_thread_dev_close(bench_ctx_t *ctx) {
+    if (ctx->fileHandle >= 0)
+        iosuhax_host_close(ctx->fileHandle);
+}
+
+static void bench_case_mount_threads(void) {
+    for (uint32_t handles = 1; handles <= MOUNT_FS_FSA_HANDLES_MAX; handles++) {
+        mount_fs_options_t options = {0};
+        options.fsa_handle_count   = handles;
+        if (mount_fs_ex("mt", benchFsaFd, NULL, BENCH_VOLUME, &options) != 0) {
+            fprintf(stderr, "mount_fs_ex failed\n");
+            return;
+        }
+
+        for (uint32_t t = 0; t < benchThreads.count; t++) {
+            char variant[32];
+            snprintf(variant, sizeof(variant), "read_fsa_%u", handles);
+            bench_run_threads("mount_threads", variant, benchThreads.values[t], op_dev_read, 4096, 4096, bench_thread_dev_open_read, bench_thread_dev_close);
+
+            snprintf(variant, sizeof(variant), "write_fsa_%u", handles);
+            bench_run_threads("mount_threads", variant, benchThreads.values[t], op_dev_write, 4096, 4096, bench_thread_dev_open_write, bench_thread_dev_close);
+        }
+
+        unmount_fs("mt");
+    }
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! stat: stat storms through a mount_fs device over the GETSTAT files, without IPC latency so the path
+//! translation and the stat cache are what is measured
+//!----------------------------------------------------------------------------------------------------
+static char benchStatPaths[BENCH_STAT_FILES][BENCH_PATH_MAX + 8];
+
+static int op_dev_stat_files(bench_ctx_t *ctx) {
+    struct stat st;
+    return iosuhax_host_stat(benchStatPaths[ctx->counter++ % BENCH_STAT_FILES], &st);
+}
+
+static int op_dev_stat_missing(bench_ctx_t *ctx) {
+    struct stat st;
+    // every path is missing, the call fails the same way each time
+    iosuhax_host_stat(benchStatPaths[ctx->counter++ % BENCH_STAT_FILES], &st);
+    return 0;
+}
+
+static void bench_stat_mount(const char *variant, bench_op_t op, const mount_fs_options_t *options, bench_ctx_t *ctx) {
+    if (mount_fs_ex("storm", benchFsaFd, NULL, BENCH_VOLUME, options) != 0) {
+        bench_print("stat", variant, ctx, 1, 0, 0, 0, "mount_fs_ex failed");
+        return;
+    }
+    ctx->counter = 0;
+    bench_run("stat", variant, op, ctx, 0, "latency_us=0");
+    unmount_fs("storm");
+}
+
+static void bench_case_stat(void) {
+    mount_fs_options_t cached = {0};
+    cached.stat_cache_size     = 2 * BENCH_STAT_FILES;
+    cached.stat_cache_negative = 1;
+
+    iosuhax_host_set_latency(0);
+
+    bench_ctx_t ctx = {0};
+    char path[BENCH_PATH_MAX + 1];
+    for (uint32_t p = 0; p < benchPaths.count; p++) {
+        bench_ctx_init(&ctx, 0, 0);
+        ctx.pathLen = benchPaths.values[p];
+
+        for (uint32_t i = 0; i < BENCH_STAT_FILES; i++) {
+            bench_make_path(path, ctx.pathLen, i);
+            snprintf(benchStatPaths[i], sizeof(benchStatPaths[i]), "storm:%s", path + strlen(BENCH_VOLUME));
+        }
+        bench_stat_mount("stat", op_dev_stat_files, NULL, &ctx);
+        bench_stat_mount("stat_cached", op_dev_stat_files, &cached, &ctx);
+
+        // same lengths, names that do not exist
+        for (uint32_t i = 0; i < BENCH_STAT_FILES; i++)
+            benchStatPaths[i][strlen("storm:/")] = 'x';
+        bench_stat_mount("stat_missing", op_dev_stat_missing, NULL, &ctx);
+        bench_stat_mount("stat_missing_cached", op_dev_stat_missing, &cached, &ctx);
+    }
+    bench_ctx_free(&ctx);
+
+    iosuhax_host_set_latency(benchLatency);
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! large: a sparse file beyond 4 GiB through a mount_fs device, SEEK_END and streaming reads above 4 GiB
+//!----------------------------------------------------------------------------------------------------
+static int op_large_seek_end(bench_ctx_t *ctx) {
+    off_t back = (off_t) (ctx->counter++ & 0xFFFF) + 1;
+    off_t pos  = iosuhax_host_lseek(ctx->fileHandle, -back, SEEK_END);
+    return (pos == (off_t) BENCH_LARGE_SIZE - back) ? 0 : -1;
+}
+
+static int op_large_read(bench_ctx_t *ctx) {
+    if ((ctx->counter += ctx->size) > BENCH_LARGE_SIZE - BENCH_LARGE_BASE) {
+        ctx->counter = ctx->size;
+        if (iosuhax_host_lseek(ctx->fileHandle, BENCH_LARGE_BASE, SEEK_SET) != (off_t) BENCH_LARGE_BASE)
+            return -1;
+    }
+    return (iosuhax_host_read(ctx->fileHandle, ctx->data, ctx->size) == (ssize_t) ctx->size) ? 0 : -1;
+}
+
+static int op_large_pread(bench_ctx_t *ctx) {
+    if ((ctx->counter += ctx->size) > BENCH_LARGE_SIZE - BENCH_LARGE_BASE)
+        ctx->counter = ctx->size;
+    off_t offset = BENCH_LARGE_BASE + ctx->counter - ctx->size;
+    return (mount_fs_pread(ctx->fileHandle, ctx->data, ctx->size, offset) == (ssize_t) ctx->size) ? 0 : -1;
+}
+
+static void bench_case_large(void) {
+    static const bench_api_entry_t entries[] = {
+            {"seek_end", op_large_seek_end, 0, 0},
+            {"read_above_4g", op_large_read, 1, 0},
+            {"pread_above_4g", op_large_pread, 1, 0},
+    };
+
+    mount_fs_options_t options = {0};
+    options.read_ahead_size    = MOUNT_FS_READ_AHEAD_DEFAULT;
+    if (mount_fs_ex("large", benchFsaFd, NULL, BENCH_VOLUME, &options) != 0) {
+        fprintf(stderr, "mount_fs_ex failed\n");
+        return;
+    }
+
+    bench_ctx_t ctx = {0};
+    for (uint32_t e = 0; e < sizeof(entries) / sizeof(entries[0]); e++) {
+        const bench_api_entry_t *entry = &entries[e];
+        uint32_t sizeCnt  = entry->sized ? benchSizes.count : 1;
+        uint32_t alignCnt = entry->sized ? benchAligns.count : 1;
+
+        for (uint32_t s = 0; s < sizeCnt; s++) {
+            for (uint32_t a = 0; a < alignCnt; a++) {
+                bench_ctx_init(&ctx, entry->sized ? benchSizes.values[s] : 0, entry->sized ? benchAligns.values[a] : 0);
+                ctx.fileHandle = iosuhax_host_open("large:/large.bin", O_RDONLY, 0);
+                if (ctx.fileHandle < 0 || iosuhax_host_lseek(ctx.fileHandle, BENCH_LARGE_BASE, SEEK_SET) != (off_t) BENCH_LARGE_BASE) {
+                    bench_print("large", entry->name, &ctx, 1, 0, 0, 0, "setup failed");
+                    if (ctx.fileHandle >= 0)
+                        iosuhax_host_close(ctx.fileHandle);
+                    continue;
+                }
+                bench_run("large", entry->name, entry->op, &ctx, ctx.size, NULL);
+                iosuhax_host_close(ctx.fileHandle);
+            }
+        }
+    }
+    bench_ctx_free(&ctx);
+    unmount_fs("large");
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! disc: the DISC_INTERFACE sector calls
+//!----------------------------------------------------------------------------------------------------
+static int op_disc_read(bench_ctx_t *ctx) {
+    uint32_t sectors = ctx->size / 0x200;
+    if ((ctx->counter + sectors) * 0x200ull > BENCH_IMAGE_SIZE)
+        ctx->counter = 0;
+    bool res = IOSUHAX_sdio_disc_interface.readSectors(ctx->counter, sectors, ctx->data);
+    ctx->counter += sectors;
+    return res ? 0 : -1;
+}
+
+static int op_disc_write(bench_ctx_t *ctx) {
+    uint32_t sectors = ctx->size / 0x200;
+    if ((ctx->counter + sectors) * 0x200ull > BENCH_IMAGE_SIZE)
+        ctx->counter = 0;
+    bool res = IOSUHAX_sdio_disc_interface.writeSectors(ctx->counter, sectors, ctx->data);
+    ctx->counter += sectors;
+    return res ? 0 : -1;
+}
+
+static void bench_case_disc(void) {
+    if (!IOSUHAX_sdio_disc_interface.startup()) {
+        fprintf(stderr, "disc interface startup failed\n");
+        return;
+    }
+
+    bench_ctx_t ctx = {0};
+    for (uint32_t s = 0; s < benchSizes.count; s++) {
+        for (uint32_t a = 0; a < benchAligns.count; a++) {
+            bench_ctx_init(&ctx, benchSizes.values[s], benchAligns.values[a]);
+            if (ctx.size < 0x200)
+                continue;
+            bench_run("disc", "read_sectors", op_disc_read, &ctx, ctx.size, NULL);
+            bench_run("disc", "write_sectors", op_disc_write, &ctx, ctx.size, NULL);
+        }
+    }
+    bench_ctx_free(&ctx);
+    IOSUHAX_sdio_disc_interface.shutdown();
+}
+
+//!----------------------------------------------------------------------------------------------------
+//! marshal: request building of the path wrappers against the hand built requests they replaced.
+//! Runs without IPC latency, both variants pay the same emulator time, the difference is the PPC side.
+//!----------------------------------------------------------------------------------------------------
+static int baseline_getstat(int handle, int fsaFd, const char *path, FSStat *out_data) {
+    const int input_cnt = 2;
+
+    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + 1;
+
+    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    if (!io_buf)
+        return -2;
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = sizeof(uint32_t) * input_cnt;
+    strcpy(((char *) io_buf) + io_buf[1], path);
+
+    int out_buf_size     = 4 + sizeof(FSStat);
+    uint32_t *out_buffer = (uint32_t *) memalign(0x20, out_buf_size);
+    if (!out_buffer) {
+        free(io_buf);
+        return -2;
+    }
+
+    int res = IOS_Ioctl(handle, IOCTL_FSA_GETSTAT, io_buf, io_buf_size, out_buffer, out_buf_size);
+    if (res >= 0) {
+        res = out_buffer[0];
+        memcpy(out_data, out_buffer + 1, sizeof(FSStat));
+    }
+
+    free(io_buf);
+    free(out_buffer);
+    return res;
+}
+
+static int baseline_openfile(int handle, int fsaFd, const char *path, const char *mode, int *outHandle) {
+    const int input_cnt = 3;
+
+    int io_buf_size = sizeof(uint32_t) * input_cnt + strlen(path) + strlen(mode) + 2;
+
+    uint32_t *io_buf = (uint32_t *) memalign(0x20, io_buf_size);
+    if (!io_buf)
+        return -2;
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = sizeof(uint32_t) * input_cnt;
+    io_buf[2] = io_buf[1] + strlen(path) + 1;
+    strcpy(((char *) io_buf) + io_buf[1], path);
+    strcpy(((char *) io_buf) + io_buf[2], mode);
+
+    int result_vec[2];
+
+    int res = IOS_Ioctl(handle, IOCTL_FSA_OPENFILE, io_buf, io_buf_size, result_vec, sizeof(result_vec));
+    free(io_buf);
+    if (res < 0)
+        return res;
+
+    *outHandle = result_vec[1];
+    return result_vec[0];
+}
+
+static int baseline_mount(int handle, int fsaFd, const char *device_path, const char *volume_path, uint32_t flags, const char *arg_string, int arg_string_len) {
+    const int input_cnt = 6;
+
+    int io_buf_size = (sizeof(uint32_t) * input_cnt) + strlen(device_path) + strlen(volume_path) + arg_string_len + 3;
+
+    int *io_buf = (int *) memalign(0x20, ROUNDUP(io_buf_size, 0x20));
+    if (!io_buf)
+        return -2;
+    memset(io_buf, 0, io_buf_size);
+
+    io_buf[0] = fsaFd;
+    io_buf[1] = sizeof(uint32_t) * input_cnt;
+    io_buf[2] = io_buf[1] + strlen(device_path) + 1;
+    io_buf[3] = flags;
+    io_buf[4] = arg_string_len ? (io_buf[2] + strlen(volume_path) + 1) : 0;
+    io_buf[5] = arg_string_len;
+
+    strcpy(((char *) io_buf) + io_buf[1], device_path);
+    strcpy(((char *) io_buf) + io_buf[2], volume_path);
+
+    if (arg_string_len)
+        memcpy(((char *) io_buf) + io_buf[4], arg_string, arg_string_len);
+
+    int res = IOS_Ioctl(handle, IOCTL_FSA_MOUNT, io_buf, io_buf_size, io_buf, 4);
+    if (res >= 0)
+        res = io_buf[0];
+    free(io_buf);
+    return res;
+}
+
+//! the volume path of the mount variants has the path length under test
+static void bench_mount_path(char *out, uint32_t len) {
+    int n = snprintf(out, BENCH_PATH_MAX + 1, "/vol/m");
+    while ((uint32_t) n < len && n < BENCH_PATH_MAX)
+        out[n++] = 'm';
+    out[n] = 0;
+}
+
+static int op_marshal_baseline_getstat(bench_ctx_t *ctx) {
+    return baseline_getstat(ctx->counter, ctx->fsaFd, ctx->path, (FSStat *) ctx->data);
+}
+
+static int op_marshal_baseline_openfile(bench_ctx_t *ctx) {
+    int handle;
+    int res = baseline_openfile(ctx->counter, ctx->fsaFd, ctx->path, "r", &handle);
+    return res < 0 ? res : IOSUHAX_FSA_CloseFile(ctx->fsaFd, handle);
+}
+
+static int op_marshal_baseline_mount(bench_ctx_t *ctx) {
+    char volume[BENCH_PATH_MAX + 1];
+    bench_mount_path(volume, ctx->pathLen);
+    int res = baseline_mount(ctx->counter, ctx->fsaFd, BENCH_DEVICE, volume, 2, NULL, 0);
+    return res < 0 ? res : IOSUHAX_FSA_Unmount(ctx->fsaFd, volume, 2);
+}
+
+static int op_marshal_mount(bench_ctx_t *ctx) {
+    char volume[BENCH_PATH_MAX + 1];
+    bench_mount_path(volume, ctx->pathLen);
+    int res = IOSUHAX_FSA_Mount(ctx->fsaFd, BENCH_DEVICE, volume, 2, NULL, 0);
+    return res < 0 ? res : IOSUHAX_FSA_Unmount(ctx->fsaFd, volume, 2);
+}
+
+static void bench_case_marshal(void) {
+    static const bench_api_entry_t entries[] = {
+            {"getstat", op_getstat, 0, 1},
+            {"baseline_getstat", op_marshal_baseline_getstat, 0, 1},
+            {"openfile_closefile", op_openfile_closefile, 0, 1},
+            {"baseline_openfile_closefile", op_marshal_baseline_openfile, 0, 1},
+            {"mount_unmount", op_marshal_mount, 0, 1},
+            {"baseline_mount_unmount", op_marshal_baseline_mount, 0, 1},
+    };
+
+    iosuhax_host_set_latency(0);
+
+    bench_ctx_t ctx = {0};
+    for (uint32_t p = 0; p < benchPaths.count; p++) {
+        for (uint32_t e = 0; e < sizeof(entries) / sizeof(entries[0]); e++) {
+            bench_ctx_init(&ctx, 0, 0);
+            ctx.pathLen = benchPaths.values[p];
+            ctx.counter = IOSUHAX_Open(NULL); // the baseline requests go to the first handle directly
+            bench_make_path(ctx.path, ctx.pathLen, 0);
+            bench_run("marshal", entries[e].name, entries[e].op, &ctx, 0, "latency_us=0");
+        }
+    }
+    bench_ctx_free(&ctx);
+
+    iosuhax_host_set_latency(benchLatency);
+}
+
+//!----------------------------------------------------------------------------------------------------
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} bench_case_t;
+
+static const bench_case_t benchCases[] = {
+        {"api", bench_case_api},
+        {"pool", bench_case_pool},
+        {"raw", bench_case_raw},
+        {"batch", bench_case_batch},
+        {"marshal", bench_case_marshal},
+        {"threads", bench_case_threads},
+        {"devoptab", bench_case_devoptab},
+        {"mount_threads", bench_case_mount_threads},
+        {"stat", bench_case_stat},
+        {"large", bench_case_large},
+        {"disc", bench_case_disc},
+};
+
+static void bench_usage(void) {
+    fprintf(stderr, "usage: bench [options] [case...]\n"
+                    "  -s list   payload sizes in bytes (512,4096,65536,1048576)\n"
+                    "  -p list   path lengths (32,64,255)\n"
+                    "  -a list   buffer offsets from a 0x40 boundary (0,4)\n"
+                    "  -t list   thread counts (1,2,3,4)\n"
+                    "  -d ms     duration of every measurement (200)\n"
+                    "  -l us     emulated IPC latency per request (20)\n"
+                    "  -f mask   IOSUHAX_HOST_FEATURE_* of the emulated IOSU (all)\n"
+                    "cases:");
+    for (uint32_t i = 0; i < sizeof(benchCases) / sizeof(benchCases[0]); i++)
+        fprintf(stderr, " %s", benchCases[i].name);
+    fprintf(stderr, ", all by default\n");
+}
+
+int main(int argc, char **argv) {
+    uint32_t features = IOSUHAX_HOST_FEATURE_ALL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:a:t:d:l:f:")) != -1) {
+        int res = 0;
+        switch (opt) {
+            case 's':
+                res = bench_parse_list(optarg, &benchSizes);
+                break;
+            case 'p':
+                res = bench_parse_list(optarg, &benchPaths);
+                break;
+            case 'a':
+                res = bench_parse_list(optarg, &benchAligns);
+                break;
+            case 't':
+                res = bench_parse_list(optarg, &benchThreads);
+                break;
+            case 'd':
+                benchDurationMs = strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                benchLatency = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                features = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                res = -1;
+                break;
+        }
+        if (res < 0) {
+            bench_usage();
+            return 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < benchSizes.count; i++) {
+        if (benchSizes.values[i] > benchMaxSize)
+            benchMaxSize = benchSizes.values[i];
+    }
+    for (uint32_t i = 0; i < benchPaths.count; i++) {
+        if (benchPaths.values[i] > BENCH_PATH_MAX || benchPaths.values[i] < strlen(BENCH_VOLUME "/f0000_")) {
+            fprintf(stderr, "path lengths have to be between %u and %u\n", (uint32_t) strlen(BENCH_VOLUME "/f0000_"), BENCH_PATH_MAX);
+            return 1;
+        }
+    }
+    if (benchMaxSize < 0x10000)
+        benchMaxSize = 0x10000;
+
+    // fixture: a volume directory with a data file, a sparse file beyond 4 GiB, a directory and the GETSTAT files, a raw image
+    static char dir[] = "/tmp/iosuhax_bench_XXXXXX";
+    char volume[512], image[512];
+    benchDir = mkdtemp(dir);
+    if (!benchDir)
+        return 1;
+    snprintf(volume, sizeof(volume), "%s/volume", benchDir);
+    snprintf(image, sizeof(image), "%s/raw.img", benchDir);
+    mkdir(volume, 0777);
+    benchDir = volume;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/dir", volume);
+    mkdir(path, 0777);
+    for (uint32_t i = 0; i < 32; i++) {
+        snprintf(path, sizeof(path), "dir/entry%02u", i);
+        bench_create_host_file(path, 16);
+    }
+    if (bench_create_host_file("file.bin", BENCH_FILE_SIZE) != 0 || bench_create_host_file("large.bin", BENCH_LARGE_SIZE) != 0 ||
+        bench_create_path_files() != 0) {
+        fprintf(stderr, "failed to create the fixture in %s\n", dir);
+        return 1;
+    }
+    benchDir = dir;
+    if (bench_create_host_file("raw.img", BENCH_IMAGE_SIZE) != 0)
+        return 1;
+
+    iosuhax_host_config_t config;
+    iosuhax_host_default_config(&config);
+    config.root                   = dir;
+    config.ram_size               = 2 * benchMaxSize + 0x1000;
+    config.devices[0].device_path = BENCH_DEVICE;
+    config.devices[0].image       = image;
+    config.devices[0].directory   = volume;
+    config.features               = features;
+    config.latency_us             = benchLatency;
+
+    if (iosuhax_host_init(&config) != 0 || IOSUHAX_OpenEx(NULL, IOSUHAX_MAX_HANDLES) < 0) {
+        fprintf(stderr, "failed to start the emulator\n");
+        return 1;
+    }
+
+    benchFsaFd = IOSUHAX_FSA_Open();
+    if (benchFsaFd < 0 || IOSUHAX_FSA_Mount(benchFsaFd, BENCH_DEVICE, BENCH_VOLUME, 2, NULL, 0) != 0) {
+        fprintf(stderr, "failed to mount the fixture volume\n");
+        return 1;
+    }
+
+    printf("# latency_us=%u features=0x%x duration_ms=%u\n", benchLatency, features, benchDurationMs);
+    printf("case,variant,size,path_len,align,threads,ops,seconds,ops_per_sec,mib_per_sec,avg_us,note\n");
+
+    int ran = 0;
+    for (uint32_t i = 0; i < sizeof(benchCases) / sizeof(benchCases[0]); i++) {
+        int selected = (optind == argc);
+        for (int a = optind; a < argc; a++)
+            selected |= strcmp(argv[a], benchCases[i].name) == 0;
+        if (selected) {
+            benchCases[i].run();
+            ran++;
+        }
+    }
+
+    IOSUHAX_FSA_Unmount(benchFsaFd, BENCH_VOLUME, 2);
+    IOSUHAX_FSA_Close(benchFsaFd);
+    IOSUHAX_Close();
+    iosuhax_host_shutdown();
+
+    snprintf(path, sizeof(path), "rm -rf '%s'", dir);
+    if (system(path) != 0)
+        fprintf(stderr, "failed to remove %s\n", dir);
+
+    if (!ran) {
+        bench_usage();
+        return 1;
+    }
+    return 0;
+}